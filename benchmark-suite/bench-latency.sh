@@ -0,0 +1,73 @@
+#!/usr/bin/env bash
+
+# like bench-rrb, but compares the latency of a gc and a refcount build. Build
+# pgrep_latency_rrb in two build directories, one configured with
+# --with-memory=gc and one with --with-memory=refcount, and pass the programs
+# as the last two arguments.
+#
+# Every output line contains: ops, total ns, p50 ns, p99 ns and max ns.
+
+CORES=$1
+SEARCH="$2"
+FILE="$3"
+DIR="$4"
+GC_PROGRAM="$5"
+REFCOUNT_PROGRAM="$6"
+
+mkdir -p "$PWD/$DIR"
+
+ITERATIONS=20
+WARMUP_RUNS=3
+
+function is_done {
+    if [ -f "$1" ] && [ $(wc -l "$1" | cut -f1 -d' ') -ge $ITERATIONS ]; then
+        return 0
+    else
+        return 1
+    fi
+}
+
+function run_bench {
+    local program="$1"
+    local output="$2"
+    if is_done "$output"; then
+        echo "$output already finished -- skipping..."
+        return
+    fi
+
+    echo "Running $program with ${CORES} cores, searching for '"${SEARCH}"'."
+
+    ## Do a warmup
+    for i in `seq 0 $(( $WARMUP_RUNS - 1 ))`; do
+        echo -en "\rWarm-up: $i"
+        "$program" $CORES "$SEARCH" "$FILE" &>/dev/null
+    done
+    echo -e '\rWarm-up: Done'
+
+    ## Then keep running until we're done
+    while ! is_done "$output"; do
+        "$program" $CORES "$SEARCH" "$FILE" 2>/dev/null >> "$output"
+    done
+    echo 'Done!'
+}
+
+GC_OUTPUT="$PWD/$DIR/latency-gc-${CORES}-${SEARCH}.dat"
+REFCOUNT_OUTPUT="$PWD/$DIR/latency-refcount-${CORES}-${SEARCH}.dat"
+
+run_bench "$GC_PROGRAM" "$GC_OUTPUT"
+run_bench "$REFCOUNT_PROGRAM" "$REFCOUNT_OUTPUT"
+
+## Median over all runs of every column
+function summary {
+    local name="$1"
+    local output="$2"
+    for col in 1 2 3 4 5; do
+        cut -d' ' -f$col "$output" | sort -n | awk '{ v[NR] = $1 }
+            END { printf "%s ", v[int((NR + 1) / 2)] }'
+    done | awk -v name="$name" '{ printf "%-9s %10d %14.0f %8d %8d %10d\n",
+                                 name, $1, $1 / ($2 / 1e9), $3, $4, $5 }'
+}
+
+printf "%-9s %10s %14s %8s %8s %10s\n" mode ops ops/s p50 p99 max
+summary gc "$GC_OUTPUT"
+summary refcount "$REFCOUNT_OUTPUT"
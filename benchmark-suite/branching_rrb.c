@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2013-2014 Jean Niklas L'orange. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <gc/gc.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <rrb.h>
+
+// Compares the branching factors librrb has instances for, in a single run.
+// For each of them, times building a vector of the given size by persistent
+// pushes, random rrb_nth lookups, random updates, a full scan with rrb_chunks
+// and cutting the vector into pieces that are concatenated back together.
+// Prints one line per branching factor: The bits per branching and per leaf,
+// followed by the nanoseconds per push, lookup, update, scanned element and
+// concatenation.
+
+#define OPERATIONS 1000000
+#define PIECES 1000
+
+static long long nanoseconds_since(struct timespec *time_start) {
+  struct timespec time_stop;
+  clock_gettime(CLOCK_MONOTONIC, &time_stop);
+  long long nanoseconds_elapsed = (time_stop.tv_sec - time_start->tv_sec) * 1000000000LL;
+  nanoseconds_elapsed += (time_stop.tv_nsec - time_start->tv_nsec);
+  return nanoseconds_elapsed;
+}
+
+static int sum_chunk(const void *const *data, uint32_t len, void *ctx) {
+  uintptr_t *sum = ctx;
+  for (uint32_t i = 0; i < len; i++) {
+    *sum += (uintptr_t) data[i];
+  }
+  return 0;
+}
+
+static void bench(const RRBOps *ops, uint32_t count, const uint32_t *indices) {
+  struct timespec time_start;
+
+  clock_gettime(CLOCK_MONOTONIC, &time_start);
+  const RRB *rrb = ops->create();
+  for (uint32_t i = 0; i < count; i++) {
+    const RRB *pushed = ops->push(rrb, (void *) (uintptr_t) i);
+    ops->release(rrb);
+    rrb = pushed;
+  }
+  const double push_ns = (double) nanoseconds_since(&time_start) / count;
+
+  clock_gettime(CLOCK_MONOTONIC, &time_start);
+  uintptr_t lookup_sum = 0;
+  for (uint32_t i = 0; i < OPERATIONS; i++) {
+    lookup_sum += (uintptr_t) ops->nth(rrb, indices[i]);
+  }
+  const double nth_ns = (double) nanoseconds_since(&time_start) / OPERATIONS;
+
+  clock_gettime(CLOCK_MONOTONIC, &time_start);
+  for (uint32_t i = 0; i < OPERATIONS; i++) {
+    const RRB *updated = ops->update(rrb, indices[i], (void *) (uintptr_t) i);
+    ops->release(rrb);
+    rrb = updated;
+  }
+  const double update_ns = (double) nanoseconds_since(&time_start) / OPERATIONS;
+
+  clock_gettime(CLOCK_MONOTONIC, &time_start);
+  uintptr_t scan_sum = 0;
+  ops->chunks(rrb, 0, count, sum_chunk, &scan_sum);
+  const double scan_ns = (double) nanoseconds_since(&time_start) / count;
+
+  clock_gettime(CLOCK_MONOTONIC, &time_start);
+  const RRB *catted = ops->create();
+  for (uint32_t i = 0; i < PIECES; i++) {
+    const uint32_t from = (uint32_t) ((uint64_t) count * i / PIECES);
+    const uint32_t to = (uint32_t) ((uint64_t) count * (i + 1) / PIECES);
+    const RRB *piece = ops->slice(rrb, from, to);
+    const RRB *joined = ops->concat(catted, piece);
+    ops->release(piece);
+    ops->release(catted);
+    catted = joined;
+  }
+  const double concat_ns = (double) nanoseconds_since(&time_start) / PIECES;
+
+  if (ops->count(catted) != count) {
+    fprintf(stderr, "Concatenation (bits=%u) lost elements.\n", ops->bits);
+    exit(1);
+  }
+  // Keep the sums alive, so that the loops aren't optimised away.
+  if (lookup_sum == 1 && scan_sum == 1) {
+    fprintf(stderr, "Unlikely sums.\n");
+  }
+  printf("%u %u %.2f %.2f %.2f %.2f %.2f\n", ops->bits, ops->leaf_bits,
+         push_ns, nth_ns, update_ns, scan_ns, concat_ns);
+  ops->release(catted);
+  ops->release(rrb);
+}
+
+int main(int argc, char *argv[]) {
+  GC_INIT();
+  if (argc != 2) {
+    fprintf(stderr, "Expected 1 argument (element count), got %d\nExiting...\n",
+            argc - 1);
+    exit(1);
+  }
+  char *end;
+  uint32_t count = (uint32_t) strtol(argv[1], &end, 10);
+  if (*end || count == 0) {
+    fprintf(stderr, "Error, expects first argument to be a positive number,"
+            " was '%s'.\n", argv[1]);
+    exit(1);
+  }
+  srand(0);
+
+  uint32_t *indices = malloc(OPERATIONS * sizeof(uint32_t));
+  for (uint32_t i = 0; i < OPERATIONS; i++) {
+    indices[i] = (uint32_t) rand() % count;
+  }
+
+  fprintf(stderr, "%u elements, %d lookups and updates\n", count, OPERATIONS);
+  fprintf(stderr, "bits, leaf bits, ns per push, lookup, update, scanned "
+          "element and concatenation:\n");
+  for (uint32_t bits = 2; bits <= 12; bits++) {
+    const RRBOps *ops = rrb_ops(bits);
+    if (ops != NULL) {
+      bench(ops, count, indices);
+    }
+  }
+  free(indices);
+  exit(0);
+}
@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2013-2014 Jean Niklas L'orange. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <gc/gc.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <rrb.h>
+
+// Stresses vectors with more elements than 32-bit counts can hold. A base
+// vector is built in bulk with rrb_from_array, and shared copies of it are
+// appended with rrb_concat until the vector has the requested size, 6 billion
+// elements by default. The elements are never copied, so this fits in a few
+// hundred megabytes. Then times random rrb_nth lookups, and concatenating the
+// vector with itself. Prints the element count, followed by the nanoseconds
+// per element of rrb_from_array, per append, per lookup and for the final
+// concatenation.
+
+#define DEFAULT_COUNT 6000000000ULL
+#define BASE_SIZE (1 << 24)
+#define OPERATIONS 1000000
+
+static long long nanoseconds_since(struct timespec *time_start) {
+  struct timespec time_stop;
+  clock_gettime(CLOCK_MONOTONIC, &time_stop);
+  long long nanoseconds_elapsed = (time_stop.tv_sec - time_start->tv_sec) * 1000000000LL;
+  nanoseconds_elapsed += (time_stop.tv_nsec - time_start->tv_nsec);
+  return nanoseconds_elapsed;
+}
+
+static uint64_t rand_u64(void) {
+  return ((uint64_t) rand() << 42) ^ ((uint64_t) rand() << 21)
+    ^ (uint64_t) rand();
+}
+
+int main(int argc, char *argv[]) {
+  GC_INIT();
+  if (argc > 2) {
+    fprintf(stderr, "Expected at most 1 argument (element count), got %d\n"
+            "Exiting...\n", argc - 1);
+    exit(1);
+  }
+  uint64_t count = DEFAULT_COUNT;
+  if (argc == 2) {
+    char *end;
+    count = strtoull(argv[1], &end, 10);
+    if (*end || count == 0) {
+      fprintf(stderr, "Error, expects first argument to be a positive number,"
+              " was '%s'.\n", argv[1]);
+      exit(1);
+    }
+  }
+#if RRB_COUNT_BITS == 32
+  if (count > UINT32_MAX / 2) {
+    fprintf(stderr, "Error, twice %llu elements don't fit in 32-bit counts. "
+            "Configure with --with-count-bits=64.\n",
+            (unsigned long long) count);
+    exit(1);
+  }
+#endif
+  srand(0);
+
+  // Element i of the vector is always i modulo the base size.
+  void **elems = malloc(BASE_SIZE * sizeof(void *));
+  for (uint32_t i = 0; i < BASE_SIZE; i++) {
+    elems[i] = (void *) (uintptr_t) i;
+  }
+  struct timespec time_start;
+  clock_gettime(CLOCK_MONOTONIC, &time_start);
+  const RRB *base = rrb_from_array((const void *const *) elems, BASE_SIZE);
+  const double from_array_ns = (double) nanoseconds_since(&time_start)
+    / BASE_SIZE;
+  free(elems);
+
+  clock_gettime(CLOCK_MONOTONIC, &time_start);
+  const RRB *rrb = rrb_create();
+  uint32_t appends = 0;
+  while (rrb_count(rrb) < count) {
+    const RRBIndex left = (RRBIndex) count - rrb_count(rrb);
+    const RRB *piece = left < BASE_SIZE ? rrb_slice(base, 0, left)
+                                        : rrb_retain(base);
+    const RRB *joined = rrb_concat(rrb, piece);
+    rrb_release(piece);
+    rrb_release(rrb);
+    rrb = joined;
+    appends++;
+  }
+  const double append_ns = (double) nanoseconds_since(&time_start) / appends;
+
+  uint64_t *indices = malloc(OPERATIONS * sizeof(uint64_t));
+  for (uint32_t i = 0; i < OPERATIONS; i++) {
+    indices[i] = rand_u64() % count;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &time_start);
+  uintptr_t lookup_sum = 0;
+  for (uint32_t i = 0; i < OPERATIONS; i++) {
+    lookup_sum += (uintptr_t) rrb_nth(rrb, (RRBIndex) indices[i]);
+  }
+  const double nth_ns = (double) nanoseconds_since(&time_start) / OPERATIONS;
+
+  uintptr_t expected_sum = 0;
+  for (uint32_t i = 0; i < OPERATIONS; i++) {
+    expected_sum += (uintptr_t) (indices[i] % BASE_SIZE);
+  }
+  if (lookup_sum != expected_sum) {
+    fprintf(stderr, "Lookups gave the wrong elements.\n");
+    exit(1);
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &time_start);
+  const RRB *doubled = rrb_concat(rrb, rrb);
+  const double concat_ns = (double) nanoseconds_since(&time_start);
+  if (rrb_count(doubled) != 2 * (RRBIndex) count) {
+    fprintf(stderr, "Concatenation lost elements.\n");
+    exit(1);
+  }
+
+  fprintf(stderr, "elements, ns per element of rrb_from_array, per append of "
+          "%d elements, per lookup, and for doubling the vector:\n",
+          BASE_SIZE);
+  printf("%llu %.2f %.2f %.2f %.2f\n", (unsigned long long) count,
+         from_array_ns, append_ns, nth_ns, concat_ns);
+  free(indices);
+  rrb_release(doubled);
+  rrb_release(rrb);
+  rrb_release(base);
+  exit(0);
+}
@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2013-2014 Jean Niklas L'orange. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <gc/gc.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <rrb.h>
+
+// Times random rrb_nth lookups on three trees with the same contents: A strict
+// tree built by pushes, a relaxed tree built like in test_fibocat, where small
+// vectors are concatenated pairwise over and over, and a relaxed tree built by
+// appending small vectors one at a time. Prints the average nanoseconds per
+// lookup in each tree.
+
+#define PREDEF_RRBS 200
+#define MAX_INIT_SIZE 16
+#define MAX_PART 100
+#define LOOKUPS 10000000
+
+static long long nanoseconds_since(struct timespec *time_start) {
+  struct timespec time_stop;
+  clock_gettime(CLOCK_MONOTONIC, &time_stop);
+  long long nanoseconds_elapsed = (time_stop.tv_sec - time_start->tv_sec) * 1000000000LL;
+  nanoseconds_elapsed += (time_stop.tv_nsec - time_start->tv_nsec);
+  return nanoseconds_elapsed;
+}
+
+static double lookup_nth(const RRB *rrb, uint32_t *indices, uintptr_t *sum) {
+  struct timespec time_start;
+  clock_gettime(CLOCK_MONOTONIC, &time_start);
+  uintptr_t s = 0;
+  for (uint32_t i = 0; i < LOOKUPS; i++) {
+    s += (uintptr_t) rrb_nth(rrb, indices[i]);
+  }
+  *sum = s;
+  return (double) nanoseconds_since(&time_start) / LOOKUPS;
+}
+
+static const RRB* fibocat_rrb(uint32_t count) {
+  const RRB **rrbs = malloc(PREDEF_RRBS * sizeof(RRB *));
+  for (uint32_t i = 0; i < PREDEF_RRBS; i++) {
+    const uint32_t size = (uint32_t) rand() % MAX_INIT_SIZE;
+    rrbs[i] = rrb_create();
+    for (uint32_t j = 0; j < size; j++) {
+      rrbs[i] = rrb_push(rrbs[i], (void *) (uintptr_t) rand());
+    }
+  }
+  // rrbs is used as a ring buffer: Every new vector replaces the oldest one,
+  // which is concatenated with the second oldest.
+  uint32_t oldest = 0;
+  const RRB *newest = rrbs[PREDEF_RRBS - 1];
+  while (rrb_count(newest) < count) {
+    const RRB *left = rrbs[oldest];
+    const RRB *right = rrbs[(oldest + 1) % PREDEF_RRBS];
+    newest = rrb_concat(left, right);
+    rrbs[oldest] = newest;
+    oldest = (oldest + 1) % PREDEF_RRBS;
+  }
+  free(rrbs);
+  return newest;
+}
+
+static const RRB* appended_rrb(const RRB *contents) {
+  const uint32_t count = rrb_count(contents);
+  const RRB *rrb = rrb_create();
+  uint32_t i = 0;
+  while (i < count) {
+    uint32_t part_end = i + 1 + (uint32_t) rand() % MAX_PART;
+    if (part_end > count) {
+      part_end = count;
+    }
+    TransientRRB *tpart = rrb_to_transient(rrb_create());
+    for (; i < part_end; i++) {
+      tpart = transient_rrb_push(tpart, rrb_nth(contents, i));
+    }
+    rrb = rrb_concat(rrb, transient_to_rrb(tpart));
+  }
+  return rrb;
+}
+
+int main(int argc, char *argv[]) {
+  GC_INIT();
+  if (argc != 2) {
+    fprintf(stderr, "Expected 1 argument (element count), got %d\nExiting...\n",
+            argc - 1);
+    exit(1);
+  }
+  char *end;
+  uint32_t count = (uint32_t) strtol(argv[1], &end, 10);
+  if (*end || count == 0) {
+    fprintf(stderr, "Error, expects first argument to be a positive number,"
+            " was '%s'.\n", argv[1]);
+    exit(1);
+  }
+  srand(0);
+
+  const RRB *relaxed = fibocat_rrb(count);
+  count = rrb_count(relaxed);
+
+  TransientRRB *tstrict = rrb_to_transient(rrb_create());
+  for (uint32_t i = 0; i < count; i++) {
+    tstrict = transient_rrb_push(tstrict, (void *) (uintptr_t) rrb_nth(relaxed, i));
+  }
+  const RRB *strict = transient_to_rrb(tstrict);
+  const RRB *appended = appended_rrb(relaxed);
+
+  uint32_t *indices = malloc(LOOKUPS * sizeof(uint32_t));
+  for (uint32_t i = 0; i < LOOKUPS; i++) {
+    indices[i] = (uint32_t) rand() % count;
+  }
+
+  uintptr_t strict_sum, relaxed_sum, appended_sum;
+  double strict_ns = lookup_nth(strict, indices, &strict_sum);
+  double relaxed_ns = lookup_nth(relaxed, indices, &relaxed_sum);
+  double appended_ns = lookup_nth(appended, indices, &appended_sum);
+  if (strict_sum != relaxed_sum || strict_sum != appended_sum) {
+    fprintf(stderr, "Lookups in the strict and relaxed trees disagree.\n");
+    exit(1);
+  }
+
+  fprintf(stderr, "%d random lookups in %u elements\n", LOOKUPS, count);
+  fprintf(stderr, "ns per lookup, strict, fibocat and appended:\n");
+  printf("%.2f %.2f %.2f\n", strict_ns, relaxed_ns, appended_ns);
+  free(indices);
+  exit(0);
+}
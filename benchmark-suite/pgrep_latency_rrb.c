@@ -0,0 +1,242 @@
+/*
+ * Copyright (c) 2013-2014 Jean Niklas L'orange. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+// The pgrep workload, but timing every single RRB-tree operation instead of
+// whole phases: Stop-the-world collections show up as latency spikes, which
+// total running times hide. Every replaced RRB-tree is released, so the same
+// program measures both the gc and the refcount build.
+
+#define _DYNAMIC 0
+#define GC_LINUX_THREADS
+#ifndef _REENTRANT
+#define _REENTRANT 1
+#endif
+
+#ifndef RRB_REFCOUNT
+#include <gc/gc.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <rrb.h>
+#include "interval.h"
+#include "substr_contains.h"
+
+#define ROUNDS 10
+
+typedef struct {
+  uint64_t *arr;
+  uint32_t len, cap;
+} Samples;
+
+typedef struct {
+  char *buffer;
+  char *search_term;
+  uint32_t file_size;
+  uint32_t own_tid;
+  uint32_t thread_count;
+  const RRB *hits;
+  Samples samples;
+} LatencyArgs;
+
+static void* split_and_filter(void *void_input);
+
+static inline uint64_t now() {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return (uint64_t) time.tv_sec * 1000000000ULL + (uint64_t) time.tv_nsec;
+}
+
+static void samples_add(Samples *samples, uint64_t sample) {
+  if (samples->len == samples->cap) {
+    samples->cap = samples->cap == 0 ? 1024 : samples->cap * 2;
+    samples->arr = realloc(samples->arr, samples->cap * sizeof(uint64_t));
+  }
+  samples->arr[samples->len++] = sample;
+}
+
+static int uint64_cmp(const void *a, const void *b) {
+  const uint64_t x = *(const uint64_t *) a;
+  const uint64_t y = *(const uint64_t *) b;
+  return (x > y) - (x < y);
+}
+
+int main(int argc, char *argv[]) {
+#ifndef RRB_REFCOUNT
+  GC_INIT();
+#endif
+  // CLI argument parsing
+  if (argc != 4) {
+    fprintf(stderr, "Expected 3 arguments, got %d\nExiting...\n", argc - 1);
+    exit(1);
+  }
+  char *end;
+  uint32_t thread_count = (uint32_t) strtol(argv[1], &end, 10);
+  if (*end || thread_count == 0) {
+    fprintf(stderr, "Error, expects first argument to be a positive number,"
+            " was '%s'.\n", argv[1]);
+    exit(1);
+  }
+  fprintf(stderr, "Looking for '%s' in file %s using %d threads, %d rounds...\n",
+          argv[2], argv[3], thread_count, ROUNDS);
+
+  FILE *fp = fopen(argv[3], "rb");
+  if (!fp) {
+    perror(argv[3]);
+    exit(1);
+  }
+  fseek(fp, 0, SEEK_END);
+  long file_size = ftell(fp);
+  rewind(fp);
+
+  char *buffer = malloc(file_size + 1);
+  if (!buffer) {
+    fclose(fp);
+    fprintf(stderr, "Cannot allocate buffer for file (probably too large).\n");
+    exit(1);
+  }
+  buffer[file_size] = 0;
+
+  if (1 != fread(buffer, file_size, 1, fp)) {
+    fclose(fp);
+    free(buffer);
+    fprintf(stderr, "Entire read failed.\n");
+    exit(1);
+  }
+  fclose(fp);
+
+  pthread_t *tid = malloc(thread_count * sizeof(pthread_t));
+  LatencyArgs *la = calloc(thread_count, sizeof(LatencyArgs));
+  Samples concat_samples = {.arr = NULL, .len = 0, .cap = 0};
+  uint32_t hits = 0;
+
+  const uint64_t start = now();
+  for (uint32_t round = 0; round < ROUNDS; round++) {
+    for (uint32_t i = 0; i < thread_count; i++) {
+      la[i].buffer = buffer;
+      la[i].search_term = argv[2];
+      la[i].file_size = (uint32_t) file_size;
+      la[i].own_tid = i;
+      la[i].thread_count = thread_count;
+      pthread_create(&tid[i], NULL, &split_and_filter, (void *) &la[i]);
+    }
+    for (uint32_t i = 0; i < thread_count; i++) {
+      pthread_join(tid[i], NULL);
+    }
+
+    // Concatenate the hits of all threads, in order
+    const RRB *all_hits = rrb_create();
+    for (uint32_t i = 0; i < thread_count; i++) {
+      const uint64_t op_start = now();
+      const RRB *concatenated = rrb_concat(all_hits, la[i].hits);
+      rrb_release(all_hits);
+      rrb_release(la[i].hits);
+      samples_add(&concat_samples, now() - op_start);
+      all_hits = concatenated;
+    }
+    hits = rrb_count(all_hits);
+    rrb_release(all_hits);
+  }
+  const uint64_t elapsed = now() - start;
+
+  // Merge all samples, and find the percentiles
+  Samples all = concat_samples;
+  for (uint32_t i = 0; i < thread_count; i++) {
+    for (uint32_t j = 0; j < la[i].samples.len; j++) {
+      samples_add(&all, la[i].samples.arr[j]);
+    }
+    free(la[i].samples.arr);
+  }
+  qsort(all.arr, all.len, sizeof(uint64_t), uint64_cmp);
+
+  fprintf(stderr, "%d hits\n", hits);
+  fprintf(stderr, "ops, total ns, p50 ns, p99 ns, max ns:\n");
+  printf("%u %llu %llu %llu %llu\n", all.len, (unsigned long long) elapsed,
+         (unsigned long long) all.arr[all.len / 2],
+         (unsigned long long) all.arr[(uint32_t) (all.len * 0.99)],
+         (unsigned long long) all.arr[all.len - 1]);
+
+  free(all.arr);
+  free(la);
+  free(tid);
+  free(buffer);
+  return 0;
+}
+
+static void* split_and_filter(void *void_input) {
+  LatencyArgs *la = (LatencyArgs *) void_input;
+  const char *buffer = la->buffer;
+  const uint32_t own_tid = la->own_tid;
+  const uint32_t thread_count = la->thread_count;
+  Samples *samples = &la->samples;
+
+  // calculate the interval to compute for
+  uint32_t partition_size = la->file_size / thread_count;
+  uint32_t from = partition_size * own_tid;
+  uint32_t to = partition_size * (own_tid + 1);
+  if (own_tid + 1 == thread_count) {
+    to = la->file_size;
+  }
+
+  // rewind to start of line
+  uint32_t line_start = from;
+  while (0 < line_start && buffer[line_start] != '\n') {
+    line_start--;
+  }
+  // find and collect lines
+  const RRB *lines = rrb_create();
+  for (uint32_t i = from; i < to; i++) {
+    if (buffer[i] == '\n') {
+      Interval interval = {.from = line_start, .to = i};
+      const uint64_t op_start = now();
+      const RRB *pushed = rrb_push(lines, (void *) interval_to_uint64_t(interval));
+      rrb_release(lines);
+      samples_add(samples, now() - op_start);
+      lines = pushed;
+      line_start = i + 1;
+    }
+  }
+
+  // find all lines containing the search term
+  const RRB *contained_lines = rrb_create();
+  const uint32_t line_count = rrb_count(lines);
+  for (uint32_t line_idx = 0; line_idx < line_count; line_idx++) {
+    Interval line = uint64_t_to_interval((uint64_t) rrb_nth(lines, line_idx));
+    if (substr_contains(&buffer[line.from], line.to - line.from, la->search_term)) {
+      const uint64_t op_start = now();
+      const RRB *pushed = rrb_push(contained_lines,
+                                   (void *) interval_to_uint64_t(line));
+      rrb_release(contained_lines);
+      samples_add(samples, now() - op_start);
+      contained_lines = pushed;
+    }
+  }
+  rrb_release(lines);
+
+  la->hits = contained_lines;
+  return 0;
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2013-2014 Jean Niklas L'orange. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <gc/gc.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <rrb.h>
+
+// Compares a full scan through rrb_nth against a full scan through an
+// RRBIterator, on a strict tree built by pushes and on a relaxed tree built by
+// concatenating small vectors. Prints the nanoseconds spent on each scan.
+
+#define MAX_PART 100
+
+static long long nanoseconds_since(struct timespec *time_start) {
+  struct timespec time_stop;
+  clock_gettime(CLOCK_MONOTONIC, &time_stop);
+  long long nanoseconds_elapsed = (time_stop.tv_sec - time_start->tv_sec) * 1000000000LL;
+  nanoseconds_elapsed += (time_stop.tv_nsec - time_start->tv_nsec);
+  return nanoseconds_elapsed;
+}
+
+static long long scan_nth(const RRB *rrb, uintptr_t *sum) {
+  struct timespec time_start;
+  clock_gettime(CLOCK_MONOTONIC, &time_start);
+  uintptr_t s = 0;
+  const uint32_t count = rrb_count(rrb);
+  for (uint32_t i = 0; i < count; i++) {
+    s += (uintptr_t) rrb_nth(rrb, i);
+  }
+  *sum = s;
+  return nanoseconds_since(&time_start);
+}
+
+static long long scan_iterator(const RRB *rrb, uintptr_t *sum) {
+  struct timespec time_start;
+  clock_gettime(CLOCK_MONOTONIC, &time_start);
+  uintptr_t s = 0;
+  RRBIterator *it = rrb_iterator_create(rrb);
+  while (rrb_iterator_has_next(it)) {
+    s += (uintptr_t) rrb_iterator_next(it);
+  }
+  *sum = s;
+  return nanoseconds_since(&time_start);
+}
+
+int main(int argc, char *argv[]) {
+  GC_INIT();
+  if (argc != 2) {
+    fprintf(stderr, "Expected 1 argument (element count), got %d\nExiting...\n",
+            argc - 1);
+    exit(1);
+  }
+  char *end;
+  uint32_t count = (uint32_t) strtol(argv[1], &end, 10);
+  if (*end) {
+    fprintf(stderr, "Error, expects first argument to be a number, was '%s'.\n",
+            argv[1]);
+    exit(1);
+  }
+  srand(0);
+
+  TransientRRB *tstrict = rrb_to_transient(rrb_create());
+  for (uint32_t i = 0; i < count; i++) {
+    tstrict = transient_rrb_push(tstrict, (void *) (uintptr_t) rand());
+  }
+  const RRB *strict = transient_to_rrb(tstrict);
+
+  const RRB *relaxed = rrb_create();
+  while (rrb_count(relaxed) < count) {
+    uint32_t part_size = 1 + (uint32_t) rand() % MAX_PART;
+    TransientRRB *tpart = rrb_to_transient(rrb_create());
+    for (uint32_t i = 0; i < part_size; i++) {
+      tpart = transient_rrb_push(tpart, (void *) (uintptr_t) rand());
+    }
+    relaxed = rrb_concat(relaxed, transient_to_rrb(tpart));
+  }
+
+  uintptr_t nth_sum, iter_sum;
+  long long strict_nth = scan_nth(strict, &nth_sum);
+  long long strict_iter = scan_iterator(strict, &iter_sum);
+  if (nth_sum != iter_sum) {
+    fprintf(stderr, "Scans of the strict tree disagree.\n");
+    exit(1);
+  }
+  long long relaxed_nth = scan_nth(relaxed, &nth_sum);
+  long long relaxed_iter = scan_iterator(relaxed, &iter_sum);
+  if (nth_sum != iter_sum) {
+    fprintf(stderr, "Scans of the relaxed tree disagree.\n");
+    exit(1);
+  }
+
+  fprintf(stderr, "Scanned %u elements (strict) and %u elements (relaxed)\n",
+          rrb_count(strict), rrb_count(relaxed));
+  printf("%lld %lld %lld %lld\n", strict_nth, strict_iter, relaxed_nth,
+         relaxed_iter);
+  exit(0);
+}
@@ -0,0 +1,181 @@
+/*
+ * Copyright (c) 2013-2014 Jean Niklas L'orange. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <rrb.h>
+
+// Compares rrb_splice with the same edit done by concatenating two slices and
+// the replacement, rrb_concat(rrb_concat(rrb_slice(..), mid), rrb_slice(..)).
+// The tree is made relaxed by removing single elements from it, and every edit
+// replaces up to MAX_RANGE elements at a random index. All memory is allocated
+// through a counting allocator instead of the garbage collector. Prints the
+// allocations, bytes allocated and nanoseconds per edit, first for the
+// concatenations and then for rrb_splice.
+
+#define RELAXATIONS 50
+#define MAX_RANGE 64
+#define EDITS 10000
+
+typedef struct {
+  uint64_t mallocs;
+  uint64_t bytes;
+} AllocCount;
+
+static void* count_malloc(size_t size, void *ctx) {
+  ((AllocCount *) ctx)->mallocs++;
+  ((AllocCount *) ctx)->bytes += size;
+  return calloc(1, size);
+}
+
+static void* count_malloc_atomic(size_t size, void *ctx) {
+  ((AllocCount *) ctx)->mallocs++;
+  ((AllocCount *) ctx)->bytes += size;
+  return malloc(size);
+}
+
+static void* count_realloc(void *ptr, size_t size, void *ctx) {
+  return realloc(ptr, size);
+}
+
+static void count_free(void *ptr, void *ctx) {
+  free(ptr);
+}
+
+static long long nanoseconds_since(struct timespec *time_start) {
+  struct timespec time_stop;
+  clock_gettime(CLOCK_MONOTONIC, &time_stop);
+  long long nanoseconds_elapsed = (time_stop.tv_sec - time_start->tv_sec) * 1000000000LL;
+  nanoseconds_elapsed += (time_stop.tv_nsec - time_start->tv_nsec);
+  return nanoseconds_elapsed;
+}
+
+static uint32_t parse_count(const char *arg, const char *name) {
+  char *end;
+  uint32_t count = (uint32_t) strtol(arg, &end, 10);
+  if (*end || count == 0) {
+    fprintf(stderr, "Error, expects %s to be a positive number, was '%s'.\n",
+            name, arg);
+    exit(1);
+  }
+  return count;
+}
+
+// Does every edit on rrb, and prints the allocations, bytes and nanoseconds
+// per edit. Returns the total element count of the results.
+static RRBIndex edit_all(const RRB *rrb, const RRB *mid, const uint32_t *from,
+                         const uint32_t *to, int splice, AllocCount *count) {
+  const RRBIndex size = rrb_count(rrb);
+  const AllocCount before = *count;
+  struct timespec time_start;
+  clock_gettime(CLOCK_MONOTONIC, &time_start);
+  RRBIndex total = 0;
+  for (uint32_t i = 0; i < EDITS; i++) {
+    const RRB *edited;
+    if (splice) {
+      edited = rrb_splice(rrb, from[i], to[i], mid);
+    }
+    else {
+      const RRB *prefix = rrb_slice(rrb, 0, from[i]);
+      const RRB *suffix = rrb_slice(rrb, to[i], size);
+      const RRB *left = rrb_concat(prefix, mid);
+      edited = rrb_concat(left, suffix);
+      rrb_release(left);
+      rrb_release(suffix);
+      rrb_release(prefix);
+    }
+    total += rrb_count(edited);
+    rrb_release(edited);
+  }
+  const double ns = (double) nanoseconds_since(&time_start) / EDITS;
+  printf("%.1f %.0f %.0f\n",
+         (double) (count->mallocs - before.mallocs) / EDITS,
+         (double) (count->bytes - before.bytes) / EDITS, ns);
+  return total;
+}
+
+int main(int argc, char *argv[]) {
+  AllocCount count = {0, 0};
+  const RRBAllocator allocator = {
+    .malloc = count_malloc,
+    .atomic_malloc = count_malloc_atomic,
+    .realloc = count_realloc,
+    .free = count_free,
+    .ctx = &count
+  };
+  rrb_set_allocator(&allocator);
+  if (argc != 3) {
+    fprintf(stderr, "Expected 2 arguments (element count and replacement "
+            "size), got %d\nExiting...\n", argc - 1);
+    exit(1);
+  }
+  const uint32_t size = parse_count(argv[1], "first argument");
+  const uint32_t mid_size = parse_count(argv[2], "second argument");
+  srand(0);
+
+  const RRB *rrb = rrb_create();
+  for (uint32_t i = 0; i < size + RELAXATIONS; i++) {
+    const RRB *pushed = rrb_push(rrb, (void *) (uintptr_t) i);
+    rrb_release(rrb);
+    rrb = pushed;
+  }
+  for (uint32_t i = 0; i < RELAXATIONS; i++) {
+    const RRB *removed = rrb_remove_at(rrb, (uint32_t) rand() % rrb_count(rrb));
+    rrb_release(rrb);
+    rrb = removed;
+  }
+  const RRB *mid = rrb_create();
+  for (uint32_t i = 0; i < mid_size; i++) {
+    const RRB *pushed = rrb_push(mid, (void *) (uintptr_t) i);
+    rrb_release(mid);
+    mid = pushed;
+  }
+
+  uint32_t *from = malloc(EDITS * sizeof(uint32_t));
+  uint32_t *to = malloc(EDITS * sizeof(uint32_t));
+  for (uint32_t i = 0; i < EDITS; i++) {
+    from[i] = (uint32_t) rand() % size;
+    to[i] = from[i] + (uint32_t) rand() % (MAX_RANGE + 1);
+    if (to[i] > size) {
+      to[i] = size;
+    }
+  }
+
+  fprintf(stderr, "%d edits of %u elements, replacing up to %d elements with "
+          "%u\n", EDITS, size, MAX_RANGE, mid_size);
+  fprintf(stderr, "allocations, bytes and ns per edit, for concatenated slices "
+          "and rrb_splice:\n");
+  const RRBIndex concat_total = edit_all(rrb, mid, from, to, 0, &count);
+  const RRBIndex splice_total = edit_all(rrb, mid, from, to, 1, &count);
+  if (concat_total != splice_total) {
+    fprintf(stderr, "The spliced and concatenated trees differ in size.\n");
+    exit(1);
+  }
+  free(from);
+  free(to);
+  rrb_release(mid);
+  rrb_release(rrb);
+  exit(0);
+}
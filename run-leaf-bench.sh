@@ -0,0 +1,41 @@
+#!/usr/bin/env bash
+
+# Compares combinations of internal and leaf branching. Every combination is
+# configured and built in turn, and the line of branching_rrb describing the
+# configured tree is appended to the output file.
+
+# First ensure that configure is existing
+if [ ! -x configure ]; then
+    autoreconf --install
+fi
+
+export CC=${CC:-'clang'}
+export CFLAGS=${CFLAGS:-'-Ofast'}
+
+COMBINATIONS=${COMBINATIONS:-"5:5 5:6 5:7 5:8 4:4 4:6 4:8 3:7 3:8"}
+SIZE=${SIZE:-1000000}
+# Further options passed to configure, e.g. --with-memory=refcount
+CONFIGURE_FLAGS=${CONFIGURE_FLAGS:-}
+FILE=${1:-"benchmark-suite/leaves/rrb-leaves-${SIZE}.dat"}
+
+mkdir -p "$(dirname "$FILE")"
+echo "# bits leaf_bits push nth update scan concat" > "$FILE"
+
+for c in $COMBINATIONS; do
+    b=${c%:*}
+    l=${c#*:}
+    FLAGS="--with-branching=$b --with-leaf-branching=$l $CONFIGURE_FLAGS"
+    echo ./configure $FLAGS
+    ./configure $FLAGS > /dev/null
+    make clean > /dev/null
+    if ! make > /dev/null || ! make -C benchmark-suite branching_rrb > /dev/null; then
+        echo "Build failed with following setup:"
+        echo "CC='$CC' CFLAGS='$CFLAGS' ./configure $FLAGS && make"
+        exit 1
+    fi
+    # rrb_ops(bits) is the configured tree, the other lines are the instances.
+    ./benchmark-suite/branching_rrb "$SIZE" 2> /dev/null \
+        | awk -v b="$b" '$1 == b' >> "$FILE"
+done
+
+cat "$FILE"
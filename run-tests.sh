@@ -13,8 +13,12 @@ OPT_PERMS=$(( 2 ** ${#OPTIONS[@]} ))
 
 if [ "$1" = "full" ]; then
     BRANCHING=`seq 2 5`
+    LEAF_EXTRA="0 2"
+    COUNT_BITS="32 64"
 else
     BRANCHING=5
+    LEAF_EXTRA=0
+    COUNT_BITS=32
 fi
 
 function run_with {
@@ -31,8 +35,11 @@ function run_with {
 }
 
 for b in $BRANCHING; do 
+  for l in $LEAF_EXTRA; do
+   for c in $COUNT_BITS; do
     for (( i=0; i < OPT_PERMS; i++ )); do
-        FLAGS="--with-branching=$b"
+        FLAGS="--with-branching=$b --with-leaf-branching=$(( b + l ))"
+        FLAGS="$FLAGS --with-count-bits=$c"
         for (( j=0; j < ${#OPTIONS[@]}; j++)); do
             if [ $(( (i >> j) & 1)) -eq 1 ]; then
                 ENABLE_PRE="enable"
@@ -43,4 +50,6 @@ for b in $BRANCHING; do
         done
         run_with "$FLAGS"
     done
+   done
+  done
 done
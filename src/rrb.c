@@ -21,12 +21,20 @@
  *
  */
 
+#ifdef RRB_INSTANCE_BITS
+#include "rrb_instance.h"
+#endif
 #include "rrb_alloc.h"
+#include <assert.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
 #include "rrb.h"
 
+#if defined(RRB_SIMD_SEARCH) && defined(__SSE2__)
+#define RRB_SSE2_SEARCH
+#include <emmintrin.h>
+#endif
 
 #ifndef true
 #define true 1
@@ -46,55 +54,198 @@
 
 // Typical stuff
 #define RRB_SHIFT(rrb) (rrb->shift)
-#define INC_SHIFT(shift) (shift + (uint32_t) RRB_BITS)
-#define DEC_SHIFT(shift) (shift - (uint32_t) RRB_BITS)
 #define LEAF_NODE_SHIFT ((uint32_t) 0)
-
-// Abusing allocated pointers being unique to create GUIDs: using a single
-// malloc to create a guid.
-#define GUID_DECLARATION const void *guid;
+// A shift is the position of the bits picking a child of the node: 0 in
+// leaves, RRB_LEAF_BITS in the nodes right above them, and RRB_BITS more for
+// every level further up.
+#define INC_SHIFT(shift) \
+  ((shift) == LEAF_NODE_SHIFT ? (uint32_t) RRB_LEAF_BITS \
+                              : (shift) + (uint32_t) RRB_BITS)
+#define DEC_SHIFT(shift) \
+  ((shift) == (uint32_t) RRB_LEAF_BITS ? LEAF_NODE_SHIFT \
+                                       : (shift) - (uint32_t) RRB_BITS)
+
+// Transients modify the nodes they own in place. Owners are identified by
+// GUIDs handed out by a counter, which, unlike addresses, are never reused. 0
+// means that no transient owns the node.
+typedef uint64_t Guid;
+#define GUID_BITS 47
+#define GUID_DECLARATION Guid guid : GUID_BITS;
 
 typedef enum {LEAF_NODE, INTERNAL_NODE} NodeType;
 
-typedef struct TreeNode {
-  NodeType type;
-  uint32_t len;
+// Every node starts with a single word: Its length, its NodeType, whether its
+// size table is fused with it (only for internal nodes), whether its children
+// are raw values instead of pointers (only for leaf nodes), and its GUID.
+#define NODE_HEADER \
+  uint64_t len : 14; \
+  uint64_t type : 1; \
+  uint64_t fused : 1; \
+  uint64_t unboxed : 1; \
   GUID_DECLARATION
+
+#if RRB_BITS > 12 || RRB_LEAF_BITS > 12
+#error "Node lengths are stored in 14 bits, which fits at most 12 bits per branching."
+#endif
+
+#if RRB_LEAF_BITS < RRB_BITS
+#error "Leaves can't be narrower than internal nodes."
+#endif
+
+typedef struct TreeNode {
+  NODE_HEADER
 } TreeNode;
 
 typedef struct LeafNode {
-  NodeType type;
-  uint32_t len;
-  GUID_DECLARATION
+  NODE_HEADER
   const void *child[];
 } LeafNode;
 
+// Size tables hold the cumulative sizes of a node's children. A node of height
+// `shift` contains at most RRB_BRANCHING << shift elements, so the tables of
+// the lowest nodes store their sizes as uint16_t instead of uint32_t, and only
+// the tables high enough to exceed uint32_t store them as uint64_t. Use the
+// size_table_* functions to read and write them.
 typedef struct RRBSizeTable {
   GUID_DECLARATION
+  uint64_t width : 4; // Bytes per size
   uint32_t size[];
 } RRBSizeTable;
 
+#if RRB_COUNT_BITS == 64
+#define SIZE_TABLE_WIDTH(shift) \
+  ((shift) + RRB_BITS < 16 ? sizeof(uint16_t) \
+   : (shift) + RRB_BITS < 32 ? sizeof(uint32_t) : sizeof(uint64_t))
+#else
+#define SIZE_TABLE_WIDTH(shift) \
+  ((shift) + RRB_BITS < 16 ? sizeof(uint16_t) : sizeof(uint32_t))
+#endif
+
 typedef struct InternalNode {
-  NodeType type;
-  uint32_t len;
-  GUID_DECLARATION
+  NODE_HEADER
   RRBSizeTable *size_table;
   struct InternalNode *child[];
 } InternalNode;
 
 struct RRB_ {
-  uint32_t cnt;
+  RRBIndex cnt;
   uint32_t shift;
   uint32_t tail_len;
+  // The branching factors of the instance which built the RRB-tree. Instances
+  // lay out their nodes differently, so they must only get trees of their own.
+  uint8_t bits;
+  uint8_t leaf_bits;
   LeafNode *tail;
   TreeNode *root;
 };
 
+#define CHECK_BRANCHING(rrb)                                    \
+  assert((rrb) == NULL || ((rrb)->bits == RRB_BITS              \
+                           && (rrb)->leaf_bits == RRB_LEAF_BITS))
+
+// An iterator keeps the path down to the leaf it currently reads from, so that
+// it only has to climb when the leaf is exhausted.
+struct RRBIterator_ {
+  const RRB *rrb;
+  const LeafNode *leaf;
+  RRBIndex index;
+  RRBIndex end;
+  uint32_t leaf_pos;
+  uint32_t leaf_len;
+  uint32_t height;
+  const InternalNode *path[RRB_MAX_HEIGHT];
+  uint32_t path_pos[RRB_MAX_HEIGHT];
+};
+
 static LeafNode EMPTY_LEAF = {.type = LEAF_NODE, .len = 0};
 static const RRB EMPTY_RRB = {.cnt = 0, .shift = 0, .root = NULL,
-                              .tail_len = 0, .tail = &EMPTY_LEAF};
+                              .tail_len = 0, .tail = &EMPTY_LEAF,
+                              .bits = RRB_BITS, .leaf_bits = RRB_LEAF_BITS};
 
-static RRBSizeTable* size_table_create(uint32_t len);
+/**
+ * Returns true if the size table of `node` is fused with it: Stored in the same
+ * block, right after the children. Fused tables are never shared, so clones of
+ * the node get a copy of the table.
+ */
+static inline int size_table_fused(const InternalNode *node) {
+  return node->fused;
+}
+
+static inline size_t size_table_width(const RRBSizeTable *table) {
+  return table->width;
+}
+
+// The bytes needed for a size table with `len` entries in a node of height
+// `shift`.
+static inline size_t size_table_bytes(uint32_t shift, uint32_t len) {
+  return sizeof(RRBSizeTable) + len * SIZE_TABLE_WIDTH(shift);
+}
+
+static inline RRBIndex size_table_get(const RRBSizeTable *table, uint32_t i) {
+  switch (table->width) {
+  case sizeof(uint16_t):
+    return ((const uint16_t *) table->size)[i];
+#if RRB_COUNT_BITS == 64
+  case sizeof(uint64_t):
+    return ((const uint64_t *) table->size)[i];
+#endif
+  default:
+    return table->size[i];
+  }
+}
+
+static inline void size_table_set(RRBSizeTable *table, uint32_t i,
+                                  RRBIndex size) {
+  switch (table->width) {
+  case sizeof(uint16_t):
+    ((uint16_t *) table->size)[i] = (uint16_t) size;
+    break;
+#if RRB_COUNT_BITS == 64
+  case sizeof(uint64_t):
+    ((uint64_t *) table->size)[i] = size;
+    break;
+#endif
+  default:
+    table->size[i] = (uint32_t) size;
+  }
+}
+
+/**
+ * Copies `len` sizes from `from`, starting at `start`, into the start of `to`.
+ * Both tables must belong to nodes of the same height.
+ */
+static inline void size_table_copy(RRBSizeTable *to, const RRBSizeTable *from,
+                                   uint32_t start, uint32_t len) {
+  const size_t width = size_table_width(from);
+  memcpy(to->size, (const char *) from->size + start * width, len * width);
+}
+
+#include "rrb_arena.h"
+#include "rrb_pool.h"
+#include "rrb_refcount.h"
+
+// Leaves allocated while rrb_unboxed is set hold raw values, see UNBOXED_SCOPE.
+// They are atomic, so the GC doesn't scan them for pointers.
+static RRB_THREAD_LOCAL int rrb_unboxed;
+
+#define LEAF_MALLOC(size) \
+  (rrb_unboxed ? NODE_MALLOC_ATOMIC(size) : NODE_MALLOC(size))
+
+static inline int unboxed_enter(void) {
+  int saved = rrb_unboxed;
+  rrb_unboxed = true;
+  return saved;
+}
+
+static inline void unboxed_leave(int *saved) {
+  rrb_unboxed = *saved;
+}
+
+// Makes the rest of the enclosing block create unboxed leaves.
+#define UNBOXED_SCOPE() \
+  int unboxed_saved __attribute__((cleanup(unboxed_leave))) = unboxed_enter()
+
+static RRBSizeTable* size_table_create(uint32_t len, uint32_t shift);
 static RRBSizeTable* size_table_clone(const RRBSizeTable* original, uint32_t len);
 static RRBSizeTable* size_table_inc(const RRBSizeTable *original, uint32_t len);
 
@@ -104,15 +255,16 @@ static InternalNode* concat_sub_tree(TreeNode *left_node, uint32_t left_shift,
 static InternalNode* rebalance(InternalNode *left, InternalNode *centre,
                                InternalNode *right, uint32_t shift,
                                char is_top);
-static uint32_t* create_concat_plan(InternalNode *all, uint32_t *top_len);
+static uint32_t create_concat_plan(InternalNode *const *children, uint32_t len,
+                                   uint32_t *node_count, uint32_t branching);
 static InternalNode* execute_concat_plan(InternalNode *all, uint32_t *node_sizes,
                                          uint32_t slen, uint32_t shift);
 static uint32_t find_shift(TreeNode *node);
 static InternalNode* set_sizes(InternalNode *node, uint32_t shift);
-static uint32_t size_sub_trie(TreeNode *node, uint32_t parent_shift);
-static uint32_t sized_pos(const InternalNode *node, uint32_t *index,
-                          uint32_t sp);
-static const InternalNode* sized(const InternalNode *node, uint32_t *index,
+static RRBIndex size_sub_trie(TreeNode *node, uint32_t parent_shift);
+static inline uint32_t sized_pos(const InternalNode *node, RRBIndex *index,
+                                 uint32_t sp);
+static const InternalNode* sized(const InternalNode *node, RRBIndex *index,
                                  uint32_t sp);
 
 static LeafNode* leaf_node_clone(const LeafNode *original);
@@ -132,47 +284,74 @@ static InternalNode* internal_node_copy(InternalNode *original, uint32_t start,
 static InternalNode* internal_node_new_above1(InternalNode *child);
 static InternalNode* internal_node_new_above(InternalNode *left, InternalNode *right);
 
-static RRB* slice_right(const RRB *rrb, const uint32_t right);
+static RRB* slice_right(const RRB *rrb, const RRBIndex right);
 static TreeNode* slice_right_rec(uint32_t *total_shift, const TreeNode *root,
-                                  uint32_t right, uint32_t shift,
+                                  RRBIndex right, uint32_t shift,
                                   char has_left);
-static const RRB* slice_left(RRB *rrb, uint32_t left);
+static const RRB* slice_left(RRB *rrb, RRBIndex left);
 static TreeNode* slice_left_rec(uint32_t *total_shift, const TreeNode *root,
-                                uint32_t left, uint32_t shift,
+                                RRBIndex left, uint32_t shift,
                                 char has_right);
 
 static RRB* rrb_head_clone(const RRB *original);
 
+static TransientRRB* transient_create(const RRB *rrb);
+static const RRB* transient_persist(TransientRRB *trrb);
+
+static void iterator_init(RRBIterator *it, const RRB *rrb, RRBIndex index,
+                          RRBIndex end);
+static void iterator_next_leaf(RRBIterator *it);
+
 static RRB* push_down_tail(const RRB *restrict rrb, RRB *restrict new_rrb,
                            const LeafNode *restrict new_tail);
 static void promote_rightmost_leaf(RRB *new_rrb);
 
+#ifndef RRB_INSTANCE_BITS
+static void instances_set_allocator(const RRBAllocator *allocator);
+static void instances_set_element_hooks(RRBElementFn retain,
+                                        RRBElementFn release);
+#endif
 
 
-static RRBSizeTable* size_table_create(uint32_t size) {
-  RRBSizeTable *table = RRB_MALLOC(sizeof(RRBSizeTable)
-                                  + size * sizeof(uint32_t));
+
+static RRBSizeTable* size_table_create(uint32_t size, uint32_t shift) {
+  RRBSizeTable *table = NODE_MALLOC(size_table_bytes(shift, size));
+  table->width = SIZE_TABLE_WIDTH(shift);
   return table;
 }
 
 static RRBSizeTable* size_table_clone(const RRBSizeTable *original,
                                       uint32_t len) {
-  RRBSizeTable *clone = RRB_MALLOC(sizeof(RRBSizeTable)
-                                   + len * sizeof(uint32_t));
-  memcpy(&clone->size, &original->size, sizeof(uint32_t) * len);
+  RRBSizeTable *clone = NODE_MALLOC(sizeof(RRBSizeTable)
+                                    + len * size_table_width(original));
+  clone->width = original->width;
+  size_table_copy(clone, original, 0, len);
   return clone;
 }
 
 static inline RRBSizeTable* size_table_inc(const RRBSizeTable *original,
                                            uint32_t len) {
-  RRBSizeTable *incr = RRB_MALLOC(sizeof(RRBSizeTable) +
-                                  (len + 1) * sizeof(uint32_t));
-  memcpy(&incr->size, &original->size, sizeof(uint32_t) * len);
+  RRBSizeTable *incr = NODE_MALLOC(sizeof(RRBSizeTable) +
+                                   (len + 1) * size_table_width(original));
+  incr->width = original->width;
+  size_table_copy(incr, original, 0, len);
   return incr;
 }
 
+/**
+ * Returns a size table for `clone`, a fresh clone of a node with a size table,
+ * which may be modified. Fused tables are copied along with their node, whereas
+ * others may be shared and are cloned.
+ */
+static RRBSizeTable* size_table_editable(InternalNode *clone) {
+  if (size_table_fused(clone)) {
+    return clone->size_table;
+  }
+  return size_table_clone(clone->size_table, clone->len);
+}
+
 static RRB* rrb_head_clone(const RRB* original) {
-  RRB *clone = RRB_MALLOC(sizeof(RRB));
+  RRB *clone = NODE_MALLOC(sizeof(RRB));
   memcpy(clone, original, sizeof(RRB));
   return clone;
 }
@@ -181,17 +360,141 @@ const RRB* rrb_create() {
   return &EMPTY_RRB;
 }
 
+void rrb_set_allocator(const RRBAllocator *allocator) {
+  rrb_allocator = *allocator;
+#ifndef RRB_INSTANCE_BITS
+  instances_set_allocator(allocator);
+#endif
+}
+
+const RRBAllocator* rrb_get_allocator() {
+  return &rrb_allocator;
+}
+
+RRBArena* rrb_arena_create() {
+  RRBArena *arena = RRB_MALLOC(sizeof(RRBArena));
+  return arena;
+}
+
+void rrb_arena_reset(RRBArena *arena) {
+#ifdef RRB_REFCOUNT
+  rc_arena_release(arena);
+#endif
+  arena_reclaim(arena);
+}
+
+void rrb_arena_destroy(RRBArena *arena) {
+  rrb_arena_reset(arena);
+  arena_free_slabs(arena->free_slabs);
+#ifdef RRB_REFCOUNT
+  if (arena->held != NULL) {
+    RRB_FREE(arena->held);
+  }
+#endif
+  RRB_FREE(arena);
+}
+
+const RRB* rrb_retain(const RRB *rrb) {
+  CHECK_BRANCHING(rrb);
+#ifdef RRB_REFCOUNT
+  rc_retain_head(rrb);
+#endif
+  return rrb;
+}
+
+void rrb_release(const RRB *rrb) {
+  CHECK_BRANCHING(rrb);
+#ifdef RRB_REFCOUNT
+  rc_release_head(rrb);
+#else
+  (void) rrb;
+#endif
+}
+
+void rrb_set_element_hooks(RRBElementFn retain, RRBElementFn release) {
+#ifdef RRB_REFCOUNT
+  rc_element_retain = retain;
+  rc_element_release = release;
+#endif
+#ifndef RRB_INSTANCE_BITS
+  instances_set_element_hooks(retain, release);
+#endif
+}
+
 static RRB* rrb_mutable_create() {
-  RRB *rrb = RRB_MALLOC(sizeof(RRB));
+  RRB *rrb = NODE_MALLOC(sizeof(RRB));
+  rrb->bits = RRB_BITS;
+  rrb->leaf_bits = RRB_LEAF_BITS;
   return rrb;
 }
 
+/**
+ * Builds the RRB-tree bottom-up: The last (up to RRB_LEAF_BRANCHING) elements are
+ * placed in the tail, the rest are copied into full leaf nodes. The levels
+ * above are then built without size tables, as every node except the rightmost
+ * on each level is full.
+ */
+const RRB* rrb_from_array(const void *const *elems, RRBIndex n) {
+  RC_SCOPE_BEGIN();
+  if (n == 0) {
+    RC_RETURN(rrb_create());
+  }
+  RRB *rrb = rrb_mutable_create();
+  const uint32_t tail_len = (uint32_t) ((n - 1) & RRB_LEAF_MASK) + 1;
+  const RRBIndex trie_len = n - tail_len;
+
+  LeafNode *tail = leaf_node_create(tail_len);
+  memcpy(tail->child, &elems[trie_len], tail_len * sizeof(void *));
+  rrb->cnt = n;
+  rrb->tail = tail;
+  rrb->tail_len = tail_len;
+  rrb->shift = LEAF_NODE_SHIFT;
+  rrb->root = NULL;
+
+  if (trie_len == 0) {
+    RC_RETURN(rrb);
+  }
+
+  RRBIndex level_len = trie_len >> RRB_LEAF_BITS;
+  TreeNode **level = RRB_MALLOC(level_len * sizeof(TreeNode *));
+  for (RRBIndex i = 0; i < level_len; i++) {
+    LeafNode *leaf = leaf_node_create(RRB_LEAF_BRANCHING);
+    memcpy(leaf->child, &elems[i << RRB_LEAF_BITS],
+           RRB_LEAF_BRANCHING * sizeof(void *));
+    level[i] = (TreeNode *) leaf;
+  }
+
+  uint32_t shift = LEAF_NODE_SHIFT;
+  while (level_len > 1) {
+    shift = INC_SHIFT(shift);
+    const RRBIndex parent_len = ((level_len - 1) >> RRB_BITS) + 1;
+    // Parents are written into the level array as we go: parent i is stored at
+    // index i, after its children at index i * RRB_BRANCHING and above are read.
+    for (RRBIndex i = 0; i < parent_len; i++) {
+      const RRBIndex start = i << RRB_BITS;
+      const uint32_t len = (uint32_t) MIN(RRB_BRANCHING, level_len - start);
+      InternalNode *parent = internal_node_create(len);
+      memcpy(parent->child, &level[start], len * sizeof(InternalNode *));
+      level[i] = (TreeNode *) parent;
+    }
+    level_len = parent_len;
+  }
+
+  rrb->root = level[0];
+  rrb->shift = shift;
+  RRB_FREE(level);
+  RC_RETURN(rrb);
+}
+
 const RRB* rrb_concat(const RRB *left, const RRB *right) {
+  CHECK_BRANCHING(left);
+  CHECK_BRANCHING(right);
+  RC_SCOPE_BEGIN();
   if (left->cnt == 0) {
-    return right;
+    RC_RETURN(right);
   }
   else if (right->cnt == 0) {
-    return left;
+    RC_RETURN(left);
   }
   else {
     if (right->root == NULL) {
@@ -200,24 +503,24 @@ const RRB* rrb_concat(const RRB *left, const RRB *right) {
       new_rrb->cnt += right->cnt;
 
       // skip merging if left tail is full.
-      if (left->tail_len == RRB_BRANCHING) {
+      if (left->tail_len == RRB_LEAF_BRANCHING) {
         new_rrb->tail_len = right->tail_len;
-        return push_down_tail(left, new_rrb, right->tail);
+        RC_RETURN(push_down_tail(left, new_rrb, right->tail));
       }
       // We can merge both tails into a single tail.
-      else if (left->tail_len + right->tail_len <= RRB_BRANCHING) {
+      else if (left->tail_len + right->tail_len <= RRB_LEAF_BRANCHING) {
         const uint32_t new_tail_len = left->tail_len + right->tail_len;
         LeafNode *new_tail = leaf_node_merge(left->tail, right->tail);
         new_rrb->tail = new_tail;
         new_rrb->tail_len = new_tail_len;
-        return new_rrb;
+        RC_RETURN(new_rrb);
       }
       else { // must push down something, and will have elements remaining in
              // the right tail
-        LeafNode *push_down = leaf_node_create(RRB_BRANCHING);
+        LeafNode *push_down = leaf_node_create(RRB_LEAF_BRANCHING);
         memcpy(&push_down->child[0], &left->tail->child[0],
                left->tail_len * sizeof(void *));
-        const uint32_t right_cut = RRB_BRANCHING - left->tail_len;
+        const uint32_t right_cut = RRB_LEAF_BRANCHING - left->tail_len;
         memcpy(&push_down->child[left->tail_len], &right->tail->child[0],
                right_cut * sizeof(void *));
 
@@ -240,7 +543,7 @@ const RRB* rrb_concat(const RRB *left, const RRB *right) {
         memcpy(&left_imitation, left, sizeof(RRB));
         left_imitation.cnt = new_rrb->cnt - new_tail_len;
 
-        return push_down_tail(&left_imitation, new_rrb, new_tail);
+        RC_RETURN(push_down_tail(&left_imitation, new_rrb, new_tail));
       }
     }
     left = push_down_tail(left, rrb_head_clone(left), NULL);
@@ -257,7 +560,7 @@ const RRB* rrb_concat(const RRB *left, const RRB *right) {
                                            RRB_SHIFT(new_rrb));
     new_rrb->tail = right->tail;
     new_rrb->tail_len = right->tail_len;
-    return new_rrb;
+    RC_RETURN(new_rrb);
   }
 }
 
@@ -289,7 +592,7 @@ static InternalNode* concat_sub_tree(TreeNode *left_node, uint32_t left_shift,
       LeafNode *right_leaf = (LeafNode *) right_node;
       // We don't do this if we're not at top, as we'd have to zip stuff above
       // as well.
-      if (is_top && (left_leaf->len + right_leaf->len) <= RRB_BRANCHING) {
+      if (is_top && (left_leaf->len + right_leaf->len) <= RRB_LEAF_BRANCHING) {
         // Can put them in a single node
         LeafNode *merged = leaf_node_merge(left_leaf, right_leaf);
         return internal_node_new_above1((InternalNode *) merged);
@@ -318,34 +621,44 @@ static InternalNode* concat_sub_tree(TreeNode *left_node, uint32_t left_shift,
   }
 }
 
+// The copies are unboxed if made in an UNBOXED_SCOPE. (Only the empty leaf is
+// shared by both kinds of vectors, and it has no children to misinterpret.)
+
 static LeafNode* leaf_node_clone(const LeafNode *original) {
   size_t size = sizeof(LeafNode) + original->len * sizeof(void *);
-  LeafNode *clone = RRB_MALLOC(size);
+  LeafNode *clone = LEAF_MALLOC(size);
   memcpy(clone, original, size);
+  clone->unboxed = rrb_unboxed;
   return clone;
 }
 
 static LeafNode* leaf_node_inc(const LeafNode *original) {
   size_t size = sizeof(LeafNode) + original->len * sizeof(void *);
-  LeafNode *inc = RRB_MALLOC(size + sizeof(void *));
+  LeafNode *inc = LEAF_MALLOC(size + sizeof(void *));
   memcpy(inc, original, size);
+  inc->unboxed = rrb_unboxed;
   inc->len++;
   return inc;
 }
 
 static LeafNode* leaf_node_dec(const LeafNode *original) {
   size_t size = sizeof(LeafNode) + (original->len - 1) * sizeof(void *);
-  LeafNode *dec = RRB_MALLOC(size); // assumes size > 1
+  LeafNode *dec = LEAF_MALLOC(size); // assumes size > 1
   memcpy(dec, original, size);
+  dec->unboxed = rrb_unboxed;
   dec->len--;
   return dec;
 }
 
 
 static LeafNode* leaf_node_create(uint32_t len) {
-  LeafNode *node = RRB_MALLOC(sizeof(LeafNode) + len * sizeof(void *));
+  LeafNode *node = LEAF_MALLOC(sizeof(LeafNode) + len * sizeof(void *));
+  // Atomic memory isn't cleared, so set the whole header.
   node->type = LEAF_NODE;
   node->len = len;
+  node->fused = false;
+  node->unboxed = rrb_unboxed;
+  node->guid = 0;
   return node;
 }
 
@@ -358,14 +671,45 @@ static LeafNode* leaf_node_merge(LeafNode *left, LeafNode *right) {
 }
 
 static InternalNode* internal_node_create(uint32_t len) {
-  InternalNode *node = RRB_MALLOC(sizeof(InternalNode)
-                              + len * sizeof(InternalNode *));
+  InternalNode *node = NODE_MALLOC(sizeof(InternalNode)
+                               + len * sizeof(InternalNode *));
   node->type = INTERNAL_NODE;
   node->len = len;
   node->size_table = NULL;
   return node;
 }
 
+/**
+ * Creates an internal node with room for a fused size table, which has to be
+ * filled in. The table stores sizes of `width` bytes, see SIZE_TABLE_WIDTH.
+ */
+static InternalNode* internal_node_create_fused(uint32_t len, size_t width) {
+  InternalNode *node = NODE_MALLOC(sizeof(InternalNode)
+                                   + len * sizeof(InternalNode *)
+                                   + sizeof(RRBSizeTable) + len * width);
+  node->type = INTERNAL_NODE;
+  node->len = len;
+  node->fused = true;
+  node->size_table = (RRBSizeTable *) &node->child[len];
+  node->size_table->width = width;
+  return node;
+}
+
+/**
+ * Copies a node with a fused size table into a node of `len` children, with as
+ * many children and sizes as fit.
+ */
+static InternalNode* internal_node_fused_copy(const InternalNode *original,
+                                              uint32_t len) {
+  InternalNode *copy = internal_node_create_fused(len,
+                                                  original->size_table->width);
+  const uint32_t copied = MIN(len, original->len);
+  copy->guid = original->guid;
+  memcpy(copy->child, original->child, copied * sizeof(InternalNode *));
+  size_table_copy(copy->size_table, original->size_table, 0, copied);
+  return copy;
+}
+
 static InternalNode* internal_node_new_above1(InternalNode *child) {
   InternalNode *above = internal_node_create(1);
   above->child[0] = child;
@@ -404,22 +748,31 @@ static InternalNode* internal_node_merge(InternalNode *left, InternalNode *centr
 }
 
 static InternalNode* internal_node_clone(const InternalNode *original) {
+  if (size_table_fused(original)) {
+    return internal_node_fused_copy(original, original->len);
+  }
   size_t size = sizeof(InternalNode) + original->len * sizeof(InternalNode *);
-  InternalNode *clone = RRB_MALLOC(size);
+  InternalNode *clone = NODE_MALLOC(size);
   memcpy(clone, original, size);
   return clone;
 }
 
+// The copy has room for a fused size table, as it is only used for nodes about
+// to get their sizes set.
 static InternalNode* internal_node_copy(InternalNode *original, uint32_t start,
                                         uint32_t len){
-  InternalNode *copy = internal_node_create(len);
+  InternalNode *copy = internal_node_create_fused(len,
+                                                  original->size_table->width);
   memcpy(copy->child, &original->child[start], len * sizeof(InternalNode *));
   return copy;
 }
 
 static InternalNode* internal_node_inc(const InternalNode *original) {
+  if (size_table_fused(original)) {
+    return internal_node_fused_copy(original, original->len + 1);
+  }
   size_t size = sizeof(InternalNode) + original->len * sizeof(InternalNode *);
-  InternalNode *incr = RRB_MALLOC(size + sizeof(InternalNode *));
+  InternalNode *incr = NODE_MALLOC(size + sizeof(InternalNode *));
   memcpy(incr, original, size);
   // update length
   if (incr->size_table != NULL) {
@@ -430,8 +783,11 @@ static InternalNode* internal_node_inc(const InternalNode *original) {
 }
 
 static InternalNode* internal_node_dec(const InternalNode *original) {
+  if (size_table_fused(original)) {
+    return internal_node_fused_copy(original, original->len - 1);
+  }
   size_t size = sizeof(InternalNode) + (original->len - 1) * sizeof(InternalNode *);
-  InternalNode *clone = RRB_MALLOC(size);
+  InternalNode *clone = NODE_MALLOC(size);
   memcpy(clone, original, size);
   // update length
   clone->len--;
@@ -445,12 +801,17 @@ static InternalNode* rebalance(InternalNode *left, InternalNode *centre,
                                InternalNode *right, uint32_t shift,
                                char is_top) {
   InternalNode *all = internal_node_merge(left, centre, right);
+  // all contains at most 2 * RRB_BRANCHING children, so the plan fits on the
+  // stack.
+  uint32_t node_count[2 * RRB_BRANCHING];
   // top_len is children count of the internal node returned.
-  uint32_t top_len; // populated through pointer manipulation.
-
-  uint32_t *node_count = create_concat_plan(all, &top_len);
+  const uint32_t top_len =
+    create_concat_plan(all->child, all->len, node_count,
+                       shift == INC_SHIFT(LEAF_NODE_SHIFT) ? RRB_LEAF_BRANCHING
+                                                           : RRB_BRANCHING);
 
   InternalNode *new_all = execute_concat_plan(all, node_count, top_len, shift);
+  NODE_FREE(all);
   if (top_len <= RRB_BRANCHING) {
     if (is_top == false) {
       return internal_node_new_above1(set_sizes(new_all, shift));
@@ -463,43 +824,44 @@ static InternalNode* rebalance(InternalNode *left, InternalNode *centre,
     InternalNode *new_left = internal_node_copy(new_all, 0, RRB_BRANCHING);
     InternalNode *new_right = internal_node_copy(new_all, RRB_BRANCHING,
                                                  top_len - RRB_BRANCHING);
+    NODE_FREE(new_all);
     return internal_node_new_above(set_sizes(new_left, shift),
                                    set_sizes(new_right, shift));
   }
 }
 
 /**
- * create_concat_plan takes in the large concatenated internal node and a
- * pointer to an uint32_t, which will contain the reduced size of the rebalanced
- * node. It returns a plan as an array of uint32_t's, and modifies the input
- * pointer to contain the length of said array.
+ * create_concat_plan takes in the `len` children of the large concatenated
+ * internal node, and an array of at least `len` uint32_t's. It fills the array
+ * with the plan, the sizes of the rebalanced nodes, and returns the length of
+ * the plan. `branching` is the most children (or elements, for leaves) each of
+ * the rebalanced nodes can have.
  */
 
-static uint32_t* create_concat_plan(InternalNode *all, uint32_t *top_len) {
-  uint32_t *node_count = RRB_MALLOC_ATOMIC(all->len * sizeof(uint32_t));
-
+static uint32_t create_concat_plan(InternalNode *const *children, uint32_t len,
+                                   uint32_t *node_count, uint32_t branching) {
   uint32_t total_nodes = 0;
-  for (uint32_t i = 0; i < all->len; i++) {
-    const uint32_t size = all->child[i]->len;
+  for (uint32_t i = 0; i < len; i++) {
+    const uint32_t size = children[i]->len;
     node_count[i] = size;
     total_nodes += size;
   }
 
-  const uint32_t optimal_slots = ((total_nodes-1) / RRB_BRANCHING) + 1;
+  const uint32_t optimal_slots = ((total_nodes-1) / branching) + 1;
 
-  uint32_t shuffled_len = all->len;
+  uint32_t shuffled_len = len;
   uint32_t i = 0;
   while (optimal_slots + RRB_EXTRAS < shuffled_len) {
 
     // Skip over all nodes satisfying the invariant.
-    while (node_count[i] > RRB_BRANCHING - RRB_INVARIANT) {
+    while (node_count[i] > branching - RRB_INVARIANT) {
       i++;
     }
 
     // Found short node, so redistribute over the next nodes
     uint32_t remaining_nodes = node_count[i];
     do {
-      const uint32_t min_size = MIN(remaining_nodes + node_count[i+1], RRB_BRANCHING);
+      const uint32_t min_size = MIN(remaining_nodes + node_count[i+1], branching);
       node_count[i] = min_size;
       remaining_nodes = remaining_nodes + node_count[i+1] - min_size;
       i++;
@@ -513,15 +875,15 @@ static uint32_t* create_concat_plan(InternalNode *all, uint32_t *top_len) {
     i--;
   }
 
-  *top_len = shuffled_len;
-  return node_count;
+  return shuffled_len;
 }
 
 static InternalNode* execute_concat_plan(InternalNode *all, uint32_t *node_size,
                                          uint32_t slen, uint32_t shift) {
   // the all vector doesn't have sizes set yet.
 
-  InternalNode *new_all = internal_node_create(slen);
+  InternalNode *new_all = internal_node_create_fused(slen,
+                                                     SIZE_TABLE_WIDTH(shift));
   // Current old node index to copy from
   uint32_t idx = 0;
 
@@ -589,7 +951,9 @@ static InternalNode* execute_concat_plan(InternalNode *all, uint32_t *node_size,
         new_all->child[i] = old;
       }
       else {
-        InternalNode *new_node = internal_node_create(new_size);
+        InternalNode *new_node =
+          internal_node_create_fused(new_size,
+                                     SIZE_TABLE_WIDTH(DEC_SHIFT(shift)));
         uint32_t cur_size = 0;
         while (cur_size < new_size) {
           const InternalNode *old_node = all->child[idx];
@@ -623,24 +987,26 @@ static uint32_t find_shift(TreeNode *node) {
   }
   else { // must be internal node
     InternalNode *inode = (InternalNode *) node;
-    return RRB_BITS + find_shift((TreeNode *) inode->child[0]);
+    return INC_SHIFT(find_shift((TreeNode *) inode->child[0]));
   }
 }
 
 static InternalNode* set_sizes(InternalNode *node, uint32_t shift) {
-  uint32_t sum = 0;
-  RRBSizeTable *table = size_table_create(node->len);
+  RRBIndex sum = 0;
+  RRBSizeTable *table = size_table_fused(node) ? node->size_table
+                                               : size_table_create(node->len,
+                                                                   shift);
   const uint32_t child_shift = DEC_SHIFT(shift);
 
   for (uint32_t i = 0; i < node->len; i++) {
     sum += size_sub_trie((TreeNode *) node->child[i], child_shift);
-    table->size[i] = sum;
+    size_table_set(table, i, sum);
   }
   node->size_table = table;
   return node;
 }
 
-static uint32_t size_sub_trie(TreeNode *node, uint32_t shift) {
+static RRBIndex size_sub_trie(TreeNode *node, uint32_t shift) {
   if (shift > LEAF_NODE_SHIFT) {
     InternalNode *internal = (InternalNode *) node;
     if (internal->size_table == NULL) {
@@ -648,14 +1014,14 @@ static uint32_t size_sub_trie(TreeNode *node, uint32_t shift) {
       uint32_t child_shift = DEC_SHIFT(shift);
       // TODO: for loopify recursive calls
       /* We're not sure how many are in the last child, so look it up */
-      uint32_t last_size =
+      RRBIndex last_size =
         size_sub_trie((TreeNode *) internal->child[len - 1], child_shift);
       /* We know all but the last ones are filled, and they have child_shift
          elements in them. */
-      return ((len - 1) << shift) + last_size;
+      return ((RRBIndex) (len - 1) << shift) + last_size;
     }
     else {
-      return internal->size_table->size[internal->len - 1];
+      return size_table_get(internal->size_table, internal->len - 1);
     }
   }
   else {
@@ -664,6 +1030,34 @@ static uint32_t size_sub_trie(TreeNode *node, uint32_t shift) {
   }
 }
 
+/**
+ * Returns true if a trie with the given shift and size can't hold any more
+ * elements. Only then may a node without a size table get a child after it.
+ * (The capacity wraps around to zero for the highest shifts, which is fine, as
+ * no trie can have that size.)
+ */
+static inline int trie_full(RRBIndex size, uint32_t shift) {
+  if (shift == LEAF_NODE_SHIFT) {
+    return size == RRB_LEAF_BRANCHING;
+  }
+  return size == ((RRBIndex) RRB_BRANCHING << shift);
+}
+
+/**
+ * Fills in the sizes of the children of a node without a size table, which
+ * are all full except the last one.
+ */
+static void dense_sizes(const InternalNode *node, uint32_t shift,
+                        RRBSizeTable *table) {
+  const uint32_t last = node->len - 1;
+  for (uint32_t i = 0; i < last; i++) {
+    size_table_set(table, i, (RRBIndex) (i + 1) << shift);
+  }
+  size_table_set(table, last, ((RRBIndex) last << shift)
+                 + size_sub_trie((TreeNode *) node->child[last],
+                                 DEC_SHIFT(shift)));
+}
+
 static inline RRB* rrb_tail_push(const RRB *restrict rrb, const void *restrict elt);
 
 static inline RRB* rrb_tail_push(const RRB *restrict rrb, const void *restrict elt) {
@@ -683,8 +1077,10 @@ static InternalNode** append_empty(InternalNode **to_set,
                                    uint32_t empty_height);
 
 const RRB* rrb_push(const RRB *restrict rrb, const void *restrict elt) {
-  if (rrb->tail_len < RRB_BRANCHING) {
-    return rrb_tail_push(rrb, elt);
+  CHECK_BRANCHING(rrb);
+  RC_SCOPE_BEGIN();
+  if (rrb->tail_len < RRB_LEAF_BRANCHING) {
+    RC_RETURN(rrb_tail_push(rrb, elt));
   }
   RRB *new_rrb = rrb_head_clone(rrb);
   new_rrb->cnt++;
@@ -692,15 +1088,43 @@ const RRB* rrb_push(const RRB *restrict rrb, const void *restrict elt) {
   LeafNode *new_tail = leaf_node_create(1);
   new_tail->child[0] = elt;
   new_rrb->tail_len = 1;
-  return push_down_tail(rrb, new_rrb, new_tail);
+  RC_RETURN(push_down_tail(rrb, new_rrb, new_tail));
 }
 
+/**
+ * If the elements fit in the tail, a single new tail is created. Otherwise the
+ * elements are pushed through a transient, so that every node on the rightmost
+ * path is copied at most once, regardless of how many leaves are inserted.
+ */
+const RRB* rrb_push_many(const RRB *restrict rrb, const void *const *restrict elts,
+                         RRBIndex n) {
+  CHECK_BRANCHING(rrb);
+  RC_SCOPE_BEGIN();
+  if (n == 0) {
+    RC_RETURN(rrb);
+  }
+  if (rrb->tail_len + n <= RRB_LEAF_BRANCHING) {
+    RRB *new_rrb = rrb_head_clone(rrb);
+    LeafNode *new_tail = leaf_node_create(rrb->tail_len + (uint32_t) n);
+    memcpy(new_tail->child, rrb->tail->child, rrb->tail_len * sizeof(void *));
+    memcpy(&new_tail->child[rrb->tail_len], elts, n * sizeof(void *));
+    new_rrb->cnt += n;
+    new_rrb->tail_len += n;
+    new_rrb->tail = new_tail;
+    RC_RETURN(new_rrb);
+  }
+  TransientRRB *trrb = transient_create(rrb);
+  trrb = transient_rrb_push_many(trrb, elts, n);
+  RC_RETURN(transient_persist(trrb));
+}
 
 static RRB* push_down_tail(const RRB *restrict rrb, RRB *restrict new_rrb,
                            const LeafNode *restrict new_tail) {
   const LeafNode *old_tail = new_rrb->tail;
   new_rrb->tail = new_tail;
-  if (rrb->cnt <= RRB_BRANCHING) {
+  // The count alone can't tell whether the trie is empty: A popped RRB-tree may
+  // have a small root leaf in addition to its tail.
+  if (rrb->root == NULL) {
     new_rrb->shift = LEAF_NODE_SHIFT;
     new_rrb->root = (TreeNode *) old_tail;
     return new_rrb;
@@ -710,7 +1134,7 @@ static RRB* push_down_tail(const RRB *restrict rrb, RRB *restrict new_rrb,
   // TODO: Can find last rightmost jump in constant time for pvec subvecs:
   // use the fact that (index & large_mask) == 1 << (RRB_BITS * H) - 1 -> 0 etc.
 
-  uint32_t index = rrb->cnt - 1;
+  RRBIndex index = rrb->cnt - 1;
 
   uint32_t nodes_to_copy = 0;
   uint32_t nodes_visited = 0;
@@ -730,21 +1154,21 @@ static RRB* push_down_tail(const RRB *restrict rrb, RRB *restrict new_rrb,
       // impl, the same way the size_table check only has to be done until it's
       // false.
       const uint32_t prev_shift = shift + RRB_BITS;
-      if (index >> prev_shift > 0) {
+      if (prev_shift < RRB_COUNT_BITS && index >> prev_shift > 0) {
         nodes_visited++; // this could possibly be done earlier in the code.
         goto copyable_count_end;
       }
       child_index = (index >> shift) & RRB_MASK;
       // index filtering is not necessary when the check above is performed at
       // most once.
-      index &= ~(RRB_MASK << shift);
+      index &= ~((RRBIndex) RRB_MASK << shift);
     }
     else {
       // no need for sized_pos here, luckily.
       child_index = current->len - 1;
       // Decrement index
       if (child_index != 0) {
-        index -= current->size_table->size[child_index-1];
+        index -= size_table_get(current->size_table, child_index-1);
       }
     }
     nodes_visited++;
@@ -753,7 +1177,9 @@ static RRB* push_down_tail(const RRB *restrict rrb, RRB *restrict new_rrb,
       pos = child_index;
     }
 
-    current = current->child[child_index];
+    // The slot past the last child is empty. Don't read it: The allocator only
+    // guarantees memory for the children in use.
+    current = child_index < current->len ? current->child[child_index] : NULL;
     // This will only happen in a pvec subtree
     if (current == NULL) {
       nodes_to_copy = nodes_visited;
@@ -763,7 +1189,7 @@ static RRB* push_down_tail(const RRB *restrict rrb, RRB *restrict new_rrb,
       // times.
       goto copyable_count_end;
     }
-    shift -= RRB_BITS;
+    shift = DEC_SHIFT(shift);
   }
   // if we're here, we're at the leaf node (or lowest non-leaf), which is
   // `current`
@@ -783,7 +1209,7 @@ static RRB* push_down_tail(const RRB *restrict rrb, RRB *restrict new_rrb,
   // nodes_visited set straight.
   while (shift > INC_SHIFT(LEAF_NODE_SHIFT)) {
     nodes_visited++;
-    shift -= RRB_BITS;
+    shift = DEC_SHIFT(shift);
   }
 
   // Increasing height of tree.
@@ -793,16 +1219,16 @@ static RRB* push_down_tail(const RRB *restrict rrb, RRB *restrict new_rrb,
     new_rrb->root = (TreeNode *) new_root;
     new_rrb->shift = INC_SHIFT(RRB_SHIFT(new_rrb));
 
-    // create size table if the original rrb root has a size table.
-    if (rrb->root->type != LEAF_NODE &&
-        ((const InternalNode *)rrb->root)->size_table != NULL) {
-      RRBSizeTable *table = size_table_create(2);
-      table->size[0] = rrb->cnt - old_tail->len;
+    // create size table if the original rrb root isn't full (may happen after
+    // popping or slicing a relaxed tree).
+    if (!trie_full(rrb->cnt - old_tail->len, RRB_SHIFT(rrb))) {
+      RRBSizeTable *table = size_table_create(2, RRB_SHIFT(new_rrb));
+      size_table_set(table, 0, rrb->cnt - old_tail->len);
       // If we insert the tail, the old size minus the old tail size will be the
       // amount of elements in the left branch. If there is no tail, the size is
       // just the old rrb-tree.
 
-      table->size[1] = rrb->cnt;
+      size_table_set(table, 1, rrb->cnt);
       // If we insert the tail, the old size would include the tail.
       // Consequently, it has to be the old size. If we have no tail, we append
       // a single element to the old vector, therefore it has to be one more
@@ -833,7 +1259,7 @@ static InternalNode** copy_first_k(const RRB *rrb, RRB *new_rrb, const uint32_t
                                    const uint32_t tail_size) {
   const InternalNode *current = (const InternalNode *) rrb->root;
   InternalNode **to_set = (InternalNode **) &new_rrb->root;
-  uint32_t index = rrb->cnt - 1;
+  RRBIndex index = rrb->cnt - 1;
   uint32_t shift = RRB_SHIFT(rrb);
 
   // Copy all non-leaf nodes first. Happens when shift > RRB_BRANCHING
@@ -844,22 +1270,34 @@ static InternalNode** copy_first_k(const RRB *rrb, RRB *new_rrb, const uint32_t
     if (i != k) {
       new_current = internal_node_clone(current);
       if (current->size_table != NULL) {
-        new_current->size_table = size_table_clone(new_current->size_table, new_current->len);
-        new_current->size_table->size[new_current->len-1] += tail_size;
+        new_current->size_table = size_table_editable(new_current);
+        RRBSizeTable *table = new_current->size_table;
+        size_table_set(table, new_current->len-1,
+                       size_table_get(table, new_current->len-1) + tail_size);
       }
     }
     else { // increment size of last elt -- will only happen if we append empties
       new_current = internal_node_inc(current);
-      if (current->size_table != NULL) {
-        new_current->size_table->size[new_current->len-1] =
-          new_current->size_table->size[new_current->len-2] + tail_size;
+      if (current->size_table == NULL
+          && !trie_full(size_sub_trie((TreeNode *) current->child[current->len-1],
+                                      DEC_SHIFT(shift)),
+                        DEC_SHIFT(shift))) {
+        // The last child isn't full (after a slice), so the node is relaxed as
+        // soon as it gets another child.
+        new_current->size_table = size_table_create(new_current->len, shift);
+        dense_sizes(current, shift, new_current->size_table);
+      }
+      if (new_current->size_table != NULL) {
+        RRBSizeTable *table = new_current->size_table;
+        size_table_set(table, new_current->len-1,
+                       size_table_get(table, new_current->len-2) + tail_size);
       }
     }
     *to_set = new_current;
 
     // calculate child index
     uint32_t child_index;
-    if (current->size_table == NULL) {
+    if (new_current->size_table == NULL) {
       child_index = (index >> shift) & RRB_MASK;
     }
     else {
@@ -867,14 +1305,16 @@ static InternalNode** copy_first_k(const RRB *rrb, RRB *new_rrb, const uint32_t
       child_index = new_current->len - 1;
       // Decrement index
       if (child_index != 0) {
-        index -= current->size_table->size[child_index-1];
+        index -= size_table_get(new_current->size_table, child_index-1);
       }
     }
     to_set = &new_current->child[child_index];
-    current = current->child[child_index];
+    // Read through the copy: On the last iteration, child_index may be the
+    // slot just added, which is beyond the end of current.
+    current = new_current->child[child_index];
 
     i++;
-    shift -= RRB_BITS;
+    shift = DEC_SHIFT(shift);
   }
 
   return to_set;
@@ -899,36 +1339,138 @@ static InternalNode** append_empty(InternalNode **to_set,
   }
 }
 
-static uint32_t sized_pos(const InternalNode *node, uint32_t *index,
-                          uint32_t sp) {
-  RRBSizeTable *table = node->size_table;
-  uint32_t is = *index >> sp;
-  while (table->size[is] <= *index) {
+/**
+ * Returns the position of the first of the `len` sizes from `is` and on which
+ * is larger than `index`. There must be one.
+ *
+ * With SSE2 search enabled, sizes are compared several at a time, and the
+ * remaining ones are counted without branching. It is not the default: The
+ * plain scan rarely looks at more than two sizes, and as the CPU predicts where
+ * it stops, it can fetch the child before the sizes have arrived.
+ */
+static inline uint32_t size_scan_narrow(const uint16_t *size, uint32_t is,
+                                        uint32_t len, uint32_t index) {
+#ifdef RRB_SSE2_SEARCH
+  // As sizes are unsigned, a size is at most index iff the saturated
+  // difference between them is zero.
+  const __m128i idx = _mm_set1_epi16((short) index);
+  while (is + 8 <= len) {
+    const __m128i sizes = _mm_loadu_si128((const __m128i *) &size[is]);
+    const __m128i at_most = _mm_cmpeq_epi16(_mm_subs_epu16(sizes, idx),
+                                            _mm_setzero_si128());
+    const uint32_t larger = ~_mm_movemask_epi8(at_most) & 0xFFFF;
+    if (larger != 0) {
+      return is + __builtin_ctz(larger) / 2;
+    }
+    is += 8;
+  }
+  uint32_t pos = is;
+  for (uint32_t i = is; i < len; i++) {
+    pos += size[i] <= index;
+  }
+  return pos;
+#else
+  (void) len;
+  while (size[is] <= index) {
+    is++;
+  }
+  return is;
+#endif
+}
+
+static inline uint32_t size_scan_wide(const uint32_t *size, uint32_t is,
+                                      uint32_t len, uint32_t index) {
+#ifdef RRB_SSE2_SEARCH
+  // SSE2 only compares signed integers, so flip the sign bit of both sides.
+  const __m128i bias = _mm_set1_epi32(INT32_MIN);
+  const __m128i idx = _mm_xor_si128(_mm_set1_epi32((int) index), bias);
+  while (is + 4 <= len) {
+    const __m128i sizes = _mm_xor_si128(
+      _mm_loadu_si128((const __m128i *) &size[is]), bias);
+    const uint32_t larger =
+      _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(sizes, idx)));
+    if (larger != 0) {
+      return is + __builtin_ctz(larger);
+    }
+    is += 4;
+  }
+  uint32_t pos = is;
+  for (uint32_t i = is; i < len; i++) {
+    pos += size[i] <= index;
+  }
+  return pos;
+#else
+  (void) len;
+  while (size[is] <= index) {
+    is++;
+  }
+  return is;
+#endif
+}
+
+#if RRB_COUNT_BITS == 64
+// Only the tables of the highest nodes have 64-bit sizes, and they are never
+// searched more than once per lookup, so they are always scanned plainly.
+static inline uint32_t size_scan_long(const uint64_t *size, uint32_t is,
+                                      uint64_t index) {
+  while (size[is] <= index) {
     is++;
   }
-  if (is != 0) {
-    *index -= table->size[is-1];
+  return is;
+}
+#endif
+
+// Always inlined, as lookups are notably slower when the index is passed
+// through memory to a call.
+static inline __attribute__((always_inline))
+uint32_t sized_pos(const InternalNode *node, RRBIndex *index, uint32_t sp) {
+  const RRBSizeTable *table = node->size_table;
+  uint32_t is = (uint32_t) (*index >> sp);
+  // The width follows from the height, so there's no need to read the header.
+  if (SIZE_TABLE_WIDTH(sp) == sizeof(uint16_t)) {
+    const uint16_t *size = (const uint16_t *) table->size;
+    is = size_scan_narrow(size, is, node->len, (uint32_t) *index);
+    if (is != 0) {
+      *index -= size[is-1];
+    }
+  }
+#if RRB_COUNT_BITS == 64
+  else if (SIZE_TABLE_WIDTH(sp) == sizeof(uint64_t)) {
+    const uint64_t *size = (const uint64_t *) table->size;
+    is = size_scan_long(size, is, *index);
+    if (is != 0) {
+      *index -= size[is-1];
+    }
+  }
+#endif
+  else {
+    const uint32_t *size = table->size;
+    is = size_scan_wide(size, is, node->len, (uint32_t) *index);
+    if (is != 0) {
+      *index -= size[is-1];
+    }
   }
   return is;
 }
 
-static const InternalNode* sized(const InternalNode *node, uint32_t *index,
+static const InternalNode* sized(const InternalNode *node, RRBIndex *index,
                                  uint32_t sp) {
   uint32_t is = sized_pos(node, index, sp);
   return (InternalNode *) node->child[is];
 }
 
-void* rrb_nth(const RRB *rrb, uint32_t index) {
+void* rrb_nth(const RRB *rrb, RRBIndex index) {
+  CHECK_BRANCHING(rrb);
   if (index >= rrb->cnt) {
     return NULL;
   }
-  const uint32_t tail_offset = rrb->cnt - rrb->tail_len;
+  const RRBIndex tail_offset = rrb->cnt - rrb->tail_len;
   if (tail_offset <= index) {
     return rrb->tail->child[index - tail_offset];
   }
   else {
     const InternalNode *current = (const InternalNode *) rrb->root;
-    for (uint32_t shift = RRB_SHIFT(rrb); shift > 0; shift -= RRB_BITS) {
+    for (uint32_t shift = RRB_SHIFT(rrb); shift > 0; shift = DEC_SHIFT(shift)) {
       if (current->size_table == NULL) {
         const uint32_t subidx = (index >> shift) & RRB_MASK;
         current = current->child[subidx];
@@ -937,15 +1479,208 @@ void* rrb_nth(const RRB *rrb, uint32_t index) {
         current = sized(current, &index, shift);
       }
     }
-    return ((const LeafNode *)current)->child[index & RRB_MASK];
+    return ((const LeafNode *)current)->child[index & RRB_LEAF_MASK];
   }
 }
 
-uint32_t rrb_count(const RRB *rrb) {
+/**
+ * Positions the iterator at `index`, recording the path from the root down to
+ * the leaf containing it. If `index` is in the tail, the path is left empty.
+ * The iterator stops at `end`, which must be within the RRB-tree.
+ */
+static void iterator_init(RRBIterator *it, const RRB *rrb, RRBIndex index,
+                          RRBIndex end) {
+  it->rrb = rrb;
+  it->index = index;
+  it->end = end;
+  it->height = 0;
+
+  const RRBIndex tail_offset = rrb->cnt - rrb->tail_len;
+  if (tail_offset <= index) {
+    it->leaf = rrb->tail;
+    it->leaf_len = rrb->tail_len;
+    it->leaf_pos = index - tail_offset;
+    return;
+  }
+  const InternalNode *current = (const InternalNode *) rrb->root;
+  for (uint32_t shift = RRB_SHIFT(rrb); shift > 0; shift = DEC_SHIFT(shift)) {
+    uint32_t child_index;
+    if (current->size_table == NULL) {
+      child_index = (index >> shift) & RRB_MASK;
+    }
+    else {
+      child_index = sized_pos(current, &index, shift);
+    }
+    it->path[it->height] = current;
+    it->path_pos[it->height] = child_index;
+    it->height++;
+    current = current->child[child_index];
+  }
+  it->leaf = (const LeafNode *) current;
+  it->leaf_len = it->leaf->len;
+  it->leaf_pos = index & RRB_LEAF_MASK;
+}
+
+/**
+ * Moves the iterator to the start of the next leaf. Climbs only as far up as
+ * needed to find a node with unvisited children, then walks down its leftmost
+ * path. When the trie is exhausted, the tail is the next leaf.
+ */
+static void iterator_next_leaf(RRBIterator *it) {
+  uint32_t level = it->height;
+  while (level > 0 && it->path_pos[level-1] + 1 >= it->path[level-1]->len) {
+    level--;
+  }
+  if (level == 0) {
+    it->height = 0;
+    it->leaf = it->rrb->tail;
+    it->leaf_len = it->rrb->tail_len;
+    it->leaf_pos = 0;
+    return;
+  }
+  level--;
+  it->path_pos[level]++;
+  const InternalNode *current = it->path[level]->child[it->path_pos[level]];
+  for (level++; level < it->height; level++) {
+    it->path[level] = current;
+    it->path_pos[level] = 0;
+    current = current->child[0];
+  }
+  it->leaf = (const LeafNode *) current;
+  it->leaf_len = it->leaf->len;
+  it->leaf_pos = 0;
+}
+
+RRBIterator* rrb_iterator_create(const RRB *rrb) {
+  CHECK_BRANCHING(rrb);
+  RRBIterator *it = RRB_MALLOC(sizeof(RRBIterator));
+  iterator_init(it, rrb, 0, rrb->cnt);
+  return it;
+}
+
+RRBIterator* rrb_iterator_create_range(const RRB *rrb, RRBIndex from,
+                                       RRBIndex to) {
+  CHECK_BRANCHING(rrb);
+  to = MIN(to, rrb->cnt);
+  from = MIN(from, to);
+  RRBIterator *it = RRB_MALLOC(sizeof(RRBIterator));
+  iterator_init(it, rrb, from, to);
+  return it;
+}
+
+int rrb_iterator_has_next(const RRBIterator *it) {
+  return it->index < it->end;
+}
+
+void* rrb_iterator_next(RRBIterator *it) {
+  CHECK_BRANCHING(it->rrb);
+  if (it->index >= it->end) {
+    return NULL;
+  }
+  if (it->leaf_pos == it->leaf_len) {
+    iterator_next_leaf(it);
+  }
+  it->index++;
+  return (void *) it->leaf->child[it->leaf_pos++];
+}
+
+/**
+ * Points `data` directly into the leaf node the iterator is at, and returns the
+ * amount of items it may read from there. Returns 0 when the iterator is
+ * exhausted. The items must not be modified.
+ */
+uint32_t rrb_iterator_next_chunk(RRBIterator *it, const void *const **data) {
+  CHECK_BRANCHING(it->rrb);
+  if (it->index >= it->end) {
+    return 0;
+  }
+  if (it->leaf_pos == it->leaf_len) {
+    iterator_next_leaf(it);
+  }
+  const uint32_t len = MIN(it->leaf_len - it->leaf_pos, it->end - it->index);
+  *data = &it->leaf->child[it->leaf_pos];
+  it->leaf_pos += len;
+  it->index += len;
+  return len;
+}
+
+void rrb_iterator_free(RRBIterator *it) {
+  RRB_FREE(it);
+}
+
+int rrb_chunks(const RRB *rrb, RRBIndex from, RRBIndex to, RRBChunkFn fn,
+               void *ctx) {
+  CHECK_BRANCHING(rrb);
+  to = MIN(to, rrb->cnt);
+  from = MIN(from, to);
+  RRBIterator it;
+  iterator_init(&it, rrb, from, to);
+
+  const void *const *data;
+  uint32_t len;
+  while ((len = rrb_iterator_next_chunk(&it, &data)) != 0) {
+    int res = fn(data, len, ctx);
+    if (res != 0) {
+      return res;
+    }
+  }
+  return 0;
+}
+
+RRBIndex rrb_copy_range(const RRB *rrb, RRBIndex from, RRBIndex to,
+                        void **out) {
+  CHECK_BRANCHING(rrb);
+  to = MIN(to, rrb->cnt);
+  from = MIN(from, to);
+  RRBIterator it;
+  iterator_init(&it, rrb, from, to);
+
+  const void *const *data;
+  uint32_t len;
+  void **pos = out;
+  while ((len = rrb_iterator_next_chunk(&it, &data)) != 0) {
+    memcpy(pos, data, len * sizeof(void *));
+    pos += len;
+  }
+  return to - from;
+}
+
+uint32_t rrb_chunk_at(const RRB *rrb, RRBIndex index,
+                      const void *const **data, RRBIndex *start) {
+  CHECK_BRANCHING(rrb);
+  if (index >= rrb->cnt) {
+    return 0;
+  }
+  const RRBIndex tail_offset = rrb->cnt - rrb->tail_len;
+  if (tail_offset <= index) {
+    *data = rrb->tail->child;
+    *start = tail_offset;
+    return rrb->tail_len;
+  }
+  RRBIndex pos = index;
+  const InternalNode *current = (const InternalNode *) rrb->root;
+  for (uint32_t shift = RRB_SHIFT(rrb); shift > 0; shift = DEC_SHIFT(shift)) {
+    if (current->size_table == NULL) {
+      current = current->child[(pos >> shift) & RRB_MASK];
+    }
+    else {
+      current = sized(current, &pos, shift);
+    }
+  }
+  // As in rrb_nth, the index within the leaf is in the lowest bits.
+  const LeafNode *leaf = (const LeafNode *) current;
+  *data = leaf->child;
+  *start = index - (pos & RRB_LEAF_MASK);
+  return leaf->len;
+}
+
+RRBIndex rrb_count(const RRB *rrb) {
+  CHECK_BRANCHING(rrb);
   return rrb->cnt;
 }
 
 void* rrb_peek(const RRB *rrb) {
+  CHECK_BRANCHING(rrb);
   return (void *) rrb->tail->child[rrb->tail_len-1];
 }
 
@@ -962,7 +1697,7 @@ static void promote_rightmost_leaf(RRB *new_rrb) {
 
   // populate path array
   for (i = 0, shift = LEAF_NODE_SHIFT; shift < RRB_SHIFT(new_rrb);
-       i++, shift += RRB_BITS) {
+       i++, shift = INC_SHIFT(shift)) {
     path[i+1] = path[i]->child[path[i]->len-1];
   }
 
@@ -983,7 +1718,7 @@ static void promote_rightmost_leaf(RRB *new_rrb) {
       }
       else if (i == 0 && path[i]->len == 2) {
         path[i] = path[i]->child[0];
-        new_rrb->shift -= RRB_BITS;
+        new_rrb->shift = DEC_SHIFT(new_rrb->shift);
       }
       else {
         path[i] = internal_node_dec(path[i]);
@@ -993,10 +1728,12 @@ static void promote_rightmost_leaf(RRB *new_rrb) {
       path[i] = internal_node_clone(path[i]);
       path[i]->child[path[i]->len-1] = path[i+1];
       if (path[i]->size_table != NULL) {
-        path[i]->size_table = size_table_clone(path[i]->size_table, path[i]->len);
+        path[i]->size_table = size_table_editable(path[i]);
         // this line differs, as we remove `tail_len` elements from the trie,
         // instead of just 1 as in the direct pop algorithm.
-        path[i]->size_table->size[path[i]->len-1] -= tail_len;
+        RRBSizeTable *table = path[i]->size_table;
+        size_table_set(table, path[i]->len-1,
+                       size_table_get(table, path[i]->len-1) - tail_len);
       }
     }
   }
@@ -1004,12 +1741,12 @@ static void promote_rightmost_leaf(RRB *new_rrb) {
   new_rrb->root = (TreeNode *) path[0];
 }
 
-static RRB* slice_right(const RRB *rrb, const uint32_t right) {
+static RRB* slice_right(const RRB *rrb, const RRBIndex right) {
   if (right == 0) {
     return (RRB *) rrb_create();
   }
   else if (right < rrb->cnt) {
-    const uint32_t tail_offset = rrb->cnt - rrb->tail_len;
+    const RRBIndex tail_offset = rrb->cnt - rrb->tail_len;
     // Can just cut the tail slightly
     if (tail_offset < right) {
       RRB *new_rrb = rrb_head_clone(rrb);
@@ -1040,17 +1777,17 @@ static RRB* slice_right(const RRB *rrb, const uint32_t right) {
 }
 
 static TreeNode* slice_right_rec(uint32_t *total_shift, const TreeNode *root,
-                                 uint32_t right, uint32_t shift,
+                                 RRBIndex right, uint32_t shift,
                                  char has_left) {
   const uint32_t subshift = DEC_SHIFT(shift);
-  uint32_t subidx = right >> shift;
+  uint32_t subidx = (uint32_t) (right >> shift);
   if (shift > LEAF_NODE_SHIFT) {
     const InternalNode *internal_root = (InternalNode *) root;
     if (internal_root->size_table == NULL) {
       TreeNode *right_hand_node =
         slice_right_rec(total_shift,
                         (TreeNode *) internal_root->child[subidx],
-                        right - (subidx << shift), subshift,
+                        right - ((RRBIndex) subidx << shift), subshift,
                         (subidx != 0) | has_left);
       if (subidx == 0) {
         if (has_left) {
@@ -1074,14 +1811,8 @@ static TreeNode* slice_right_rec(uint32_t *total_shift, const TreeNode *root,
     }
     else { // if (internal_root->size_table != NULL)
       RRBSizeTable *table = internal_root->size_table;
-      uint32_t idx = right;
-
-      while (table->size[subidx] <= idx) {
-        subidx++;
-      }
-      if (subidx != 0) {
-        idx -= table->size[subidx-1];
-      }
+      RRBIndex idx = right;
+      subidx = sized_pos(internal_root, &idx, shift);
 
       const TreeNode *right_hand_node =
         slice_right_rec(total_shift, internal_root->child[subidx], idx,
@@ -1091,9 +1822,9 @@ static TreeNode* slice_right_rec(uint32_t *total_shift, const TreeNode *root,
           // As there is one above us, must place the right hand node in a
           // one-node
           InternalNode *right_hand_parent = internal_node_create(1);
-          RRBSizeTable *right_hand_table = size_table_create(1);
+          RRBSizeTable *right_hand_table = size_table_create(1, shift);
 
-          right_hand_table->size[0] = right + 1;
+          size_table_set(right_hand_table, 0, right + 1);
           // TODO: Not set size_table if the underlying node doesn't have a
           // table as well.
           right_hand_parent->size_table = right_hand_table;
@@ -1108,10 +1839,10 @@ static TreeNode* slice_right_rec(uint32_t *total_shift, const TreeNode *root,
       }
       else { // if (subidx != 0)
         InternalNode *sliced_root = internal_node_create(subidx+1);
-        RRBSizeTable *sliced_table = size_table_create(subidx+1);
+        RRBSizeTable *sliced_table = size_table_create(subidx+1, shift);
 
-        memcpy(sliced_table->size, table->size, subidx * sizeof(uint32_t));
-        sliced_table->size[subidx] = right+1;
+        size_table_copy(sliced_table, table, 0, subidx);
+        size_table_set(sliced_table, subidx, right+1);
 
         memcpy(sliced_root->child, internal_root->child,
                subidx * sizeof(InternalNode *));
@@ -1134,12 +1865,12 @@ static TreeNode* slice_right_rec(uint32_t *total_shift, const TreeNode *root,
   }
 }
 
-const RRB* slice_left(RRB *rrb, uint32_t left) {
+const RRB* slice_left(RRB *rrb, RRBIndex left) {
   if (left >= rrb->cnt) {
     return rrb_create();
   }
   else if (left > 0) {
-    const uint32_t remaining = rrb->cnt - left;
+    const RRBIndex remaining = rrb->cnt - left;
 
     // If we slice into the tail, we just need to modify the tail itself
     if (remaining <= rrb->tail_len) {
@@ -1166,7 +1897,8 @@ const RRB* slice_left(RRB *rrb, uint32_t left) {
     // Ensure last element in size table is correct size, if the root is an
     // internal node.
     if (new_rrb->shift != LEAF_NODE_SHIFT && root->size_table != NULL) {
-      root->size_table->size[root->len-1] = new_rrb->cnt - rrb->tail_len;
+      size_table_set(root->size_table, root->len-1,
+                     new_rrb->cnt - rrb->tail_len);
     }
     new_rrb->tail = rrb->tail;
     new_rrb->tail_len = rrb->tail_len;
@@ -1178,13 +1910,19 @@ const RRB* slice_left(RRB *rrb, uint32_t left) {
   // resolved by slice_right itself. Perhaps not promote in the right slicing,
   // but here instead?
 
-  // This case handles leaf nodes < RRB_BRANCHING size, by redistributing
+  // This case handles leaf nodes < RRB_LEAF_BRANCHING size, by redistributing
   // values from the tail into the actual leaf node.
   if (RRB_SHIFT(rrb) == 0 && rrb->root != NULL) {
-    // two cases to handle: cnt <= RRB_BRANCHING
-    //     and (cnt - tail_len) < RRB_BRANCHING
+    // slice_right hands over the original RRB-tree when nothing is cut from
+    // it, which must be left unchanged. Both cases below have a root which
+    // isn't full.
+    if (left == 0 && rrb->root->len < RRB_LEAF_BRANCHING) {
+      rrb = rrb_head_clone(rrb);
+    }
+    // two cases to handle: cnt <= RRB_LEAF_BRANCHING
+    //     and (cnt - tail_len) < RRB_LEAF_BRANCHING
 
-    if (rrb->cnt <= RRB_BRANCHING) {
+    if (rrb->cnt <= RRB_LEAF_BRANCHING) {
       // can put all into a new tail
       LeafNode *new_tail = leaf_node_create(rrb->cnt);
 
@@ -1198,10 +1936,10 @@ const RRB* slice_left(RRB *rrb, uint32_t left) {
     }
     // no need for <= here, because if the root node is == rrb_branching, the
     // invariant is kept.
-    else if (rrb->cnt - rrb->tail_len < RRB_BRANCHING) {
+    else if (rrb->cnt - rrb->tail_len < RRB_LEAF_BRANCHING) {
       // create both a new tail and a new root node
-      const uint32_t tail_cut = RRB_BRANCHING - rrb->root->len;
-      LeafNode *new_root = leaf_node_create(RRB_BRANCHING);
+      const uint32_t tail_cut = RRB_LEAF_BRANCHING - rrb->root->len;
+      LeafNode *new_root = leaf_node_create(RRB_LEAF_BRANCHING);
       LeafNode *new_tail = leaf_node_create(rrb->tail_len - tail_cut);
 
       memcpy(&new_root->child[0], &((LeafNode *) rrb->root)->child[0],
@@ -1220,25 +1958,18 @@ const RRB* slice_left(RRB *rrb, uint32_t left) {
 }
 
 static TreeNode* slice_left_rec(uint32_t *total_shift, const TreeNode *root,
-                                uint32_t left, uint32_t shift,
+                                RRBIndex left, uint32_t shift,
                                 char has_right) {
   const uint32_t subshift = DEC_SHIFT(shift);
-  uint32_t subidx = left >> shift;
+  uint32_t subidx = (uint32_t) (left >> shift);
   if (shift > LEAF_NODE_SHIFT) {
     const InternalNode *internal_root = (InternalNode *) root;
-    uint32_t idx = left;
+    RRBIndex idx = left;
     if (internal_root->size_table == NULL) {
-      idx -= subidx << shift;
+      idx -= (RRBIndex) subidx << shift;
     }
     else { // if (internal_root->size_table != NULL)
-      const RRBSizeTable *table = internal_root->size_table;
-
-      while (table->size[subidx] <= idx) {
-        subidx++;
-      }
-      if (subidx != 0) {
-        idx -= table->size[subidx - 1];
-      }
+      subidx = sized_pos(internal_root, &idx, shift);
     }
 
     const uint32_t last_slot = internal_root->len - 1;
@@ -1253,9 +1984,10 @@ static TreeNode* slice_left_rec(uint32_t *total_shift, const TreeNode *root,
         left_hand_parent->child[0] = internal_left_hand_node;
 
         if (subshift != LEAF_NODE_SHIFT && internal_left_hand_node->size_table != NULL) {
-          RRBSizeTable *sliced_table = size_table_create(1);
-          sliced_table->size[0] =
-            internal_left_hand_node->size_table->size[internal_left_hand_node->len-1];
+          RRBSizeTable *sliced_table = size_table_create(1, shift);
+          size_table_set(sliced_table, 0,
+                         size_table_get(internal_left_hand_node->size_table,
+                                        internal_left_hand_node->len-1));
           left_hand_parent->size_table = sliced_table;
         }
         *total_shift = shift;
@@ -1282,13 +2014,13 @@ static TreeNode* slice_left_rec(uint32_t *total_shift, const TreeNode *root,
       // will be completely populated, and we can ignore the size table. Most
       // importantly, this will remove the need to alloc a size table, which
       // increases perf.
-      RRBSizeTable *sliced_table = size_table_create(sliced_len);
+      RRBSizeTable *sliced_table = size_table_create(sliced_len, shift);
 
       if (table == NULL) {
         for (uint32_t i = 0; i < sliced_len; i++) {
           // left is total amount sliced off. By adding in subidx, we get faster
           // computation later on.
-          sliced_table->size[i] = (subidx + 1 + i) << shift;
+          size_table_set(sliced_table, i, (RRBIndex) (subidx + 1 + i) << shift);
           // NOTE: This doesn't really work properly for top root, as last node
           // may have a higher count than it *actually* has. To remedy for this,
           // the top function performs a check afterwards, which may insert the
@@ -1296,12 +2028,11 @@ static TreeNode* slice_left_rec(uint32_t *total_shift, const TreeNode *root,
         }
       }
       else { // if (table != NULL)
-        memcpy(sliced_table->size, &table->size[subidx],
-               sliced_len * sizeof(uint32_t));
+        size_table_copy(sliced_table, table, subidx, sliced_len);
       }
 
       for (uint32_t i = 0; i < sliced_len; i++) {
-        sliced_table->size[i] -= left;
+        size_table_set(sliced_table, i, size_table_get(sliced_table, i) - left);
       }
 
       sliced_root->size_table = sliced_table;
@@ -1323,23 +2054,110 @@ static TreeNode* slice_left_rec(uint32_t *total_shift, const TreeNode *root,
   }
 }
 
-const RRB* rrb_slice(const RRB *rrb, uint32_t from, uint32_t to) {
-  return slice_left(slice_right(rrb, to), from);
+const RRB* rrb_slice(const RRB *rrb, RRBIndex from, RRBIndex to) {
+  CHECK_BRANCHING(rrb);
+  RC_SCOPE_BEGIN();
+  RC_RETURN(slice_left(slice_right(rrb, to), from));
 }
 
-const RRB* rrb_update(const RRB *restrict rrb, uint32_t index, const void *restrict elt) {
+/**
+ * Appends the items of `rrb` from index `from` and onwards to `trrb`, and
+ * returns the result as a persistent RRB-tree.
+ */
+static const RRB* splice_suffix(TransientRRB *trrb, const RRB *rrb,
+                                RRBIndex from) {
+  if (from < rrb->cnt) {
+    trrb = transient_rrb_concat(trrb, slice_left(slice_right(rrb, rrb->cnt),
+                                                 from));
+  }
+  return transient_persist(trrb);
+}
+
+// Splicing is done on a single transient: The prefix is sliced in place, after
+// which the concatenations reuse the seam nodes copied by the first slice
+// instead of copying them once per step.
+const RRB* rrb_splice(const RRB *rrb, RRBIndex from, RRBIndex to,
+                      const RRB *replacement) {
+  CHECK_BRANCHING(rrb);
+  CHECK_BRANCHING(replacement);
+  RC_SCOPE_BEGIN();
+  to = MIN(to, rrb->cnt);
+  from = MIN(from, to);
+  if (from == to && replacement->cnt == 0) {
+    RC_RETURN(rrb);
+  }
+  TransientRRB *trrb = transient_create(rrb);
+  trrb = transient_rrb_slice(trrb, 0, from);
+  trrb = transient_rrb_concat(trrb, replacement);
+  RC_RETURN(splice_suffix(trrb, rrb, to));
+}
+
+const RRB* rrb_insert_at(const RRB *restrict rrb, RRBIndex index,
+                         const void *restrict elt) {
+  CHECK_BRANCHING(rrb);
+  RC_SCOPE_BEGIN();
+  index = MIN(index, rrb->cnt);
+  const RRBIndex tail_offset = rrb->cnt - rrb->tail_len;
+  // Inserting into a tail with room left only requires a new tail
+  if (tail_offset <= index && rrb->tail_len < RRB_LEAF_BRANCHING) {
+    const uint32_t pos = index - tail_offset;
+    RRB *new_rrb = rrb_head_clone(rrb);
+    LeafNode *new_tail = leaf_node_create(rrb->tail_len + 1);
+    memcpy(new_tail->child, rrb->tail->child, pos * sizeof(void *));
+    new_tail->child[pos] = elt;
+    memcpy(&new_tail->child[pos + 1], &rrb->tail->child[pos],
+           (rrb->tail_len - pos) * sizeof(void *));
+    new_rrb->cnt++;
+    new_rrb->tail_len++;
+    new_rrb->tail = new_tail;
+    RC_RETURN(new_rrb);
+  }
+  TransientRRB *trrb = transient_create(rrb);
+  trrb = transient_rrb_slice(trrb, 0, index);
+  trrb = transient_rrb_push(trrb, elt);
+  RC_RETURN(splice_suffix(trrb, rrb, index));
+}
+
+const RRB* rrb_remove_at(const RRB *rrb, RRBIndex index) {
+  CHECK_BRANCHING(rrb);
+  RC_SCOPE_BEGIN();
+  if (rrb->cnt <= index) {
+    RC_RETURN(rrb);
+  }
+  const RRBIndex tail_offset = rrb->cnt - rrb->tail_len;
+  // Removing from a tail with more than one item only requires a new tail
+  if (tail_offset <= index && 1 < rrb->tail_len) {
+    const uint32_t pos = index - tail_offset;
+    RRB *new_rrb = rrb_head_clone(rrb);
+    LeafNode *new_tail = leaf_node_create(rrb->tail_len - 1);
+    memcpy(new_tail->child, rrb->tail->child, pos * sizeof(void *));
+    memcpy(&new_tail->child[pos], &rrb->tail->child[pos + 1],
+           (rrb->tail_len - pos - 1) * sizeof(void *));
+    new_rrb->cnt--;
+    new_rrb->tail_len--;
+    new_rrb->tail = new_tail;
+    RC_RETURN(new_rrb);
+  }
+  TransientRRB *trrb = transient_create(rrb);
+  trrb = transient_rrb_slice(trrb, 0, index);
+  RC_RETURN(splice_suffix(trrb, rrb, index + 1));
+}
+
+const RRB* rrb_update(const RRB *restrict rrb, RRBIndex index, const void *restrict elt) {
+  CHECK_BRANCHING(rrb);
+  RC_SCOPE_BEGIN();
   if (index < rrb->cnt) {
     RRB *new_rrb = rrb_head_clone(rrb);
-    const uint32_t tail_offset = rrb->cnt - rrb->tail_len;
+    const RRBIndex tail_offset = rrb->cnt - rrb->tail_len;
     if (tail_offset <= index) {
       LeafNode *new_tail = leaf_node_clone(rrb->tail);
       new_tail->child[index - tail_offset] = elt;
       new_rrb->tail = new_tail;
-      return new_rrb;
+      RC_RETURN(new_rrb);
     }
     InternalNode **previous_pointer = (InternalNode **) &new_rrb->root;
     InternalNode *current = (InternalNode *) rrb->root;
-    for (uint32_t shift = RRB_SHIFT(rrb); shift > 0; shift -= RRB_BITS) {
+    for (uint32_t shift = RRB_SHIFT(rrb); shift > 0; shift = DEC_SHIFT(shift)) {
       current = internal_node_clone(current);
       *previous_pointer = current;
 
@@ -1357,35 +2175,41 @@ const RRB* rrb_update(const RRB *restrict rrb, uint32_t index, const void *restr
     LeafNode *leaf = (LeafNode *) current;
     leaf = leaf_node_clone(leaf);
     *previous_pointer = (InternalNode *) leaf;
-    leaf->child[index & RRB_MASK] = elt;
-    return new_rrb;
+    leaf->child[index & RRB_LEAF_MASK] = elt;
+    RC_RETURN(new_rrb);
   }
   else {
-    return NULL;
+    RC_RETURN(NULL);
   }
 }
 
 // Also assume direct append
 const RRB* rrb_pop(const RRB *rrb) {
+  CHECK_BRANCHING(rrb);
+  RC_SCOPE_BEGIN();
   if (rrb->cnt == 1) {
-    return rrb_create();
+    RC_RETURN(rrb_create());
   }
   RRB* new_rrb = rrb_head_clone(rrb);
   new_rrb->cnt--;
 
   if (rrb->tail_len == 1) {
     promote_rightmost_leaf(new_rrb);
-    return new_rrb;
+    RC_RETURN(new_rrb);
   }
   else {
     LeafNode *new_tail = leaf_node_dec(rrb->tail);
     new_rrb->tail_len--;
     new_rrb->tail = new_tail;
-    return new_rrb;
+    RC_RETURN(new_rrb);
   }
 }
 
 #include "rrb_transients.h"
+#include "rrb_parallel.h"
+#include "rrb_unboxed.h"
+#include "rrb_rope.h"
+#include "rrb_ops.h"
 
 #ifdef RRB_DEBUG
 #include "rrb_debug.h"
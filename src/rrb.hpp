@@ -0,0 +1,442 @@
+/*
+ * Copyright (c) 2013-2014 Jean Niklas L'orange. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef RRB_HPP
+#define RRB_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+
+#include <rrb.h>
+
+namespace rrb {
+
+class transient;
+
+/**
+ * An owning handle to a `const RRB *`, released when the handle is destroyed.
+ * Copying a handle retains the RRB-tree, so that both handles can be released
+ * independently.
+ *
+ * Operations on an lvalue return a new handle and leave this one untouched.
+ * Operations on an rvalue, as in `p = std::move(p).push(x)`, know that no one
+ * else can see the result. A single one runs as a plain persistent operation,
+ * as converting to a transient and back costs more than it saves. Once its
+ * result is operated on as an rvalue again, the chain continues on a transient
+ * left pending in the result, so that the rest of the chain reuses it. The
+ * transient is made persistent the first time the handle is read or copied,
+ * which also ends the chain. Like a transient, a handle with pending
+ * operations belongs to the thread that made them until then.
+ *
+ * A moved-from handle may only be assigned to or destroyed.
+ */
+class persistent {
+public:
+  typedef void* value_type;
+  typedef RRBIndex size_type;
+  class const_iterator;
+  typedef const_iterator iterator;
+
+  persistent() noexcept : rrb_(rrb_create()), pending_(nullptr),
+                          chained_(false) {}
+
+  /**
+   * Takes over the caller's reference to `rrb`.
+   */
+  explicit persistent(const RRB *rrb) noexcept : rrb_(rrb), pending_(nullptr),
+                                                  chained_(false) {}
+
+  persistent(const persistent &other) : rrb_(rrb_retain(other.get())),
+                                        pending_(nullptr), chained_(false) {}
+  persistent(persistent &&other) noexcept : rrb_(other.rrb_),
+                                            pending_(other.pending_),
+                                            chained_(other.chained_) {
+    other.rrb_ = nullptr;
+    other.pending_ = nullptr;
+  }
+  inline persistent(transient &&trans) noexcept;
+
+  persistent& operator=(persistent other) noexcept {
+    swap(other);
+    return *this;
+  }
+
+  ~persistent() {
+    settle();
+    rrb_release(rrb_);
+  }
+
+  void swap(persistent &other) noexcept {
+    std::swap(rrb_, other.rrb_);
+    std::swap(pending_, other.pending_);
+    std::swap(chained_, other.chained_);
+  }
+
+  /**
+   * Returns the RRB-tree, which stays owned by this handle.
+   */
+  const RRB* get() const {
+    settle();
+    return rrb_;
+  }
+
+  /**
+   * Returns the RRB-tree, handing the reference over to the caller.
+   */
+  const RRB* release() && {
+    const RRB *rrb = get();
+    rrb_ = nullptr;
+    return rrb;
+  }
+
+  size_type size() const { return rrb_count(get()); }
+  bool empty() const { return size() == 0; }
+  void* operator[](size_type index) const { return rrb_nth(get(), index); }
+  void* at(size_type index) const {
+    if (index >= size()) {
+      throw std::out_of_range("rrb::persistent::at");
+    }
+    return rrb_nth(get(), index);
+  }
+  void* back() const { return rrb_peek(get()); }
+
+  persistent push(const void *elt) const & {
+    return persistent(rrb_push(get(), elt));
+  }
+  persistent pop() const & { return persistent(rrb_pop(get())); }
+  persistent update(size_type index, const void *elt) const & {
+    return persistent(rrb_update(get(), index, elt));
+  }
+  persistent concat(const persistent &right) const & {
+    return persistent(rrb_concat(get(), right.get()));
+  }
+  persistent slice(size_type from, size_type to) const & {
+    return persistent(rrb_slice(get(), from, to));
+  }
+
+  persistent push(const void *elt) && {
+    if (!chained_) {
+      return chain_start(rrb_push(rrb_, elt));
+    }
+    return pending(transient_rrb_push(take_transient(), elt));
+  }
+  persistent pop() && {
+    if (!chained_) {
+      return chain_start(rrb_pop(rrb_));
+    }
+    return pending(transient_rrb_pop(take_transient()));
+  }
+  persistent update(size_type index, const void *elt) && {
+    if (!chained_) {
+      return chain_start(rrb_update(rrb_, index, elt));
+    }
+    return pending(transient_rrb_update(take_transient(), index, elt));
+  }
+  persistent concat(const persistent &right) && {
+    // Settle right first, in case it is this handle.
+    const RRB *rrb = right.get();
+    if (!chained_) {
+      return chain_start(rrb_concat(rrb_, rrb));
+    }
+    return pending(transient_rrb_concat(take_transient(), rrb));
+  }
+  persistent slice(size_type from, size_type to) && {
+    if (!chained_) {
+      return chain_start(rrb_slice(rrb_, from, to));
+    }
+    return pending(transient_rrb_slice(take_transient(), from, to));
+  }
+
+  inline const_iterator begin() const;
+  inline const_iterator end() const;
+  inline const_iterator cbegin() const;
+  inline const_iterator cend() const;
+
+private:
+  friend class transient;
+
+  static persistent pending(TransientRRB *trrb) noexcept {
+    persistent p(nullptr);
+    p.pending_ = trrb;
+    p.chained_ = true;
+    return p;
+  }
+
+  // Returns `rrb`, the result of the first rvalue operation on this handle, as
+  // a handle that continues the chain on a transient. This handle is left
+  // moved-from.
+  persistent chain_start(const RRB *rrb) noexcept {
+    rrb_release(rrb_);
+    rrb_ = nullptr;
+    persistent p(rrb);
+    p.chained_ = true;
+    return p;
+  }
+
+  // Makes pending operations persistent, and ends the chain of rvalue
+  // operations. The transient holds the reference this handle had, so the
+  // result is owned by the handle.
+  void settle() const {
+    if (pending_ != nullptr) {
+      rrb_ = transient_to_rrb(pending_);
+      pending_ = nullptr;
+    }
+    chained_ = false;
+  }
+
+  // Turns this handle into a transient, leaving the handle moved-from. The
+  // transient takes over the handle's reference instead of retaining the
+  // RRB-tree again.
+  TransientRRB* take_transient() noexcept {
+    TransientRRB *trrb = pending_;
+    if (trrb == nullptr) {
+      trrb = rrb_to_transient_release(rrb_);
+    }
+    rrb_ = nullptr;
+    pending_ = nullptr;
+    return trrb;
+  }
+
+  mutable const RRB *rrb_;
+  mutable TransientRRB *pending_;
+  // Set on the result of an rvalue operation, until the handle is read.
+  mutable bool chained_;
+};
+
+/**
+ * A random access iterator over a persistent, valid as long as the persistent
+ * is neither modified nor destroyed. The leaf holding the current element is
+ * cached, so that only moving to another leaf has to descend the tree.
+ */
+class persistent::const_iterator {
+public:
+  typedef std::random_access_iterator_tag iterator_category;
+  typedef void* value_type;
+  typedef std::ptrdiff_t difference_type;
+  typedef void* const* pointer;
+  typedef void* const& reference;
+
+  const_iterator() noexcept : rrb_(nullptr), index_(0), leaf_(nullptr),
+                              leaf_start_(0), leaf_len_(0) {}
+
+  reference operator*() const {
+    if (index_ - leaf_start_ >= leaf_len_) {
+      const void *const *data;
+      leaf_len_ = rrb_chunk_at(rrb_, index_, &data, &leaf_start_);
+      leaf_ = const_cast<void *const *>(data);
+    }
+    return leaf_[index_ - leaf_start_];
+  }
+  pointer operator->() const { return &**this; }
+  reference operator[](difference_type n) const { return *(*this + n); }
+
+  const_iterator& operator++() noexcept { index_++; return *this; }
+  const_iterator& operator--() noexcept { index_--; return *this; }
+  const_iterator operator++(int) noexcept {
+    const_iterator old = *this;
+    index_++;
+    return old;
+  }
+  const_iterator operator--(int) noexcept {
+    const_iterator old = *this;
+    index_--;
+    return old;
+  }
+  const_iterator& operator+=(difference_type n) noexcept {
+    index_ = static_cast<RRBIndex>(index_ + n);
+    return *this;
+  }
+  const_iterator& operator-=(difference_type n) noexcept {
+    return *this += -n;
+  }
+  friend const_iterator operator+(const_iterator it, difference_type n) {
+    return it += n;
+  }
+  friend const_iterator operator+(difference_type n, const_iterator it) {
+    return it += n;
+  }
+  friend const_iterator operator-(const_iterator it, difference_type n) {
+    return it -= n;
+  }
+  friend difference_type operator-(const const_iterator &a,
+                                   const const_iterator &b) {
+    return static_cast<difference_type>(a.index_)
+      - static_cast<difference_type>(b.index_);
+  }
+  friend bool operator==(const const_iterator &a, const const_iterator &b) {
+    return a.index_ == b.index_;
+  }
+  friend bool operator!=(const const_iterator &a, const const_iterator &b) {
+    return a.index_ != b.index_;
+  }
+  friend bool operator<(const const_iterator &a, const const_iterator &b) {
+    return a.index_ < b.index_;
+  }
+  friend bool operator>(const const_iterator &a, const const_iterator &b) {
+    return a.index_ > b.index_;
+  }
+  friend bool operator<=(const const_iterator &a, const const_iterator &b) {
+    return a.index_ <= b.index_;
+  }
+  friend bool operator>=(const const_iterator &a, const const_iterator &b) {
+    return a.index_ >= b.index_;
+  }
+
+private:
+  friend class persistent;
+  const_iterator(const RRB *rrb, RRBIndex index) noexcept
+    : rrb_(rrb), index_(index), leaf_(nullptr), leaf_start_(0),
+      leaf_len_(0) {}
+
+  const RRB *rrb_;
+  RRBIndex index_;
+  mutable void *const *leaf_;
+  mutable RRBIndex leaf_start_;
+  mutable uint32_t leaf_len_;
+};
+
+inline persistent::const_iterator persistent::begin() const {
+  return const_iterator(get(), 0);
+}
+
+inline persistent::const_iterator persistent::end() const {
+  return const_iterator(get(), size());
+}
+
+inline persistent::const_iterator persistent::cbegin() const {
+  return begin();
+}
+
+inline persistent::const_iterator persistent::cend() const {
+  return end();
+}
+
+/**
+ * An owning handle to a `TransientRRB *`, made persistent again when the handle
+ * is destroyed, or when it is moved into a persistent. Like the transient
+ * itself, the handle belongs to the thread that created it.
+ *
+ * Operations modify the transient in place, and return the handle so that
+ * they can be chained.
+ */
+class transient {
+public:
+  typedef void* value_type;
+  typedef RRBIndex size_type;
+
+  transient() : trrb_(rrb_to_transient(rrb_create())) {}
+  explicit transient(const persistent &p) : trrb_(rrb_to_transient(p.get())) {}
+
+  /**
+   * Takes over the reference `p` holds, so that the RRB-tree is not retained
+   * again, and reuses the transient of any operations pending on `p`.
+   */
+  explicit transient(persistent &&p) noexcept : trrb_(p.take_transient()) {}
+
+  transient(transient &&other) noexcept : trrb_(other.trrb_) {
+    other.trrb_ = nullptr;
+  }
+  transient& operator=(transient &&other) noexcept {
+    std::swap(trrb_, other.trrb_);
+    return *this;
+  }
+  transient(const transient &) = delete;
+  transient& operator=(const transient &) = delete;
+
+  ~transient() {
+    if (trrb_ != nullptr) {
+      rrb_release(transient_to_rrb(trrb_));
+    }
+  }
+
+  TransientRRB* get() const noexcept { return trrb_; }
+
+  /**
+   * Makes the transient persistent, leaving this handle moved-from.
+   */
+  persistent persist() && { return persistent(std::move(*this)); }
+
+  size_type size() const { return transient_rrb_count(trrb_); }
+  bool empty() const { return size() == 0; }
+  void* operator[](size_type index) const {
+    return transient_rrb_nth(trrb_, index);
+  }
+  void* at(size_type index) const {
+    if (index >= size()) {
+      throw std::out_of_range("rrb::transient::at");
+    }
+    return transient_rrb_nth(trrb_, index);
+  }
+  void* back() const { return transient_rrb_peek(trrb_); }
+
+  transient& push(const void *elt) & {
+    trrb_ = transient_rrb_push(trrb_, elt);
+    return *this;
+  }
+  transient& pop() & {
+    trrb_ = transient_rrb_pop(trrb_);
+    return *this;
+  }
+  transient& update(size_type index, const void *elt) & {
+    trrb_ = transient_rrb_update(trrb_, index, elt);
+    return *this;
+  }
+  transient& concat(const persistent &right) & {
+    trrb_ = transient_rrb_concat(trrb_, right.get());
+    return *this;
+  }
+  transient& slice(size_type from, size_type to) & {
+    trrb_ = transient_rrb_slice(trrb_, from, to);
+    return *this;
+  }
+
+  transient&& push(const void *elt) && { return std::move(push(elt)); }
+  transient&& pop() && { return std::move(pop()); }
+  transient&& update(size_type index, const void *elt) && {
+    return std::move(update(index, elt));
+  }
+  transient&& concat(const persistent &right) && {
+    return std::move(concat(right));
+  }
+  transient&& slice(size_type from, size_type to) && {
+    return std::move(slice(from, to));
+  }
+
+private:
+  friend class persistent;
+
+  TransientRRB *trrb_;
+};
+
+inline persistent::persistent(transient &&trans) noexcept
+  : rrb_(nullptr), pending_(trans.trrb_), chained_(true) {
+  trans.trrb_ = nullptr;
+}
+
+} // namespace rrb
+
+#endif
@@ -24,10 +24,118 @@
 #ifndef RRB_ALLOC_H
 #define RRB_ALLOC_H
 
+#include "rrb.h"
+
+#ifdef RRB_REFCOUNT
+
+#include <stdlib.h>
+
+// Without the garbage collector, memory is handed out by the C library.
+// Memory from malloc (but not atomic_malloc) must be zeroed, as calloc's is.
+
+static void* rrb_libc_malloc(size_t size, void *ctx) {
+  (void) ctx;
+  return calloc(1, size);
+}
+
+static void* rrb_libc_malloc_atomic(size_t size, void *ctx) {
+  (void) ctx;
+  return malloc(size);
+}
+
+static void* rrb_libc_realloc(void *ptr, size_t size, void *ctx) {
+  (void) ctx;
+  return realloc(ptr, size);
+}
+
+static void rrb_libc_free(void *ptr, void *ctx) {
+  (void) ctx;
+  free(ptr);
+}
+
+static RRBAllocator rrb_allocator = {
+  .malloc = rrb_libc_malloc,
+  .atomic_malloc = rrb_libc_malloc_atomic,
+  .realloc = rrb_libc_realloc,
+  .free = rrb_libc_free,
+  .ctx = NULL
+};
+
+#define RRB_MALLOC_MANY_COUNT 16
+
+/**
+ * Returns a list of zeroed allocations of `size` bytes from the default
+ * allocator, linked through their first word. Every allocation can be freed
+ * on its own with RRB_DEFAULT_FREE.
+ */
+static void* rrb_libc_malloc_many(size_t size) {
+  void *list = NULL;
+  for (uint32_t i = 0; i < RRB_MALLOC_MANY_COUNT; i++) {
+    void **obj = calloc(1, size);
+    *obj = list;
+    list = obj;
+  }
+  return list;
+}
+
+#define RRB_MALLOC_MANY(size) rrb_libc_malloc_many(size)
+#define RRB_DEFAULT_FREE(ptr) free(ptr)
+// Memory which is never freed, and which may hold the only pointers to
+// memory from the default allocator.
+#define RRB_MALLOC_ROOT(size) calloc(1, (size))
+#define RRB_ALLOCATOR_IS_DEFAULT() (rrb_allocator.malloc == rrb_libc_malloc)
+
+#else
+
+// Threads started by the parallel functions allocate, and must therefore be
+// registered with the garbage collector.
+#define GC_THREADS
 #include <gc/gc.h>
 
-#define RRB_MALLOC GC_MALLOC
-#define RRB_REALLOC GC_REALLOC
-#define RRB_MALLOC_ATOMIC GC_MALLOC_ATOMIC
+// The default allocator hands everything to the garbage collector. Memory from
+// malloc (but not atomic_malloc) must be zeroed, as GC_MALLOC's is.
+
+static void* rrb_gc_malloc(size_t size, void *ctx) {
+  (void) ctx;
+  return GC_MALLOC(size);
+}
+
+static void* rrb_gc_malloc_atomic(size_t size, void *ctx) {
+  (void) ctx;
+  return GC_MALLOC_ATOMIC(size);
+}
+
+static void* rrb_gc_realloc(void *ptr, size_t size, void *ctx) {
+  (void) ctx;
+  return GC_REALLOC(ptr, size);
+}
+
+static void rrb_gc_free(void *ptr, void *ctx) {
+  (void) ctx;
+  GC_FREE(ptr);
+}
+
+static RRBAllocator rrb_allocator = {
+  .malloc = rrb_gc_malloc,
+  .atomic_malloc = rrb_gc_malloc_atomic,
+  .realloc = rrb_gc_realloc,
+  .free = rrb_gc_free,
+  .ctx = NULL
+};
+
+// Allocating a batch takes the allocation lock only once.
+#define RRB_MALLOC_MANY(size) GC_malloc_many(size)
+#define RRB_DEFAULT_FREE(ptr) GC_FREE(ptr)
+#define RRB_MALLOC_ROOT(size) GC_MALLOC_UNCOLLECTABLE(size)
+#define RRB_ALLOCATOR_IS_DEFAULT() (rrb_allocator.malloc == rrb_gc_malloc)
+
+#endif
+
+#define RRB_MALLOC(size) rrb_allocator.malloc((size), rrb_allocator.ctx)
+#define RRB_REALLOC(ptr, size) \
+  rrb_allocator.realloc((ptr), (size), rrb_allocator.ctx)
+#define RRB_MALLOC_ATOMIC(size) \
+  rrb_allocator.atomic_malloc((size), rrb_allocator.ctx)
+#define RRB_FREE(ptr) rrb_allocator.free((ptr), rrb_allocator.ctx)
 
 #endif
@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2013-2014 Jean Niklas L'orange. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef RRB_ARENA_H
+#define RRB_ARENA_H
+
+// Arenas hand out memory by bumping a pointer through large slabs, and reclaim
+// all of it at once when reset. While a transient created by
+// rrb_to_transient_in is operated on, its arena is the current arena of the
+// thread, and every node, size table and head is allocated from it.
+
+#include "rrb_thread.h"
+
+#define ARENA_SLAB_SIZE ((size_t) 1 << 20)
+#define ARENA_ALIGN ((size_t) 16)
+
+// Four words, so that the data following it is aligned on 32-bit systems as
+// well.
+typedef struct ArenaSlab {
+  struct ArenaSlab *next;
+  size_t size;
+  size_t used;
+  void *padding;
+} ArenaSlab;
+
+struct RRBArena_ {
+  ArenaSlab *slabs; // The slab allocated from is the first one
+  ArenaSlab *free_slabs;
+  char *pos;
+  char *end;
+#ifdef RRB_REFCOUNT
+  // RRB-trees the arena shares nodes with, kept alive until reset.
+  const RRB **held;
+  uint32_t held_len;
+  uint32_t held_cap;
+#endif
+};
+
+static RRB_THREAD_LOCAL RRBArena *rrb_arena;
+
+static inline char* arena_slab_data(ArenaSlab *slab) {
+  return (char *) (slab + 1);
+}
+
+static void arena_grow(RRBArena *arena, size_t size) {
+  if (arena->slabs != NULL) {
+    arena->slabs->used = (size_t) (arena->pos - arena_slab_data(arena->slabs));
+  }
+  ArenaSlab *slab = arena->free_slabs;
+  if (slab != NULL && size <= slab->size) {
+    arena->free_slabs = slab->next;
+  }
+  else {
+    const size_t slab_size = MAX(size, ARENA_SLAB_SIZE);
+    slab = RRB_MALLOC(sizeof(ArenaSlab) + slab_size);
+    slab->size = slab_size;
+  }
+  slab->next = arena->slabs;
+  arena->slabs = slab;
+  arena->pos = arena_slab_data(slab);
+  arena->end = arena->pos + slab->size;
+}
+
+/**
+ * Returns zeroed memory from the arena, which is only reclaimed when the
+ * arena is reset.
+ */
+static inline void* arena_malloc(RRBArena *arena, size_t size) {
+  size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+  if ((size_t) (arena->end - arena->pos) < size) {
+    arena_grow(arena, size);
+  }
+  void *ptr = arena->pos;
+  arena->pos += size;
+  return ptr;
+}
+
+/**
+ * Moves all slabs to the free list. The memory handed out is zeroed again, as
+ * memory from arena_malloc must be.
+ */
+static void arena_reclaim(RRBArena *arena) {
+  if (arena->slabs != NULL) {
+    arena->slabs->used = (size_t) (arena->pos - arena_slab_data(arena->slabs));
+  }
+  ArenaSlab *slab = arena->slabs;
+  while (slab != NULL) {
+    ArenaSlab *next = slab->next;
+    memset(arena_slab_data(slab), 0, slab->used);
+    slab->used = 0;
+    slab->next = arena->free_slabs;
+    arena->free_slabs = slab;
+    slab = next;
+  }
+  arena->slabs = NULL;
+  arena->pos = NULL;
+  arena->end = NULL;
+}
+
+static void arena_free_slabs(ArenaSlab *slab) {
+  while (slab != NULL) {
+    ArenaSlab *next = slab->next;
+    RRB_FREE(slab);
+    slab = next;
+  }
+}
+
+static inline RRBArena* arena_enter(RRBArena *arena) {
+  RRBArena *saved = rrb_arena;
+  rrb_arena = arena;
+  return saved;
+}
+
+static inline void arena_leave(RRBArena **saved) {
+  rrb_arena = *saved;
+}
+
+// Makes the rest of the enclosing block allocate from `arena`, or from the
+// allocator if it is NULL.
+#define ARENA_SCOPE(arena) \
+  RRBArena *arena_saved __attribute__((cleanup(arena_leave))) = \
+    arena_enter(arena)
+
+#endif
@@ -165,14 +165,15 @@ int rrb_to_dot(DotFile dot, const RRB *rrb) {
             "  s%p [label=<\n<table border=\"0\" cellborder=\"1\" "
             "cellspacing=\"0\" cellpadding=\"6\" align=\"center\">\n"
             "  <tr>\n"
-            "    <td height=\"36\" width=\"25\">%d</td>\n"
+            "    <td height=\"36\" width=\"25\">%llu</td>\n"
             "    <td height=\"36\" width=\"25\">%d</td>\n"
             "    <td height=\"36\" width=\"25\" port=\"root\"></td>\n"
             "    <td height=\"36\" width=\"25\">%d</td>\n"
             "    <td height=\"36\" width=\"25\" port=\"tail\"></td>\n"
             "  </tr>\n"
             "</table>>];\n",
-                          rrb, rrb->cnt, rrb->shift, rrb->tail_len));
+                          rrb, (unsigned long long) rrb->cnt, rrb->shift,
+                          rrb->tail_len));
     if (rrb->tail == NULL) {
       SHORT_CIRCUIT(fprintf(dot.file, "  s%d [label=\"NIL\"];\n", null_counter));
       SHORT_CIRCUIT(fprintf(dot.file, "  s%p:tail -> s%d;\n", rrb, null_counter++));
@@ -283,9 +284,9 @@ static int size_table_to_dot(DotFile dot, const InternalNode *node) {
     for (uint32_t i = 0; i < node->len; i++) {
       int remaining_nodes = (i+1) < node->len;
       SHORT_CIRCUIT(
-        fprintf(dot.file, "    <td height=\"36\" width=\"25\" %s>%d</td>\n",
+        fprintf(dot.file, "    <td height=\"36\" width=\"25\" %s>%llu</td>\n",
                 !remaining_nodes ? "port=\"last\"" : "",
-                table->size[i]));
+                (unsigned long long) size_table_get(table, i)));
     }
     SHORT_CIRCUIT(fprintf(dot.file, "  </tr>\n</table>>];\n"));
   }
@@ -328,7 +329,7 @@ static uint32_t node_size(DotArray *set, const TreeNode *root) {
     const InternalNode *internal = (const InternalNode *) root;
     uint32_t size_table_bytes = 0;
     if (internal->size_table != NULL) {
-      size_table_bytes = sizeof(uint32_t) * internal->len;
+      size_table_bytes = size_table_width(internal->size_table) * internal->len;
     }
     uint32_t node_bytes = sizeof(InternalNode) + size_table_bytes
                         + sizeof(struct InternalNode *) * internal->len;
@@ -354,7 +355,7 @@ void nodes_to_dot_file(char *loch, int ncount, ...) {
   dot_file_close(dot);
 }
 
-static void validate_subtree(const TreeNode *root, uint32_t expected_size,
+static void validate_subtree(const TreeNode *root, RRBIndex expected_size,
                              uint32_t root_shift, uint32_t *fail) {
   if (root_shift == LEAF_NODE_SHIFT) { // leaf node
     if (root->type != LEAF_NODE) {
@@ -364,17 +365,23 @@ static void validate_subtree(const TreeNode *root, uint32_t expected_size,
       *fail = 1;
     }
     const LeafNode *leaf = (const LeafNode *) root;
+    if (leaf->len > RRB_LEAF_BRANCHING) {
+      printf("Leaf node claims to be %u elements long, but leaves contain at "
+             "most %u elements.\n", leaf->len, RRB_LEAF_BRANCHING);
+      *fail = 1;
+    }
     if (leaf->len != expected_size) {
       printf("Leaf node claims to be %u elements long, but was expected to be "
-             "%u\n elements long. Will attempt to read %u elements.\n",
-             leaf->len, expected_size, MAX(leaf->len, expected_size));
+             "%llu\n elements long. Will attempt to read %llu elements.\n",
+             leaf->len, (unsigned long long) expected_size,
+             (unsigned long long) MAX(leaf->len, expected_size));
       *fail = 1;
     }
     uintptr_t c = 0;
     // dummy counter to avoid optimization at lower levels (although probably
     // unneccesary). Note that this will probably be filtered out with -O2 and
     // higher, so run with '-O0 -g'.
-    for (uint32_t i = 0; i < MAX(leaf->len, expected_size); i++) {
+    for (RRBIndex i = 0; i < MAX(leaf->len, expected_size); i++) {
       c += (uintptr_t) leaf->child[i];
     }
   }
@@ -389,15 +396,22 @@ static void validate_subtree(const TreeNode *root, uint32_t expected_size,
     if (internal->size_table != NULL) {
       // expected size should be consistent with what's in the last size table
       // slot
-      if (internal->size_table->size[internal->len-1] != expected_size) {
-        printf("Expected subtree to be of size %u, but its size table says it "
-               "is %u.\n", expected_size,
-               internal->size_table->size[internal->len-1]);
+      const RRBSizeTable *table = internal->size_table;
+      if (table->width != SIZE_TABLE_WIDTH(root_shift)) {
+        printf("Size table at shift %u has %u byte entries, but should have "
+               "%u.\n", root_shift, (uint32_t) table->width,
+               (uint32_t) SIZE_TABLE_WIDTH(root_shift));
+        *fail = 1;
+      }
+      if (size_table_get(table, internal->len-1) != expected_size) {
+        printf("Expected subtree to be of size %llu, but its size table says "
+               "it is %llu.\n", (unsigned long long) expected_size,
+               (unsigned long long) size_table_get(table, internal->len-1));
         *fail = 1;
       }
       for (uint32_t i = 0; i < internal->len; i++) {
-        uint32_t size_sub_trie = internal->size_table->size[i]
-                               - (i == 0 ? 0 : internal->size_table->size[i-1]);
+        RRBIndex size_sub_trie = size_table_get(table, i)
+                               - (i == 0 ? 0 : size_table_get(table, i-1));
         validate_subtree((const TreeNode *) internal->child[i], size_sub_trie,
                          DEC_SHIFT(root_shift), fail);
       }
@@ -407,18 +421,20 @@ static void validate_subtree(const TreeNode *root, uint32_t expected_size,
       // more. Effectively, the tree contains (len - 1) << shift + last_tree_len
       // (1 << shift) >= last_tree_len > 0
       const uint32_t child_shift = DEC_SHIFT(root_shift);
-      const uint32_t child_max_size = 1 << root_shift;
+      const RRBIndex child_max_size = (RRBIndex) 1 << root_shift;
 
       if (expected_size > internal->len * child_max_size) {
-        printf("Expected size (%u) is larger than what can possibly be inside "
-               "this subtree: %u.\n", expected_size,
-               internal->len * child_max_size);
+        printf("Expected size (%llu) is larger than what can possibly be "
+               "inside this subtree: %llu.\n",
+               (unsigned long long) expected_size,
+               (unsigned long long) (internal->len * child_max_size));
         *fail = 1;
       }
       else if (expected_size < ((internal->len - 1) * child_max_size)) {
-        printf("Expected size (%u) is smaller than %u, implying that some "
+        printf("Expected size (%llu) is smaller than %llu, implying that some "
                "non-rightmost node\n is not completely populated.\n",
-               expected_size, ((internal->len - 1) << root_shift));
+               (unsigned long long) expected_size,
+               (unsigned long long) ((internal->len - 1) * child_max_size));
         *fail = 1;
       }
       for (uint32_t i = 0; i < internal->len - 1; i++) {
@@ -448,8 +464,8 @@ uint32_t validate_rrb(const RRB *rrb) {
   if (rrb->root == NULL) {
     if (rrb->cnt - rrb->tail_len != 0) {
       printf("Root is null, but the size of the vector "
-             "(excluding its tail) is %u.\n",
-             rrb->cnt - rrb->tail_len);
+             "(excluding its tail) is %llu.\n",
+             (unsigned long long) (rrb->cnt - rrb->tail_len));
       fail = 1;
     }
   }
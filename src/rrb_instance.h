@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2013-2014 Jean Niklas L'orange. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef RRB_INSTANCE_H
+#define RRB_INSTANCE_H
+
+// Included by rrb.c when it is compiled as one of the specialised instances
+// behind rrb_ops, with RRB_INSTANCE_BITS bits per branching. Every external
+// symbol is renamed so that the instances can be linked together, e.g.
+// rrb_push becomes rrb4_push and transient_rrb_push becomes
+// transient_rrb4_push. New external functions must be added here as well.
+
+#define RRB_PASTE_(a, b, c) a##b##c
+#define RRB_PASTE(a, b, c) RRB_PASTE_(a, b, c)
+#define RRB_INSTANCE(name) RRB_PASTE(rrb, RRB_INSTANCE_BITS, _##name)
+#define RRB_TRANSIENT_INSTANCE(name) \
+  RRB_PASTE(transient_rrb, RRB_INSTANCE_BITS, _##name)
+
+#define RRB_OPS RRB_INSTANCE(ops)
+
+#define rrb_set_allocator RRB_INSTANCE(set_allocator)
+#define rrb_get_allocator RRB_INSTANCE(get_allocator)
+#define rrb_retain RRB_INSTANCE(retain)
+#define rrb_release RRB_INSTANCE(release)
+#define rrb_set_element_hooks RRB_INSTANCE(set_element_hooks)
+#define rrb_arena_create RRB_INSTANCE(arena_create)
+#define rrb_arena_reset RRB_INSTANCE(arena_reset)
+#define rrb_arena_destroy RRB_INSTANCE(arena_destroy)
+
+#define rrb_create RRB_INSTANCE(create)
+#define rrb_from_array RRB_INSTANCE(from_array)
+#define rrb_count RRB_INSTANCE(count)
+#define rrb_nth RRB_INSTANCE(nth)
+#define rrb_pop RRB_INSTANCE(pop)
+#define rrb_peek RRB_INSTANCE(peek)
+#define rrb_push RRB_INSTANCE(push)
+#define rrb_push_many RRB_INSTANCE(push_many)
+#define rrb_update RRB_INSTANCE(update)
+#define rrb_concat RRB_INSTANCE(concat)
+#define rrb_slice RRB_INSTANCE(slice)
+#define rrb_splice RRB_INSTANCE(splice)
+#define rrb_insert_at RRB_INSTANCE(insert_at)
+#define rrb_remove_at RRB_INSTANCE(remove_at)
+
+#define rrb_iterator_create RRB_INSTANCE(iterator_create)
+#define rrb_iterator_create_range RRB_INSTANCE(iterator_create_range)
+#define rrb_iterator_has_next RRB_INSTANCE(iterator_has_next)
+#define rrb_iterator_next RRB_INSTANCE(iterator_next)
+#define rrb_iterator_next_chunk RRB_INSTANCE(iterator_next_chunk)
+#define rrb_iterator_free RRB_INSTANCE(iterator_free)
+#define rrb_chunk_at RRB_INSTANCE(chunk_at)
+#define rrb_chunks RRB_INSTANCE(chunks)
+#define rrb_copy_range RRB_INSTANCE(copy_range)
+
+#define rrb_copy_range_parallel RRB_INSTANCE(copy_range_parallel)
+#define rrb_parallel_reduce RRB_INSTANCE(parallel_reduce)
+#define rrb_parallel_map RRB_INSTANCE(parallel_map)
+#define rrb_parallel_filter RRB_INSTANCE(parallel_filter)
+
+#define rrb_u64_create RRB_INSTANCE(u64_create)
+#define rrb_u64_release RRB_INSTANCE(u64_release)
+#define rrb_u64_count RRB_INSTANCE(u64_count)
+#define rrb_u64_nth RRB_INSTANCE(u64_nth)
+#define rrb_u64_push RRB_INSTANCE(u64_push)
+#define rrb_u64_update RRB_INSTANCE(u64_update)
+#define rrb_u64_concat RRB_INSTANCE(u64_concat)
+#define rrb_u64_slice RRB_INSTANCE(u64_slice)
+
+#define rrb_rope_create RRB_INSTANCE(rope_create)
+#define rrb_rope_from RRB_INSTANCE(rope_from)
+#define rrb_rope_release RRB_INSTANCE(rope_release)
+#define rrb_rope_count RRB_INSTANCE(rope_count)
+#define rrb_rope_byte_at RRB_INSTANCE(rope_byte_at)
+#define rrb_rope_concat RRB_INSTANCE(rope_concat)
+#define rrb_rope_slice RRB_INSTANCE(rope_slice)
+#define rrb_rope_chunks RRB_INSTANCE(rope_chunks)
+
+#define rrb_to_transient RRB_INSTANCE(to_transient)
+#define rrb_to_transient_release RRB_INSTANCE(to_transient_release)
+#define rrb_to_transient_in RRB_INSTANCE(to_transient_in)
+#define transient_to_rrb RRB_PASTE(transient_to_rrb, RRB_INSTANCE_BITS, )
+#define transient_rrb_count RRB_TRANSIENT_INSTANCE(count)
+#define transient_rrb_nth RRB_TRANSIENT_INSTANCE(nth)
+#define transient_rrb_pop RRB_TRANSIENT_INSTANCE(pop)
+#define transient_rrb_peek RRB_TRANSIENT_INSTANCE(peek)
+#define transient_rrb_push RRB_TRANSIENT_INSTANCE(push)
+#define transient_rrb_push_many RRB_TRANSIENT_INSTANCE(push_many)
+#define transient_rrb_update RRB_TRANSIENT_INSTANCE(update)
+#define transient_rrb_concat RRB_TRANSIENT_INSTANCE(concat)
+#define transient_rrb_slice RRB_TRANSIENT_INSTANCE(slice)
+#define transient_rrb_iterator_create RRB_TRANSIENT_INSTANCE(iterator_create)
+
+#define rrb_to_dot_file RRB_INSTANCE(to_dot_file)
+#define dot_file_create RRB_INSTANCE(dot_file_create)
+#define dot_file_create_safely RRB_INSTANCE(dot_file_create_safely)
+#define dot_file_close RRB_INSTANCE(dot_file_close)
+#define label_pointer RRB_INSTANCE(label_pointer)
+#define rrb_to_dot RRB_INSTANCE(to_dot)
+#define rrb_memory_usage RRB_INSTANCE(memory_usage)
+#define nodes_to_dot_file RRB_INSTANCE(nodes_to_dot_file)
+#define validate_rrb RRB_PASTE(validate_rrb, RRB_INSTANCE_BITS, )
+
+#include "rrb.h"
+
+// rrb.h describes the configured branching factors, not the ones of this
+// instance, whose leaves are as wide as its internal nodes.
+#undef RRB_BITS
+#undef RRB_LEAF_BITS
+#undef RRB_MAX_HEIGHT
+#define RRB_BITS RRB_INSTANCE_BITS
+#define RRB_LEAF_BITS RRB_INSTANCE_BITS
+#define RRB_MAX_HEIGHT ((RRB_COUNT_BITS + RRB_BITS - 1) / RRB_BITS)
+
+#endif
@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2013-2014 Jean Niklas L'orange. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef RRB_OPS_H
+#define RRB_OPS_H
+
+// The functions of this translation unit, to be picked by rrb_ops. Instances
+// export theirs as rrb4_ops and so on; see rrb_instance.h.
+
+#ifndef RRB_INSTANCE_BITS
+#define RRB_OPS default_ops
+static
+#endif
+const RRBOps RRB_OPS = {
+  .bits = RRB_BITS,
+  .leaf_bits = RRB_LEAF_BITS,
+  .create = rrb_create,
+  .from_array = rrb_from_array,
+  .retain = rrb_retain,
+  .release = rrb_release,
+
+  .count = rrb_count,
+  .nth = rrb_nth,
+  .pop = rrb_pop,
+  .peek = rrb_peek,
+  .push = rrb_push,
+  .push_many = rrb_push_many,
+  .update = rrb_update,
+  .concat = rrb_concat,
+  .slice = rrb_slice,
+  .splice = rrb_splice,
+  .insert_at = rrb_insert_at,
+  .remove_at = rrb_remove_at,
+
+  .iterator_create = rrb_iterator_create,
+  .iterator_create_range = rrb_iterator_create_range,
+  .iterator_has_next = rrb_iterator_has_next,
+  .iterator_next = rrb_iterator_next,
+  .iterator_next_chunk = rrb_iterator_next_chunk,
+  .iterator_free = rrb_iterator_free,
+  .chunk_at = rrb_chunk_at,
+  .chunks = rrb_chunks,
+  .copy_range = rrb_copy_range,
+
+  .to_transient = rrb_to_transient,
+  .to_transient_release = rrb_to_transient_release,
+  .from_transient = transient_to_rrb,
+  .transient_count = transient_rrb_count,
+  .transient_nth = transient_rrb_nth,
+  .transient_pop = transient_rrb_pop,
+  .transient_peek = transient_rrb_peek,
+  .transient_push = transient_rrb_push,
+  .transient_push_many = transient_rrb_push_many,
+  .transient_update = transient_rrb_update,
+  .transient_concat = transient_rrb_concat,
+  .transient_slice = transient_rrb_slice
+};
+
+#ifndef RRB_INSTANCE_BITS
+
+// The instances, which are librrb compiled again by rrb4.c, rrb5.c and rrb6.c.
+// They have state of their own, which is set along with this one's.
+
+extern const RRBOps rrb4_ops, rrb5_ops, rrb6_ops;
+
+void rrb4_set_allocator(const RRBAllocator *allocator);
+void rrb5_set_allocator(const RRBAllocator *allocator);
+void rrb6_set_allocator(const RRBAllocator *allocator);
+void rrb4_set_element_hooks(RRBElementFn retain, RRBElementFn release);
+void rrb5_set_element_hooks(RRBElementFn retain, RRBElementFn release);
+void rrb6_set_element_hooks(RRBElementFn retain, RRBElementFn release);
+
+const RRBOps* rrb_ops(uint32_t bits) {
+  switch (bits) {
+  case RRB_BITS:
+    return &default_ops;
+#if RRB_BITS != 4
+  case 4:
+    return &rrb4_ops;
+#endif
+#if RRB_BITS != 5
+  case 5:
+    return &rrb5_ops;
+#endif
+#if RRB_BITS != 6
+  case 6:
+    return &rrb6_ops;
+#endif
+  default:
+    return NULL;
+  }
+}
+
+static void instances_set_allocator(const RRBAllocator *allocator) {
+  rrb4_set_allocator(allocator);
+  rrb5_set_allocator(allocator);
+  rrb6_set_allocator(allocator);
+}
+
+static void instances_set_element_hooks(RRBElementFn retain,
+                                        RRBElementFn release) {
+  rrb4_set_element_hooks(retain, release);
+  rrb5_set_element_hooks(retain, release);
+  rrb6_set_element_hooks(retain, release);
+}
+
+#endif
+
+#endif
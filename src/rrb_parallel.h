@@ -0,0 +1,345 @@
+/*
+ * Copyright (c) 2013-2014 Jean Niklas L'orange. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include "rrb_thread.h"
+
+// Ranges smaller than this are not worth handing to a separate thread.
+#define PARALLEL_MIN_RANGE (RRB_BRANCHING * RRB_LEAF_BRANCHING)
+
+typedef void* (*ParallelTaskFn)(void *task);
+
+typedef struct {
+  const RRB *rrb;
+  RRBIndex from;
+  RRBIndex to;
+  void **out;
+} CopyRangeTask;
+
+typedef struct {
+  const RRB *rrb;
+  RRBIndex from;
+  RRBIndex to;
+  RRBMapFn map;
+  RRBCombineFn combine;
+  void *ctx;
+  void *result;
+} ReduceTask;
+
+typedef struct {
+  const RRB *rrb;
+  RRBIndex from;
+  RRBIndex to;
+  RRBMapFn fn;
+  void *ctx;
+  const RRB *result;
+} MapTask;
+
+// Shared by all threads of a filter. Threads grab chunks of the RRB-tree one at
+// a time until none are left, so threads hitting cheap chunks do more of them.
+typedef struct {
+  const RRB *rrb;
+  RRBPredFn pred;
+  void *ctx;
+  RRBIndex chunks;
+  RRBIndex next_chunk;
+  RRBMutex lock;
+  const RRB **results;
+} FilterJob;
+
+static uint32_t parallel_thread_count(uint32_t nthreads, RRBIndex range);
+static void parallel_split(const RRB *rrb, RRBIndex from, RRBIndex to,
+                           uint32_t parts, RRBIndex *splits);
+static void parallel_run(ParallelTaskFn fn, void *tasks, size_t task_size,
+                         uint32_t ntasks);
+static void* copy_range_task(void *arg);
+static void* reduce_task(void *arg);
+static void* map_task(void *arg);
+static void* filter_task(void *arg);
+static const RRB* concat_balanced(const RRB **parts, RRBIndex n);
+
+/**
+ * Returns the amount of threads to use for a range of size `range`, so that
+ * every thread gets at least PARALLEL_MIN_RANGE items.
+ */
+static uint32_t parallel_thread_count(uint32_t nthreads, RRBIndex range) {
+  const RRBIndex max_threads = range / PARALLEL_MIN_RANGE;
+  nthreads = (uint32_t) MIN(nthreads, max_threads);
+  return nthreads == 0 ? 1 : nthreads;
+}
+
+/**
+ * Splits [from, to) into `parts` ranges of roughly equal size, and writes the
+ * `parts + 1` boundaries into `splits`. Inner boundaries are moved back to the
+ * start of the leaf they point into, so every range starts on a leaf boundary.
+ */
+static void parallel_split(const RRB *rrb, RRBIndex from, RRBIndex to,
+                           uint32_t parts, RRBIndex *splits) {
+  const RRBIndex range = to - from;
+  splits[0] = from;
+  splits[parts] = to;
+  for (uint32_t i = 1; i < parts; i++) {
+    const RRBIndex target = from + (RRBIndex) (((uint64_t) range * i) / parts);
+    RRBIterator it;
+    iterator_init(&it, rrb, target, to);
+    splits[i] = MAX(target - it.leaf_pos, splits[i-1]);
+  }
+}
+
+/**
+ * Runs `fn` on each of the `ntasks` tasks laid out in `tasks`. The first task
+ * is run by the calling thread, the rest by threads of their own. If a thread
+ * can't be started, its task is run by the calling thread instead. With a
+ * `task_size` of 0, every thread is handed the same task.
+ */
+static void parallel_run(ParallelTaskFn fn, void *tasks, size_t task_size,
+                         uint32_t ntasks) {
+  char *task_ptr = (char *) tasks;
+  RRBThread *threads = RRB_MALLOC_ATOMIC(ntasks * sizeof(RRBThread));
+  char *started = RRB_MALLOC_ATOMIC(ntasks * sizeof(char));
+
+  for (uint32_t i = 1; i < ntasks; i++) {
+    started[i] = RRB_THREAD_CREATE(&threads[i], fn, task_ptr + i * task_size) == 0;
+  }
+  fn(task_ptr);
+  for (uint32_t i = 1; i < ntasks; i++) {
+    if (started[i]) {
+      RRB_THREAD_JOIN(threads[i]);
+    }
+    else {
+      fn(task_ptr + i * task_size);
+    }
+  }
+  RRB_FREE(threads);
+  RRB_FREE(started);
+}
+
+/**
+ * Concatenates the `n` RRB-trees in `parts`, in order. Neighbours are
+ * concatenated pairwise, level by level, so that every RRB-tree takes part in
+ * a logarithmic amount of concatenations. Overwrites `parts`, and releases the
+ * RRB-trees in it.
+ */
+static const RRB* concat_balanced(const RRB **parts, RRBIndex n) {
+  if (n == 0) {
+    return rrb_create();
+  }
+  while (n > 1) {
+    RRBIndex half = 0;
+    for (RRBIndex i = 0; i < n; i += 2, half++) {
+      if (i + 1 < n) {
+        const RRB *cat = rrb_concat(parts[i], parts[i+1]);
+        rrb_release(parts[i]);
+        rrb_release(parts[i+1]);
+        parts[half] = cat;
+      }
+      else {
+        parts[half] = parts[i];
+      }
+    }
+    n = half;
+  }
+  return parts[0];
+}
+
+static void* copy_range_task(void *arg) {
+  CopyRangeTask *task = (CopyRangeTask *) arg;
+  rrb_copy_range(task->rrb, task->from, task->to, task->out);
+  return NULL;
+}
+
+RRBIndex rrb_copy_range_parallel(const RRB *rrb, RRBIndex from, RRBIndex to,
+                                 void **out, uint32_t nthreads) {
+  to = MIN(to, rrb->cnt);
+  from = MIN(from, to);
+  nthreads = parallel_thread_count(nthreads, to - from);
+  if (nthreads == 1) {
+    return rrb_copy_range(rrb, from, to, out);
+  }
+
+  RRBIndex *splits = RRB_MALLOC_ATOMIC((nthreads + 1) * sizeof(RRBIndex));
+  parallel_split(rrb, from, to, nthreads, splits);
+  CopyRangeTask *tasks = RRB_MALLOC(nthreads * sizeof(CopyRangeTask));
+  for (uint32_t i = 0; i < nthreads; i++) {
+    tasks[i].rrb = rrb;
+    tasks[i].from = splits[i];
+    tasks[i].to = splits[i+1];
+    tasks[i].out = out + (splits[i] - from);
+  }
+  parallel_run(copy_range_task, tasks, sizeof(CopyRangeTask), nthreads);
+  RRB_FREE(splits);
+  RRB_FREE(tasks);
+  return to - from;
+}
+
+static void* reduce_task(void *arg) {
+  ReduceTask *task = (ReduceTask *) arg;
+  RRBIterator it;
+  iterator_init(&it, task->rrb, task->from, task->to);
+
+  const void *const *data;
+  uint32_t len = rrb_iterator_next_chunk(&it, &data);
+  if (len == 0) {
+    return NULL;
+  }
+  void *acc = task->map(data[0], task->ctx);
+  uint32_t i = 1;
+  do {
+    for (; i < len; i++) {
+      acc = task->combine(acc, task->map(data[i], task->ctx), task->ctx);
+    }
+    i = 0;
+  } while ((len = rrb_iterator_next_chunk(&it, &data)) != 0);
+  task->result = acc;
+  return NULL;
+}
+
+void* rrb_parallel_reduce(const RRB *rrb, uint32_t nthreads, RRBMapFn map,
+                          RRBCombineFn combine, void *ctx) {
+  if (rrb->cnt == 0) {
+    return NULL;
+  }
+  nthreads = parallel_thread_count(nthreads, rrb->cnt);
+  RRBIndex *splits = RRB_MALLOC_ATOMIC((nthreads + 1) * sizeof(RRBIndex));
+  parallel_split(rrb, 0, rrb->cnt, nthreads, splits);
+
+  ReduceTask *tasks = RRB_MALLOC(nthreads * sizeof(ReduceTask));
+  for (uint32_t i = 0; i < nthreads; i++) {
+    tasks[i].rrb = rrb;
+    tasks[i].from = splits[i];
+    tasks[i].to = splits[i+1];
+    tasks[i].map = map;
+    tasks[i].combine = combine;
+    tasks[i].ctx = ctx;
+  }
+  parallel_run(reduce_task, tasks, sizeof(ReduceTask), nthreads);
+
+  // Partial results are combined in order, skipping empty ranges.
+  void *acc = NULL;
+  char has_acc = 0;
+  for (uint32_t i = 0; i < nthreads; i++) {
+    if (tasks[i].from < tasks[i].to) {
+      acc = has_acc ? combine(acc, tasks[i].result, ctx) : tasks[i].result;
+      has_acc = 1;
+    }
+  }
+  RRB_FREE(splits);
+  RRB_FREE(tasks);
+  return acc;
+}
+
+static void* map_task(void *arg) {
+  MapTask *task = (MapTask *) arg;
+  RRBIterator it;
+  iterator_init(&it, task->rrb, task->from, task->to);
+
+  TransientRRB *trrb = rrb_to_transient(rrb_create());
+  const void *buf[RRB_LEAF_BRANCHING];
+  const void *const *data;
+  uint32_t len;
+  while ((len = rrb_iterator_next_chunk(&it, &data)) != 0) {
+    for (uint32_t i = 0; i < len; i++) {
+      buf[i] = task->fn(data[i], task->ctx);
+    }
+    trrb = transient_rrb_push_many(trrb, buf, len);
+  }
+  task->result = transient_to_rrb(trrb);
+  return NULL;
+}
+
+const RRB* rrb_parallel_map(const RRB *rrb, uint32_t nthreads, RRBMapFn fn,
+                            void *ctx) {
+  nthreads = parallel_thread_count(nthreads, rrb->cnt);
+  RRBIndex *splits = RRB_MALLOC_ATOMIC((nthreads + 1) * sizeof(RRBIndex));
+  parallel_split(rrb, 0, rrb->cnt, nthreads, splits);
+
+  MapTask *tasks = RRB_MALLOC(nthreads * sizeof(MapTask));
+  for (uint32_t i = 0; i < nthreads; i++) {
+    tasks[i].rrb = rrb;
+    tasks[i].from = splits[i];
+    tasks[i].to = splits[i+1];
+    tasks[i].fn = fn;
+    tasks[i].ctx = ctx;
+  }
+  parallel_run(map_task, tasks, sizeof(MapTask), nthreads);
+
+  const RRB **parts = RRB_MALLOC(nthreads * sizeof(RRB *));
+  for (uint32_t i = 0; i < nthreads; i++) {
+    parts[i] = tasks[i].result;
+  }
+  RRB_FREE(splits);
+  RRB_FREE(tasks);
+  const RRB *result = concat_balanced(parts, nthreads);
+  RRB_FREE(parts);
+  return result;
+}
+
+static void* filter_task(void *arg) {
+  FilterJob *job = (FilterJob *) arg;
+  const void *buf[RRB_LEAF_BRANCHING];
+  while (1) {
+    RRB_MUTEX_LOCK(&job->lock);
+    const RRBIndex chunk = job->next_chunk++;
+    RRB_MUTEX_UNLOCK(&job->lock);
+    if (chunk >= job->chunks) {
+      return NULL;
+    }
+
+    const RRBIndex from = chunk * PARALLEL_MIN_RANGE;
+    const RRBIndex to = MIN(from + PARALLEL_MIN_RANGE, job->rrb->cnt);
+    RRBIterator it;
+    iterator_init(&it, job->rrb, from, to);
+
+    TransientRRB *trrb = rrb_to_transient(rrb_create());
+    const void *const *data;
+    uint32_t len;
+    while ((len = rrb_iterator_next_chunk(&it, &data)) != 0) {
+      uint32_t matches = 0;
+      for (uint32_t i = 0; i < len; i++) {
+        if (job->pred(data[i], job->ctx)) {
+          buf[matches++] = data[i];
+        }
+      }
+      trrb = transient_rrb_push_many(trrb, buf, matches);
+    }
+    job->results[chunk] = transient_to_rrb(trrb);
+  }
+}
+
+const RRB* rrb_parallel_filter(const RRB *rrb, uint32_t nthreads,
+                               RRBPredFn pred, void *ctx) {
+  FilterJob job;
+  job.rrb = rrb;
+  job.pred = pred;
+  job.ctx = ctx;
+  job.chunks = (rrb->cnt + PARALLEL_MIN_RANGE - 1) / PARALLEL_MIN_RANGE;
+  job.next_chunk = 0;
+  job.results = RRB_MALLOC(job.chunks * sizeof(RRB *));
+  RRB_MUTEX_INIT(&job.lock);
+
+  nthreads = (uint32_t) MAX(MIN(nthreads, job.chunks), 1);
+  parallel_run(filter_task, &job, 0, nthreads);
+  RRB_MUTEX_DESTROY(&job.lock);
+  const RRB *result = concat_balanced(job.results, job.chunks);
+  RRB_FREE(job.results);
+  return result;
+}
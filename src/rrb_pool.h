@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2013-2014 Jean Niklas L'orange. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef RRB_POOL_H
+#define RRB_POOL_H
+
+// Node sizes come from a small, fixed set, so every thread keeps freelists of
+// allocations per size class. They are refilled in batches from the default
+// allocator, which spares the hot paths from contending on its lock. In
+// reference counting mode, freed allocations are returned to the freelists of
+// the thread freeing them.
+//
+// The pool of a thread is kept when the thread exits, and handed to the next
+// thread needing one. Pools are only used with the default allocator.
+
+#include "rrb_thread.h"
+
+#define POOL_GRANULE ((size_t) 16)
+// The largest pooled allocation: A full internal node with a fused size table,
+// or a full leaf node if leaves are wider, behind a reference count header.
+#define POOL_MAX_SIZE \
+  (MAX(sizeof(InternalNode) + RRB_BRANCHING * sizeof(void *) \
+       + sizeof(RRBSizeTable) + RRB_BRANCHING * sizeof(uint32_t), \
+       sizeof(LeafNode) + RRB_LEAF_BRANCHING * sizeof(void *)) \
+   + 2 * sizeof(void *))
+#define POOL_CLASSES ((POOL_MAX_SIZE + POOL_GRANULE - 1) / POOL_GRANULE)
+// The most allocations a freelist takes back before freeing them instead.
+#define POOL_MAX_FREE 256
+
+#define POOL_NEXT(obj) (*(void **) (obj))
+
+// Allocations on the freelists are zeroed, except for their first word.
+typedef struct NodePool {
+  struct NodePool *next; // The next pool not used by any thread
+  void *free[POOL_CLASSES + 1];
+  uint32_t free_len[POOL_CLASSES + 1];
+} NodePool;
+
+static RRB_THREAD_LOCAL NodePool *rrb_pool;
+static NodePool *pool_spares = NULL;
+static RRBMutex pool_spares_lock = RRB_MUTEX_INITIALIZER;
+static RRBThreadKey pool_key;
+static RRBOnce pool_key_once = RRB_ONCE_INIT;
+
+static void pool_detach(void *pool) {
+  rrb_pool = NULL;
+  RRB_MUTEX_LOCK(&pool_spares_lock);
+  ((NodePool *) pool)->next = pool_spares;
+  pool_spares = pool;
+  RRB_MUTEX_UNLOCK(&pool_spares_lock);
+}
+
+static void pool_key_create() {
+  RRB_THREAD_KEY_CREATE(&pool_key, pool_detach);
+}
+
+static NodePool* pool_attach() {
+  RRB_ONCE(&pool_key_once, pool_key_create);
+  RRB_MUTEX_LOCK(&pool_spares_lock);
+  NodePool *pool = pool_spares;
+  if (pool != NULL) {
+    pool_spares = pool->next;
+  }
+  RRB_MUTEX_UNLOCK(&pool_spares_lock);
+  if (pool == NULL) {
+    pool = RRB_MALLOC_ROOT(sizeof(NodePool));
+  }
+  rrb_pool = pool;
+  RRB_THREAD_KEY_SET(pool_key, pool);
+  return pool;
+}
+
+/**
+ * Returns the size class of allocations of `size` bytes, or 0 if they are not
+ * pooled.
+ */
+static inline uint32_t pool_class(size_t size) {
+  if (size > POOL_MAX_SIZE || !RRB_ALLOCATOR_IS_DEFAULT()) {
+    return 0;
+  }
+  return (uint32_t) ((size + POOL_GRANULE - 1) / POOL_GRANULE);
+}
+
+static void pool_refill(NodePool *pool, uint32_t class) {
+  void *list = RRB_MALLOC_MANY(class * POOL_GRANULE);
+  uint32_t len = 0;
+  for (void *obj = list; obj != NULL; obj = POOL_NEXT(obj)) {
+    len++;
+  }
+  pool->free[class] = list;
+  pool->free_len[class] = len;
+}
+
+/**
+ * Returns a zeroed allocation of the size class `class`.
+ */
+static inline void* pool_take(uint32_t class) {
+  NodePool *pool = rrb_pool != NULL ? rrb_pool : pool_attach();
+  if (pool->free[class] == NULL) {
+    pool_refill(pool, class);
+  }
+  void *obj = pool->free[class];
+  pool->free[class] = POOL_NEXT(obj);
+  pool->free_len[class]--;
+  POOL_NEXT(obj) = NULL;
+  return obj;
+}
+
+/**
+ * Returns zeroed memory, from the pool if `size` is pooled.
+ */
+static inline void* pool_malloc(size_t size) {
+  const uint32_t class = pool_class(size);
+  return class != 0 ? pool_take(class) : RRB_MALLOC(size);
+}
+
+#ifdef RRB_REFCOUNT
+
+/**
+ * Returns `obj`, an allocation of the size class `class`, to the pool of the
+ * current thread.
+ */
+static void pool_give(void *obj, uint32_t class) {
+  NodePool *pool = rrb_pool != NULL ? rrb_pool : pool_attach();
+  if (pool->free_len[class] >= POOL_MAX_FREE) {
+    RRB_DEFAULT_FREE(obj);
+    return;
+  }
+  memset(obj, 0, class * POOL_GRANULE);
+  POOL_NEXT(obj) = pool->free[class];
+  pool->free[class] = obj;
+  pool->free_len[class]++;
+}
+
+#endif
+#endif
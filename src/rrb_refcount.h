@@ -0,0 +1,376 @@
+/*
+ * Copyright (c) 2013-2014 Jean Niklas L'orange. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef RRB_REFCOUNT_H
+#define RRB_REFCOUNT_H
+
+// Memory management for everything reachable from an RRB-tree: nodes, size
+// tables and RRB heads. With the garbage collector, this is allocation from
+// the pool of the thread (see rrb_pool.h), or from the current arena (see
+// rrb_arena.h).
+//
+// In reference counting mode, every such allocation is preceded by a hidden
+// header with its reference count, so that cloning a node with memcpy never
+// copies the count. A count of zero means that the allocation isn't reachable
+// from any RRB-tree handed out to users: It is either being built by the
+// current operation, or garbage.
+//
+// Public operations build their result without touching any reference counts.
+// When they return, the result is sealed: Every new node reachable from it
+// counts its children once, after which the remaining new allocations with a
+// count of zero are freed. Transients do the same, but keep their allocations
+// until they are made persistent.
+//
+// Allocations from an arena are pinned, with a count that never drops to zero:
+// They are only freed when the arena is reset.
+
+#ifdef RRB_REFCOUNT
+
+#include "rrb_thread.h"
+
+typedef union {
+  struct {
+    uint32_t refs;
+    uint32_t pool_class; // 0 if not allocated from a pool
+  };
+  void *align[2];
+} RCHeader;
+
+#define RC_HEADER(ptr) (((RCHeader *) (ptr)) - 1)
+#define RC_REFS(ptr) __atomic_load_n(&RC_HEADER(ptr)->refs, __ATOMIC_ACQUIRE)
+#define RC_INC(ptr) __atomic_add_fetch(&RC_HEADER(ptr)->refs, 1, __ATOMIC_RELAXED)
+#define RC_DEC(ptr) __atomic_sub_fetch(&RC_HEADER(ptr)->refs, 1, __ATOMIC_ACQ_REL)
+#define RC_PINNED ((uint32_t) 1 << 31)
+
+#define RC_LOG_INLINE 64
+
+// The allocations made by an operation or a transient, in allocation order.
+typedef struct {
+  void **entries;
+  uint32_t len;
+  uint32_t cap;
+  // RRB-trees a transient shares nodes with, released once it is persistent.
+  const RRB **held;
+  uint32_t held_len;
+  uint32_t held_cap;
+  void *inline_entries[RC_LOG_INLINE];
+} RCLog;
+
+// The log operations on this thread allocate into. NULL means the thread log.
+static RRB_THREAD_LOCAL RCLog *rc_log;
+static RRB_THREAD_LOCAL RCLog rc_thread_log;
+
+static RRBElementFn rc_element_retain;
+static RRBElementFn rc_element_release;
+
+static void rc_retain_node(TreeNode *node);
+static void rc_release_node(TreeNode *node);
+
+static inline RCLog* rc_current_log() {
+  return rc_log != NULL ? rc_log : &rc_thread_log;
+}
+
+static void rc_log_push(RCLog *log, void *ptr) {
+  if (log->len == log->cap) {
+    if (log->cap == 0) {
+      log->entries = log->inline_entries;
+      log->cap = RC_LOG_INLINE;
+    }
+    else if (log->entries == log->inline_entries) {
+      log->entries = RRB_MALLOC_ATOMIC(2 * log->cap * sizeof(void *));
+      memcpy(log->entries, log->inline_entries, log->len * sizeof(void *));
+      log->cap *= 2;
+    }
+    else {
+      log->cap *= 2;
+      log->entries = RRB_REALLOC(log->entries, log->cap * sizeof(void *));
+    }
+  }
+  log->entries[log->len++] = ptr;
+}
+
+static void* rc_arena_malloc(size_t size) {
+  RCHeader *header = arena_malloc(rrb_arena, sizeof(RCHeader) + size);
+  header->refs = RC_PINNED;
+  header->pool_class = 0;
+  return header + 1;
+}
+
+static void* rc_malloc(size_t size) {
+  if (rrb_arena != NULL) {
+    return rc_arena_malloc(size);
+  }
+  const uint32_t class = pool_class(sizeof(RCHeader) + size);
+  RCHeader *header = class != 0 ? pool_take(class)
+                                : RRB_MALLOC(sizeof(RCHeader) + size);
+  header->pool_class = class;
+  rc_log_push(rc_current_log(), header + 1);
+  return header + 1;
+}
+
+static void* rc_malloc_atomic(size_t size) {
+  if (rrb_arena != NULL) {
+    return rc_arena_malloc(size);
+  }
+  const uint32_t class = pool_class(sizeof(RCHeader) + size);
+  RCHeader *header = class != 0 ? pool_take(class)
+                                : RRB_MALLOC_ATOMIC(sizeof(RCHeader) + size);
+  header->refs = 0;
+  header->pool_class = class;
+  rc_log_push(rc_current_log(), header + 1);
+  return header + 1;
+}
+
+static inline void rc_free(void *ptr) {
+  RCHeader *header = RC_HEADER(ptr);
+  if (header->pool_class != 0) {
+    pool_give(header, header->pool_class);
+  }
+  else {
+    RRB_FREE(header);
+  }
+}
+
+#define NODE_MALLOC(size) rc_malloc(size)
+#define NODE_MALLOC_ATOMIC(size) rc_malloc_atomic(size)
+// Garbage is freed when the operation allocating it ends.
+#define NODE_FREE(ptr) ((void) 0)
+
+static void rc_retain_table(RRBSizeTable *table) {
+  if (RC_REFS(table) == 0) {
+    table->guid = 0;
+  }
+  RC_INC(table);
+}
+
+/**
+ * Seals a node on its first reference: Its children are counted, and it is
+ * detached from the transient that may have built it.
+ */
+static void rc_retain_node(TreeNode *node) {
+  if (node == NULL || node == (TreeNode *) &EMPTY_LEAF) {
+    return;
+  }
+  if (RC_REFS(node) == 0) {
+    node->guid = 0;
+    if (node->type == INTERNAL_NODE) {
+      InternalNode *internal = (InternalNode *) node;
+      if (internal->size_table != NULL && !size_table_fused(internal)) {
+        rc_retain_table(internal->size_table);
+      }
+      for (uint32_t i = 0; i < internal->len; i++) {
+        rc_retain_node((TreeNode *) internal->child[i]);
+      }
+    }
+    else if (rc_element_retain != NULL && !node->unboxed) {
+      const LeafNode *leaf = (const LeafNode *) node;
+      for (uint32_t i = 0; i < leaf->len; i++) {
+        rc_element_retain(leaf->child[i]);
+      }
+    }
+  }
+  RC_INC(node);
+}
+
+static void rc_release_node(TreeNode *node) {
+  if (node == NULL || node == (TreeNode *) &EMPTY_LEAF || RC_DEC(node) != 0) {
+    return;
+  }
+  if (node->type == INTERNAL_NODE) {
+    InternalNode *internal = (InternalNode *) node;
+    if (internal->size_table != NULL && !size_table_fused(internal)
+        && RC_DEC(internal->size_table) == 0) {
+      rc_free(internal->size_table);
+    }
+    for (uint32_t i = 0; i < internal->len; i++) {
+      rc_release_node((TreeNode *) internal->child[i]);
+    }
+  }
+  else if (rc_element_release != NULL && !node->unboxed) {
+    const LeafNode *leaf = (const LeafNode *) node;
+    for (uint32_t i = 0; i < leaf->len; i++) {
+      rc_element_release(leaf->child[i]);
+    }
+  }
+  rc_free(node);
+}
+
+static void rc_retain_head(const RRB *rrb) {
+  if (rrb == NULL || rrb == &EMPTY_RRB) {
+    return;
+  }
+  if (RC_REFS(rrb) == 0) {
+    rc_retain_node(rrb->root);
+    rc_retain_node((TreeNode *) rrb->tail);
+  }
+  RC_INC(rrb);
+}
+
+static void rc_release_head(const RRB *rrb) {
+  if (rrb == NULL || rrb == &EMPTY_RRB || RC_DEC(rrb) != 0) {
+    return;
+  }
+  rc_release_node(rrb->root);
+  rc_release_node((TreeNode *) rrb->tail);
+  rc_free((void *) rrb);
+}
+
+/**
+ * Frees the allocations made after `mark` which are unreachable, and removes
+ * them all from the log.
+ */
+static void rc_sweep(RCLog *log, uint32_t mark) {
+  for (uint32_t i = mark; i < log->len; i++) {
+    if (RC_REFS(log->entries[i]) == 0) {
+      rc_free(log->entries[i]);
+    }
+  }
+  log->len = mark;
+  if (mark == 0 && log->entries != log->inline_entries && log->entries != NULL) {
+    RRB_FREE(log->entries);
+    log->entries = NULL;
+    log->cap = 0;
+  }
+}
+
+static inline uint32_t rc_scope_begin() {
+  return rc_current_log()->len;
+}
+
+/**
+ * Ends the operation started at `mark`, returning `result` with a reference
+ * owned by the caller.
+ */
+static const RRB* rc_scope_end(uint32_t mark, const RRB *result) {
+  rc_retain_head(result);
+  rc_sweep(rc_current_log(), mark);
+  return result;
+}
+
+#define RC_SCOPE_BEGIN() const uint32_t rc_mark = rc_scope_begin()
+#define RC_RETURN(rrb) return rc_scope_end(rc_mark, (rrb))
+
+static RCLog* rc_log_create() {
+  RCLog *log = RRB_MALLOC(sizeof(RCLog));
+  return log;
+}
+
+// Makes `log` release `rrb` when it is destroyed, taking over a reference the
+// caller owns.
+static void rc_log_adopt(RCLog *log, const RRB *rrb) {
+  if (log->held_len == log->held_cap) {
+    log->held_cap = log->held_cap == 0 ? 4 : 2 * log->held_cap;
+    log->held = RRB_REALLOC(log->held, log->held_cap * sizeof(RRB *));
+  }
+  log->held[log->held_len++] = rrb;
+}
+
+static void rc_log_hold(RCLog *log, const RRB *rrb) {
+  rc_retain_head(rrb);
+  rc_log_adopt(log, rrb);
+}
+
+/**
+ * Moves the allocations in `log` over to the current log, so that they are
+ * swept when the current operation ends.
+ */
+static void rc_log_merge(RCLog *log) {
+  RCLog *current = rc_current_log();
+  for (uint32_t i = 0; i < log->len; i++) {
+    rc_log_push(current, log->entries[i]);
+  }
+  log->len = 0;
+}
+
+static void rc_log_destroy(RCLog *log) {
+  for (uint32_t i = 0; i < log->held_len; i++) {
+    rc_release_head(log->held[i]);
+  }
+  if (log->entries != log->inline_entries && log->entries != NULL) {
+    RRB_FREE(log->entries);
+  }
+  if (log->held != NULL) {
+    RRB_FREE(log->held);
+  }
+  RRB_FREE(log);
+}
+
+static void rc_arena_hold(RRBArena *arena, const RRB *rrb) {
+  if (arena->held_len == arena->held_cap) {
+    arena->held_cap = arena->held_cap == 0 ? 4 : 2 * arena->held_cap;
+    arena->held = RRB_REALLOC(arena->held, arena->held_cap * sizeof(RRB *));
+  }
+  rc_retain_head(rrb);
+  arena->held[arena->held_len++] = rrb;
+}
+
+static void rc_arena_release(RRBArena *arena) {
+  for (uint32_t i = 0; i < arena->held_len; i++) {
+    rc_release_head(arena->held[i]);
+  }
+  arena->held_len = 0;
+}
+
+static inline RCLog* rc_enter(RCLog *log) {
+  RCLog *saved = rc_log;
+  if (log != NULL) {
+    rc_log = log;
+  }
+  return saved;
+}
+
+static inline void rc_leave(RCLog **saved) {
+  rc_log = *saved;
+}
+
+// Makes the rest of the enclosing block allocate into the log of `trrb`, if it
+// has one. Transients without a log belong to the operation using them.
+#define RC_TRANSIENT_SCOPE(trrb) \
+  RCLog *rc_saved_log __attribute__((cleanup(rc_leave))) = rc_enter((trrb)->log)
+
+// Keeps `rrb` alive until `trrb` is made persistent, if `trrb` has a log, or
+// until the arena of `trrb` is reset.
+#define RC_TRANSIENT_HOLD(trrb, rrb) \
+  do { \
+    if ((trrb)->arena != NULL) rc_arena_hold((trrb)->arena, (rrb)); \
+    else if ((trrb)->log != NULL) rc_log_hold((trrb)->log, (rrb)); \
+  } while (0)
+
+#else
+
+#define NODE_MALLOC(size) \
+  (rrb_arena != NULL ? arena_malloc(rrb_arena, size) : pool_malloc(size))
+// Pooled memory is scanned by the garbage collector, which size tables need
+// not be.
+#define NODE_MALLOC_ATOMIC(size) \
+  (rrb_arena != NULL ? arena_malloc(rrb_arena, size) : RRB_MALLOC_ATOMIC(size))
+// Arena memory is only reclaimed by resetting the arena.
+#define NODE_FREE(ptr) do { if (rrb_arena == NULL) RRB_FREE(ptr); } while (0)
+
+#define RC_SCOPE_BEGIN()
+#define RC_RETURN(rrb) return (rrb)
+#define RC_TRANSIENT_SCOPE(trrb)
+#define RC_TRANSIENT_HOLD(trrb, rrb)
+
+#endif
+#endif
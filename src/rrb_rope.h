@@ -0,0 +1,397 @@
+/*
+ * Copyright (c) 2013-2014 Jean Niklas L'orange. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef RRB_ROPE_H
+#define RRB_ROPE_H
+
+// An RRBRope is a tree of byte chunks, built from the same nodes as RRB-trees:
+// Its leaves are unboxed, with their length in bytes, and all its internal
+// nodes have fused size tables of uint64_t byte counts. As chunks may have any
+// length, every internal node is relaxed, and there is no tail. Instead, the
+// nodes meeting at a concatenation are merged whenever they fit in one, which
+// keeps adjacent nodes at least half full on average.
+#define ROPE_CHUNK 4096
+
+#if ROPE_CHUNK >= (1 << 14)
+#error "Leaf lengths are stored in 14 bits, which ROPE_CHUNK must fit in."
+#endif
+
+struct RRBRope_ {
+  uint64_t cnt;
+  uint32_t height;
+  TreeNode *root;
+};
+
+static const RRBRope EMPTY_ROPE = {.cnt = 0, .height = 0, .root = NULL};
+
+#ifdef RRB_REFCOUNT
+
+static void rope_retain_head(const RRBRope *rope) {
+  if (rope == &EMPTY_ROPE) {
+    return;
+  }
+  if (RC_REFS(rope) == 0) {
+    rc_retain_node(rope->root);
+  }
+  RC_INC(rope);
+}
+
+static const RRBRope* rope_scope_end(uint32_t mark, const RRBRope *result) {
+  rope_retain_head(result);
+  rc_sweep(rc_current_log(), mark);
+  return result;
+}
+
+#define ROPE_RETURN(rope) return rope_scope_end(rc_mark, (rope))
+
+#else
+
+#define ROPE_RETURN(rope) return (rope)
+
+#endif
+
+static inline char* rope_bytes(const LeafNode *leaf) {
+  return (char *) leaf->child;
+}
+
+static inline uint64_t* rope_sizes(const InternalNode *node) {
+  return (uint64_t *) node->size_table->size;
+}
+
+static inline uint64_t rope_node_size(const TreeNode *node) {
+  if (node->type == LEAF_NODE) {
+    return node->len;
+  }
+  return rope_sizes((const InternalNode *) node)[node->len - 1];
+}
+
+static LeafNode* rope_leaf_create(const char *bytes, uint32_t len) {
+  LeafNode *leaf = NODE_MALLOC_ATOMIC(sizeof(LeafNode) + len);
+  // Atomic memory isn't cleared, so set the whole header.
+  leaf->type = LEAF_NODE;
+  leaf->len = len;
+  leaf->fused = false;
+  leaf->unboxed = true;
+  leaf->guid = 0;
+  if (bytes != NULL) {
+    memcpy(rope_bytes(leaf), bytes, len);
+  }
+  return leaf;
+}
+
+static LeafNode* rope_leaf_merge(const LeafNode *left, const LeafNode *right) {
+  LeafNode *merged = rope_leaf_create(NULL, left->len + right->len);
+  memcpy(rope_bytes(merged), rope_bytes(left), left->len);
+  memcpy(rope_bytes(merged) + left->len, rope_bytes(right), right->len);
+  return merged;
+}
+
+/**
+ * Creates an internal node with the `len` children in `children`, and computes
+ * its size table. The table is placed after the children, aligned for its
+ * uint64_t sizes.
+ */
+static InternalNode* rope_node_create(TreeNode *const *children, uint32_t len) {
+  const size_t table_offset = (sizeof(InternalNode) + len * sizeof(TreeNode *)
+                               + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1);
+  InternalNode *node = NODE_MALLOC(table_offset + sizeof(RRBSizeTable)
+                                   + len * sizeof(uint64_t));
+  node->type = INTERNAL_NODE;
+  node->len = len;
+  node->fused = true;
+  node->size_table = (RRBSizeTable *) ((char *) node + table_offset);
+  memcpy(node->child, children, len * sizeof(TreeNode *));
+
+  uint64_t *sizes = rope_sizes(node);
+  uint64_t total = 0;
+  for (uint32_t i = 0; i < len; i++) {
+    total += rope_node_size(children[i]);
+    sizes[i] = total;
+  }
+  return node;
+}
+
+static RRBRope* rope_head_create(uint64_t cnt, uint32_t height,
+                                 TreeNode *root) {
+  RRBRope *rope = NODE_MALLOC(sizeof(RRBRope));
+  rope->cnt = cnt;
+  rope->height = height;
+  rope->root = root;
+  return rope;
+}
+
+/**
+ * Returns the index of the child of `node` containing byte `*index`, and makes
+ * `*index` relative to that child.
+ */
+static inline uint32_t rope_child_pos(const InternalNode *node,
+                                      uint64_t *index) {
+  const uint64_t *sizes = rope_sizes(node);
+  uint32_t is = 0;
+  while (sizes[is] <= *index) {
+    is++;
+  }
+  if (is != 0) {
+    *index -= sizes[is - 1];
+  }
+  return is;
+}
+
+const RRBRope* rrb_rope_create() {
+  return &EMPTY_ROPE;
+}
+
+void rrb_rope_release(const RRBRope *rope) {
+#ifdef RRB_REFCOUNT
+  if (rope == &EMPTY_ROPE || RC_DEC(rope) != 0) {
+    return;
+  }
+  rc_release_node(rope->root);
+  rc_free((void *) rope);
+#else
+  (void) rope;
+#endif
+}
+
+/**
+ * Builds the rope bottom-up, like rrb_from_array: The bytes are copied into
+ * full chunks, of which only the last may be shorter, and the levels above are
+ * filled from the left.
+ */
+const RRBRope* rrb_rope_from(const char *bytes, uint64_t len) {
+  RC_SCOPE_BEGIN();
+  if (len == 0) {
+    ROPE_RETURN(rrb_rope_create());
+  }
+  uint64_t level_len = (len - 1) / ROPE_CHUNK + 1;
+  TreeNode **level = RRB_MALLOC(level_len * sizeof(TreeNode *));
+  for (uint64_t i = 0; i < level_len; i++) {
+    const uint64_t start = i * ROPE_CHUNK;
+    level[i] = (TreeNode *) rope_leaf_create(&bytes[start],
+                                             MIN(ROPE_CHUNK, len - start));
+  }
+
+  uint32_t height = 0;
+  while (level_len > 1) {
+    height++;
+    const uint64_t parent_len = ((level_len - 1) >> RRB_BITS) + 1;
+    // As in rrb_from_array, parent i overwrites index i after its children
+    // have been read.
+    for (uint64_t i = 0; i < parent_len; i++) {
+      const uint64_t start = i << RRB_BITS;
+      const uint32_t child_len = MIN(RRB_BRANCHING, level_len - start);
+      level[i] = (TreeNode *) rope_node_create(&level[start], child_len);
+    }
+    level_len = parent_len;
+  }
+
+  RRBRope *rope = rope_head_create(len, height, level[0]);
+  RRB_FREE(level);
+  ROPE_RETURN(rope);
+}
+
+uint64_t rrb_rope_count(const RRBRope *rope) {
+  return rope->cnt;
+}
+
+int rrb_rope_byte_at(const RRBRope *rope, uint64_t index) {
+  if (index >= rope->cnt) {
+    return -1;
+  }
+  const TreeNode *node = rope->root;
+  for (uint32_t height = rope->height; height > 0; height--) {
+    const InternalNode *internal = (const InternalNode *) node;
+    node = (const TreeNode *) internal->child[rope_child_pos(internal, &index)];
+  }
+  return (unsigned char) rope_bytes((const LeafNode *) node)[index];
+}
+
+/**
+ * Stores the `len` nodes in `nodes` into `out` as one node above them, or as two
+ * if they don't fit in one. Returns the number of nodes stored.
+ */
+static uint32_t rope_split(TreeNode *const *nodes, uint32_t len,
+                           TreeNode **out) {
+  if (len <= RRB_BRANCHING) {
+    out[0] = (TreeNode *) rope_node_create(nodes, len);
+    return 1;
+  }
+  const uint32_t left_len = (len + 1) / 2;
+  out[0] = (TreeNode *) rope_node_create(nodes, left_len);
+  out[1] = (TreeNode *) rope_node_create(&nodes[left_len], len - left_len);
+  return 2;
+}
+
+/**
+ * Concatenates `left` and `right`, of heights `left_height` and `right_height`,
+ * into one node of the greater height, or two if they don't fit in one. The
+ * nodes are stored into `out`, and their number is returned. Only the nodes
+ * along the edges where the trees meet are copied: The leaves meeting are
+ * merged if they fit in a chunk, and every level above is packed into one node
+ * if its children fit.
+ */
+static uint32_t rope_join(TreeNode *left, uint32_t left_height,
+                          TreeNode *right, uint32_t right_height,
+                          TreeNode **out) {
+  if (left_height == 0 && right_height == 0) {
+    if (left->len + right->len <= ROPE_CHUNK) {
+      out[0] = (TreeNode *) rope_leaf_merge((LeafNode *) left,
+                                            (LeafNode *) right);
+      return 1;
+    }
+    out[0] = left;
+    out[1] = right;
+    return 2;
+  }
+  const uint32_t height = MAX(left_height, right_height);
+  TreeNode *all[2 * RRB_BRANCHING];
+  uint32_t len = 0;
+
+  TreeNode *left_edge = left;
+  if (left_height == height) {
+    const InternalNode *internal = (const InternalNode *) left;
+    len = internal->len - 1;
+    memcpy(all, internal->child, len * sizeof(TreeNode *));
+    left_edge = (TreeNode *) internal->child[len];
+    left_height--;
+  }
+  TreeNode *right_edge = right;
+  const InternalNode *right_internal = NULL;
+  if (right_height == height) {
+    right_internal = (const InternalNode *) right;
+    right_edge = (TreeNode *) right_internal->child[0];
+    right_height--;
+  }
+  len += rope_join(left_edge, left_height, right_edge, right_height, &all[len]);
+  if (right_internal != NULL) {
+    memcpy(&all[len], &right_internal->child[1],
+           (right_internal->len - 1) * sizeof(TreeNode *));
+    len += right_internal->len - 1;
+  }
+  return rope_split(all, len, out);
+}
+
+const RRBRope* rrb_rope_concat(const RRBRope *left, const RRBRope *right) {
+  RC_SCOPE_BEGIN();
+  if (left->cnt == 0) {
+    ROPE_RETURN(right);
+  }
+  if (right->cnt == 0) {
+    ROPE_RETURN(left);
+  }
+  TreeNode *roots[2];
+  uint32_t height = MAX(left->height, right->height);
+  TreeNode *root;
+  if (rope_join(left->root, left->height, right->root, right->height,
+                roots) == 1) {
+    root = roots[0];
+  }
+  else {
+    root = (TreeNode *) rope_node_create(roots, 2);
+    height++;
+  }
+  ROPE_RETURN(rope_head_create(left->cnt + right->cnt, height, root));
+}
+
+/**
+ * Returns the bytes of `node` from `from` to `to` as a node of the same height.
+ * The range must be nonempty. Children entirely within the range are shared,
+ * so only the two edges of the range are copied.
+ */
+static TreeNode* rope_slice_rec(TreeNode *node, uint64_t from, uint64_t to) {
+  if (from == 0 && to == rope_node_size(node)) {
+    return node;
+  }
+  if (node->type == LEAF_NODE) {
+    return (TreeNode *) rope_leaf_create(rope_bytes((LeafNode *) node) + from,
+                                         to - from);
+  }
+  const InternalNode *internal = (const InternalNode *) node;
+  const uint64_t *sizes = rope_sizes(internal);
+  uint64_t first_from = from;
+  uint64_t last_to = to - 1;
+  const uint32_t first = rope_child_pos(internal, &first_from);
+  const uint32_t last = rope_child_pos(internal, &last_to);
+
+  TreeNode *children[RRB_BRANCHING];
+  for (uint32_t i = first; i <= last; i++) {
+    const uint64_t start = i == 0 ? 0 : sizes[i - 1];
+    children[i - first] = rope_slice_rec((TreeNode *) internal->child[i],
+                                         MAX(from, start) - start,
+                                         MIN(to, sizes[i]) - start);
+  }
+  return (TreeNode *) rope_node_create(children, last - first + 1);
+}
+
+const RRBRope* rrb_rope_slice(const RRBRope *rope, uint64_t from,
+                              uint64_t to) {
+  RC_SCOPE_BEGIN();
+  to = MIN(to, rope->cnt);
+  if (from >= to) {
+    ROPE_RETURN(rrb_rope_create());
+  }
+  if (from == 0 && to == rope->cnt) {
+    ROPE_RETURN(rope);
+  }
+  TreeNode *root = rope_slice_rec(rope->root, from, to);
+  uint32_t height = rope->height;
+  // Drop the nodes above the root which only have a single child.
+  while (height > 0 && root->len == 1) {
+    root = (TreeNode *) ((InternalNode *) root)->child[0];
+    height--;
+  }
+  ROPE_RETURN(rope_head_create(to - from, height, root));
+}
+
+static int rope_chunks_rec(const TreeNode *node, uint64_t from, uint64_t to,
+                           RRBRopeChunkFn fn, void *ctx) {
+  if (node->type == LEAF_NODE) {
+    return fn(rope_bytes((const LeafNode *) node) + from, to - from, ctx);
+  }
+  const InternalNode *internal = (const InternalNode *) node;
+  const uint64_t *sizes = rope_sizes(internal);
+  uint64_t offset = from;
+  for (uint32_t i = rope_child_pos(internal, &offset);
+       i < internal->len && (i == 0 ? 0 : sizes[i - 1]) < to; i++) {
+    const uint64_t start = i == 0 ? 0 : sizes[i - 1];
+    const int res = rope_chunks_rec((const TreeNode *) internal->child[i],
+                                    MAX(from, start) - start,
+                                    MIN(to, sizes[i]) - start, fn, ctx);
+    if (res != 0) {
+      return res;
+    }
+  }
+  return 0;
+}
+
+int rrb_rope_chunks(const RRBRope *rope, uint64_t from, uint64_t to,
+                    RRBRopeChunkFn fn, void *ctx) {
+  to = MIN(to, rope->cnt);
+  if (from >= to) {
+    return 0;
+  }
+  return rope_chunks_rec(rope->root, from, to, fn, ctx);
+}
+
+#endif
@@ -27,8 +27,25 @@
 #include <pthread.h>
 
 typedef pthread_t RRBThread;
+typedef pthread_mutex_t RRBMutex;
+typedef pthread_key_t RRBThreadKey;
+typedef pthread_once_t RRBOnce;
 
 #define RRB_THREAD_ID pthread_self
 #define RRB_THREAD_EQUALS(a, b) pthread_equal(a, b)
+#define RRB_THREAD_CREATE(thread, fn, arg) pthread_create(thread, NULL, fn, arg)
+#define RRB_THREAD_JOIN(thread) pthread_join(thread, NULL)
+#define RRB_THREAD_LOCAL __thread
+
+#define RRB_MUTEX_INITIALIZER PTHREAD_MUTEX_INITIALIZER
+#define RRB_MUTEX_INIT(mutex) pthread_mutex_init(mutex, NULL)
+#define RRB_MUTEX_DESTROY(mutex) pthread_mutex_destroy(mutex)
+#define RRB_MUTEX_LOCK(mutex) pthread_mutex_lock(mutex)
+#define RRB_MUTEX_UNLOCK(mutex) pthread_mutex_unlock(mutex)
+
+#define RRB_ONCE_INIT PTHREAD_ONCE_INIT
+#define RRB_ONCE(once, fn) pthread_once(once, fn)
+#define RRB_THREAD_KEY_CREATE(key, destructor) pthread_key_create(key, destructor)
+#define RRB_THREAD_KEY_SET(key, value) pthread_setspecific(key, value)
 
 #endif
@@ -24,49 +24,92 @@
 #include "rrb_thread.h"
 
 struct TransientRRB_ {
-  uint32_t cnt;
+  RRBIndex cnt;
   uint32_t shift;
   uint32_t tail_len;
+  uint8_t bits;
+  uint8_t leaf_bits;
   LeafNode *tail;
   TreeNode *root;
   RRBThread owner;
   GUID_DECLARATION
+  RRBArena *arena;
+#ifdef RRB_REFCOUNT
+  RCLog *log;
+#endif
 };
 
+// Makes the rest of the enclosing block allocate from the arena of `trrb`, and
+// into its log.
+#define TRANSIENT_SCOPE(trrb) \
+  ARENA_SCOPE((trrb)->arena); \
+  RC_TRANSIENT_SCOPE(trrb)
 
-static const void* rrb_guid_create(void);
+
+static Guid rrb_guid_create(void);
 static TransientRRB* transient_rrb_head_create(const RRB* rrb);
 static void check_transience(const TransientRRB *trrb);
 
-static RRBSizeTable* transient_size_table_create(void);
+static RRBSizeTable* transient_size_table_create(uint32_t shift);
 static InternalNode* transient_internal_node_create(void);
 static LeafNode* transient_leaf_node_create(void);
 static RRBSizeTable* transient_size_table_clone(const RRBSizeTable *table,
-                                                uint32_t len, const void *guid);
+                                                uint32_t len, Guid guid);
 static InternalNode* transient_internal_node_clone(const InternalNode *internal,
-                                                   const void *guid);
-static LeafNode* transient_leaf_node_clone(const LeafNode *leaf, const void *guid);
+                                                   Guid guid);
+static LeafNode* transient_leaf_node_clone(const LeafNode *leaf, Guid guid);
 
 static RRBSizeTable* ensure_size_table_editable(const RRBSizeTable *table,
-                                                uint32_t len, const void *guid);
-static InternalNode* ensure_internal_editable(InternalNode *internal, const void *guid);
-static LeafNode* ensure_leaf_editable(LeafNode *leaf, const void *guid);
+                                                uint32_t len, Guid guid);
+static InternalNode* ensure_internal_editable(InternalNode *internal, Guid guid);
+static LeafNode* ensure_leaf_editable(LeafNode *leaf, Guid guid);
 
 static void transient_promote_rightmost_leaf(TransientRRB* trrb);
 
-static const void* rrb_guid_create() {
-  return (const void *) RRB_MALLOC_ATOMIC(1);
+static InternalNode* transient_concat_sub_tree(TreeNode *left_node,
+                                               uint32_t left_shift,
+                                               TreeNode *right_node,
+                                               uint32_t right_shift,
+                                               char is_top, Guid guid);
+static InternalNode* transient_rebalance(InternalNode *left,
+                                         InternalNode *centre,
+                                         InternalNode *right, uint32_t shift,
+                                         char is_top, Guid guid);
+static void transient_execute_concat_plan(InternalNode *const *all,
+                                          const uint32_t *node_size,
+                                          uint32_t slen, uint32_t shift,
+                                          InternalNode **new_all,
+                                          Guid guid);
+static InternalNode* transient_internal_node_new_above(InternalNode *left,
+                                                       InternalNode *right,
+                                                       Guid guid);
+static InternalNode* transient_reuse_or_create(InternalNode *candidate,
+                                               Guid guid);
+static InternalNode* transient_set_sizes(InternalNode *node, uint32_t shift,
+                                         Guid guid);
+
+static TreeNode* transient_slice_rec(TreeNode *node, uint32_t shift,
+                                     RRBIndex size, RRBIndex from, RRBIndex to,
+                                     char collapse, uint32_t *new_shift,
+                                     Guid guid);
+
+static Guid guid_counter = 0;
+
+static Guid rrb_guid_create() {
+  return __atomic_add_fetch(&guid_counter, 1, __ATOMIC_RELAXED);
 }
 
 static TransientRRB* transient_rrb_head_create(const RRB* rrb) {
-  TransientRRB *trrb = RRB_MALLOC(sizeof(TransientRRB));
+  TransientRRB *trrb = NODE_MALLOC(sizeof(TransientRRB));
   memcpy(trrb, rrb, sizeof(RRB));
   trrb->owner = RRB_THREAD_ID();
+  trrb->arena = rrb_arena;
   return trrb;
 }
 
 static void check_transience(const TransientRRB *trrb) {
-  if (trrb->guid == NULL) {
+  CHECK_BRANCHING(trrb);
+  if (trrb->guid == 0) {
     // Transient used after transient_to_persistent call
     exit(1);
   }
@@ -77,56 +120,69 @@ static void check_transience(const TransientRRB *trrb) {
 }
 
 static InternalNode* transient_internal_node_create() {
-  InternalNode *node = RRB_MALLOC(sizeof(InternalNode)
-                              + RRB_BRANCHING * sizeof(InternalNode *));
+  InternalNode *node = NODE_MALLOC(sizeof(InternalNode)
+                               + RRB_BRANCHING * sizeof(InternalNode *));
   node->type = INTERNAL_NODE;
   node->size_table = NULL;
   return node;
 }
 
-static RRBSizeTable* transient_size_table_create() {
-  // this atomic allocation is, strictly speaking, NOT ok. Small chance of guid
-  // being reallocated at same position if lost. Note when porting over to
-  // different GC/Precise mode.
-  RRBSizeTable *table = RRB_MALLOC_ATOMIC(sizeof(RRBSizeTable)
-                                          + RRB_BRANCHING * sizeof(void *));
+static RRBSizeTable* transient_size_table_create(uint32_t shift) {
+  RRBSizeTable *table = NODE_MALLOC_ATOMIC(size_table_bytes(shift,
+                                                            RRB_BRANCHING));
+  table->width = SIZE_TABLE_WIDTH(shift);
   return table;
 }
 
 static LeafNode* transient_leaf_node_create() {
-  LeafNode *node = RRB_MALLOC(sizeof(LeafNode)
-                              + RRB_BRANCHING * sizeof(void *));
+  LeafNode *node = LEAF_MALLOC(sizeof(LeafNode)
+                               + RRB_LEAF_BRANCHING * sizeof(void *));
   node->type = LEAF_NODE;
+  node->len = 0;
+  node->fused = false;
+  node->unboxed = rrb_unboxed;
+  node->guid = 0;
   return node;
 }
 
 static RRBSizeTable* transient_size_table_clone(const RRBSizeTable *table,
-                                                uint32_t len, const void *guid) {
-  RRBSizeTable *copy = transient_size_table_create();
-  memcpy(copy, table, sizeof(RRBSizeTable) + len * sizeof(uint32_t));
+                                                uint32_t len, Guid guid) {
+  RRBSizeTable *copy = NODE_MALLOC_ATOMIC(sizeof(RRBSizeTable)
+                                          + RRB_BRANCHING
+                                            * size_table_width(table));
+  copy->width = table->width;
+  size_table_copy(copy, table, 0, len);
   copy->guid = guid;
   return copy;
 }
 
 
 static InternalNode* transient_internal_node_clone(const InternalNode *internal,
-                                                   const void *guid) {
+                                                   Guid guid) {
   InternalNode *copy = transient_internal_node_create();
   memcpy(copy, internal,
          sizeof(InternalNode) + internal->len * sizeof(InternalNode *));
   copy->guid = guid;
+  if (size_table_fused(internal)) {
+    // Transient nodes have room for every child, so the table can't follow
+    // them.
+    copy->fused = false;
+    copy->size_table = transient_size_table_clone(internal->size_table,
+                                                  internal->len, guid);
+  }
   return copy;
 }
 
-static LeafNode* transient_leaf_node_clone(const LeafNode *leaf, const void *guid) {
+static LeafNode* transient_leaf_node_clone(const LeafNode *leaf, Guid guid) {
   LeafNode *copy = transient_leaf_node_create();
   memcpy(copy, leaf, sizeof(LeafNode) + leaf->len * sizeof(void *));
+  copy->unboxed = rrb_unboxed;
   copy->guid = guid;
   return copy;
 }
 
 static RRBSizeTable* ensure_size_table_editable(const RRBSizeTable *table,
-                                                uint32_t len, const void *guid) {
+                                                uint32_t len, Guid guid) {
   if (table->guid == guid) {
     return table;
   }
@@ -135,7 +191,7 @@ static RRBSizeTable* ensure_size_table_editable(const RRBSizeTable *table,
   }
 }
 
-static InternalNode* ensure_internal_editable(InternalNode *internal, const void *guid) {
+static InternalNode* ensure_internal_editable(InternalNode *internal, Guid guid) {
   if (internal->guid == guid) {
     return internal;
   }
@@ -144,7 +200,7 @@ static InternalNode* ensure_internal_editable(InternalNode *internal, const void
   }
 }
 
-static LeafNode* ensure_leaf_editable(LeafNode *leaf, const void *guid) {
+static LeafNode* ensure_leaf_editable(LeafNode *leaf, Guid guid) {
   if (leaf->guid == guid) {
     return leaf;
   }
@@ -153,17 +209,22 @@ static LeafNode* ensure_leaf_editable(LeafNode *leaf, const void *guid) {
   }
 }
 
-TransientRRB* rrb_to_transient(const RRB *rrb) {
+/**
+ * Creates a transient used within a single operation. Unlike the ones from
+ * rrb_to_transient, its allocations belong to the operation, which must turn it
+ * into its result with transient_persist.
+ */
+static TransientRRB* transient_create(const RRB *rrb) {
   TransientRRB* trrb = transient_rrb_head_create(rrb);
-  const void *guid = rrb_guid_create();
+  Guid guid = rrb_guid_create();
   trrb->guid = guid;
   trrb->tail = transient_leaf_node_clone(rrb->tail, guid);
   return trrb;
 }
 
-const RRB* transient_to_rrb(TransientRRB *trrb) {
+static const RRB* transient_persist(TransientRRB *trrb) {
   // Deny further modifications on the tree.
-  trrb->guid = NULL;
+  trrb->guid = 0;
   // reshrink tail
   // In case of optimisation where tail len is not modified (NOT yet tested!)
   // we have to handle it here first.
@@ -172,12 +233,78 @@ const RRB* transient_to_rrb(TransientRRB *trrb) {
   return rrb;
 }
 
-uint32_t transient_rrb_count(const TransientRRB *trrb) {
+/**
+ * Creates a transient from `rrb`. If `owned` is true, the transient takes over
+ * the caller's reference to `rrb` instead of retaining it.
+ */
+static TransientRRB* transient_from(const RRB *rrb, int owned) {
+  CHECK_BRANCHING(rrb);
+#ifdef RRB_REFCOUNT
+  // The transient allocates into a log of its own, which is swept once it is
+  // made persistent. Until then, it keeps the nodes it shares with rrb alive.
+  RCLog *log = rc_log_create();
+  RCLog *saved = rc_enter(log);
+  TransientRRB *trrb = transient_create(rrb);
+  rc_leave(&saved);
+  trrb->log = log;
+  if (owned) {
+    rc_log_adopt(log, rrb);
+  }
+  else {
+    rc_log_hold(log, rrb);
+  }
+  return trrb;
+#else
+  (void) owned;
+  return transient_create(rrb);
+#endif
+}
+
+TransientRRB* rrb_to_transient(const RRB *rrb) {
+  return transient_from(rrb, false);
+}
+
+TransientRRB* rrb_to_transient_release(const RRB *rrb) {
+  return transient_from(rrb, true);
+}
+
+TransientRRB* rrb_to_transient_in(const RRB *rrb, RRBArena *arena) {
+  CHECK_BRANCHING(rrb);
+  ARENA_SCOPE(arena);
+  TransientRRB *trrb = transient_create(rrb);
+  // Nodes shared with rrb must outlive the arena's.
+  RC_TRANSIENT_HOLD(trrb, rrb);
+  return trrb;
+}
+
+const RRB* transient_to_rrb(TransientRRB *trrb) {
+  CHECK_BRANCHING(trrb);
+  if (trrb->arena != NULL) {
+    // The result lives in the arena as well.
+    ARENA_SCOPE(trrb->arena);
+    return transient_persist(trrb);
+  }
+#ifdef RRB_REFCOUNT
+  RCLog *log = trrb->log;
+  RC_SCOPE_BEGIN();
+  const RRB *rrb = transient_persist(trrb);
+  // The transient itself is part of its log, and is freed along with the
+  // nodes it dropped.
+  rc_log_merge(log);
+  rrb = rc_scope_end(rc_mark, rrb);
+  rc_log_destroy(log);
+  return rrb;
+#else
+  return transient_persist(trrb);
+#endif
+}
+
+RRBIndex transient_rrb_count(const TransientRRB *trrb) {
   check_transience(trrb);
   return rrb_count((const RRB *) trrb);
 }
 
-void* transient_rrb_nth(const TransientRRB *trrb, uint32_t index) {
+void* transient_rrb_nth(const TransientRRB *trrb, RRBIndex index) {
   check_transience(trrb);
   return rrb_nth((const RRB *) trrb, index);
 }
@@ -187,18 +314,28 @@ void* transient_rrb_peek(const TransientRRB *trrb) {
   return rrb_peek((const RRB *) trrb);
 }
 
+RRBIterator* transient_rrb_iterator_create(const TransientRRB *trrb) {
+  check_transience(trrb);
+  return rrb_iterator_create((const RRB *) trrb);
+}
+
 // rrb_push MUST use direct append techniques, otherwise it has to use
 // concatenation. And, as mentioned in the report, concatenation modification is
 // not evident.
 
-static InternalNode** mutate_first_k(TransientRRB *trrb, const uint32_t k);
+static InternalNode** mutate_first_k(TransientRRB *trrb, const uint32_t k,
+                                     const uint32_t tail_size);
 
 static InternalNode** new_editable_path(InternalNode **to_set,
-                                        uint32_t empty_height, const void *guid);
+                                        uint32_t empty_height, Guid guid);
+
+static TransientRRB* transient_push_down_tail(TransientRRB *trrb,
+                                              LeafNode *old_tail);
 
 TransientRRB* transient_rrb_push(TransientRRB *restrict trrb, const void *restrict elt) {
   check_transience(trrb);
-  if (trrb->tail_len < RRB_BRANCHING) {
+  TRANSIENT_SCOPE(trrb);
+  if (trrb->tail_len < RRB_LEAF_BRANCHING) {
     trrb->tail->child[trrb->tail_len] = elt;
     trrb->cnt++;
     trrb->tail_len++;
@@ -207,17 +344,59 @@ TransientRRB* transient_rrb_push(TransientRRB *restrict trrb, const void *restri
     return trrb;
   }
 
-  trrb->cnt++;
-  const void *guid = trrb->guid;
-
   LeafNode *new_tail = transient_leaf_node_create();
-  new_tail->guid = guid;
+  new_tail->guid = trrb->guid;
   new_tail->child[0] = elt;
   new_tail->len = 1;
-  trrb->tail_len = 1;
 
-  const LeafNode *old_tail = trrb->tail;
+  LeafNode *old_tail = trrb->tail;
   trrb->tail = new_tail;
+  trrb->tail_len = 1;
+  trrb->cnt++;
+  return transient_push_down_tail(trrb, old_tail);
+}
+
+TransientRRB* transient_rrb_push_many(TransientRRB *restrict trrb,
+                                      const void *const *restrict elts,
+                                      RRBIndex n) {
+  check_transience(trrb);
+  TRANSIENT_SCOPE(trrb);
+  Guid guid = trrb->guid;
+
+  // Fill up the current tail first
+  RRBIndex pos = MIN(RRB_LEAF_BRANCHING - trrb->tail_len, n);
+  memcpy(&trrb->tail->child[trrb->tail_len], elts, pos * sizeof(void *));
+  trrb->cnt += pos;
+  trrb->tail_len += pos;
+  trrb->tail->len += pos;
+
+  // Then insert whole leaves: Every leaf except the last one is full, and only
+  // the path nodes not yet owned by this transient are copied.
+  while (pos < n) {
+    const uint32_t len = (uint32_t) MIN(RRB_LEAF_BRANCHING, n - pos);
+    LeafNode *new_tail = transient_leaf_node_create();
+    new_tail->guid = guid;
+    new_tail->len = len;
+    memcpy(new_tail->child, &elts[pos], len * sizeof(void *));
+
+    LeafNode *old_tail = trrb->tail;
+    trrb->tail = new_tail;
+    trrb->tail_len = len;
+    trrb->cnt += len;
+    transient_push_down_tail(trrb, old_tail);
+    pos += len;
+  }
+  return trrb;
+}
+
+/**
+ * Inserts `old_tail` as the rightmost leaf node in the trie. The transient must
+ * already have its new tail set, and its count must include the elements in
+ * both the old and the new tail.
+ */
+static TransientRRB* transient_push_down_tail(TransientRRB *trrb,
+                                              LeafNode *old_tail) {
+  Guid guid = trrb->guid;
 
   if (trrb->root == NULL) { // If it's  null, we can't just mutate it down.
     trrb->shift = LEAF_NODE_SHIFT;
@@ -229,7 +408,7 @@ TransientRRB* transient_rrb_push(TransientRRB *restrict trrb, const void *restri
   // TODO: Can find last rightmost jump in constant time for pvec subvecs:
   // use the fact that (index & large_mask) == 1 << (RRB_BITS * H) - 1 -> 0 etc.
 
-  uint32_t index = trrb->cnt - 2;
+  RRBIndex index = trrb->cnt - trrb->tail_len - 1;
 
   uint32_t nodes_to_mutate = 0;
   uint32_t nodes_visited = 0;
@@ -249,21 +428,21 @@ TransientRRB* transient_rrb_push(TransientRRB *restrict trrb, const void *restri
       // impl, the same way the size_table check only has to be done until it's
       // false.
       const uint32_t prev_shift = shift + RRB_BITS;
-      if (index >> prev_shift > 0) {
+      if (prev_shift < RRB_COUNT_BITS && index >> prev_shift > 0) {
         nodes_visited++; // this could possibly be done earlier in the code.
         goto mutable_count_end;
       }
       child_index = (index >> shift) & RRB_MASK;
       // index filtering is not necessary when the check above is performed at
       // most once.
-      index &= ~(RRB_MASK << shift);
+      index &= ~((RRBIndex) RRB_MASK << shift);
     }
     else {
       // no need for sized_pos here, luckily.
       child_index = current->len - 1;
       // Decrement index
       if (child_index != 0) {
-        index -= current->size_table->size[child_index-1];
+        index -= size_table_get(current->size_table, child_index-1);
       }
     }
     nodes_visited++;
@@ -272,7 +451,8 @@ TransientRRB* transient_rrb_push(TransientRRB *restrict trrb, const void *restri
       pos = child_index;
     }
 
-    current = current->child[child_index];
+    // Nodes not yet owned by the transient only have room for their children.
+    current = child_index < current->len ? current->child[child_index] : NULL;
     // This will only happen in a pvec subtree
     if (current == NULL) {
       nodes_to_mutate = nodes_visited;
@@ -282,7 +462,7 @@ TransientRRB* transient_rrb_push(TransientRRB *restrict trrb, const void *restri
       // times.
       goto mutable_count_end;
     }
-    shift -= RRB_BITS;
+    shift = DEC_SHIFT(shift);
   }
   // if we're here, we're at the leaf node (or lowest non-leaf), which is
   // `current`
@@ -302,12 +482,11 @@ TransientRRB* transient_rrb_push(TransientRRB *restrict trrb, const void *restri
   // nodes_visited set straight.
   while (shift > INC_SHIFT(LEAF_NODE_SHIFT)) {
     nodes_visited++;
-    shift -= RRB_BITS;
+    shift = DEC_SHIFT(shift);
   }
 
   // Increasing height of tree.
   if (nodes_to_mutate == 0) {
-    const InternalNode *old_root = (const InternalNode *) trrb->root;
     InternalNode *new_root = transient_internal_node_create();
     new_root->guid = guid;
     new_root->len = 2;
@@ -315,21 +494,17 @@ TransientRRB* transient_rrb_push(TransientRRB *restrict trrb, const void *restri
     trrb->root = (TreeNode *) new_root;
     trrb->shift = INC_SHIFT(RRB_SHIFT(trrb));
 
-    // create size table if the original rrb root has a size table.
-    if (old_root->type != LEAF_NODE &&
-        ((const InternalNode *) old_root)->size_table != NULL) {
-      RRBSizeTable *table = transient_size_table_create();
+    // create size table if the original rrb root isn't full (may happen after
+    // popping or slicing a relaxed tree).
+    if (!trie_full(trrb->cnt - (old_tail->len + trrb->tail_len),
+                   DEC_SHIFT(RRB_SHIFT(trrb)))) {
+      RRBSizeTable *table = transient_size_table_create(RRB_SHIFT(trrb));
       table->guid = trrb->guid;
-      table->size[0] = trrb->cnt - (old_tail->len + 1);
-      // If we insert the tail, the old size minus (new size minus one) the old
-      // tail size will be the amount of elements in the left branch. If there
-      // is no tail, the size is just the old rrb-tree.
+      size_table_set(table, 0, trrb->cnt - (old_tail->len + trrb->tail_len));
+      // The left branch contains everything but the old and the new tail.
 
-      table->size[1] = trrb->cnt - 1;
-      // If we insert the tail, the old size would include the tail.
-      // Consequently, it has to be the old size. If we have no tail, we append
-      // a single element to the old vector, therefore it has to be one more
-      // than the original (which means it is zero)
+      size_table_set(table, 1, trrb->cnt - trrb->tail_len);
+      // The right branch contains the old tail only.
 
       new_root->size_table = table;
     }
@@ -340,7 +515,7 @@ TransientRRB* transient_rrb_push(TransientRRB *restrict trrb, const void *restri
     *to_set = (InternalNode *) old_tail;
   }
   else {
-    InternalNode **node = mutate_first_k(trrb, nodes_to_mutate);
+    InternalNode **node = mutate_first_k(trrb, nodes_to_mutate, old_tail->len);
     InternalNode **to_set = new_editable_path(node, nodes_visited - nodes_to_mutate,
                                               guid);
     *to_set = (InternalNode *) old_tail;
@@ -349,11 +524,12 @@ TransientRRB* transient_rrb_push(TransientRRB *restrict trrb, const void *restri
   return trrb;
 }
 
-static InternalNode** mutate_first_k(TransientRRB *trrb, const uint32_t k) {
-  const void *guid = trrb->guid;
+static InternalNode** mutate_first_k(TransientRRB *trrb, const uint32_t k,
+                                     const uint32_t tail_size) {
+  Guid guid = trrb->guid;
   InternalNode *current = (InternalNode *) trrb->root;
   InternalNode **to_set = (InternalNode **) &trrb->root;
-  uint32_t index = trrb->cnt - 2;
+  RRBIndex index = trrb->cnt - trrb->tail_len - 1;
   uint32_t shift = RRB_SHIFT(trrb);
 
   // mutate all non-leaf nodes first. Happens when shift > RRB_BRANCHING
@@ -363,21 +539,39 @@ static InternalNode** mutate_first_k(TransientRRB *trrb, const uint32_t k) {
     current = ensure_internal_editable(current, guid);
     *to_set = current;
 
+    // Ensure size table is editable too, before the new slot is added: A
+    // table not yet owned only has room for the current children.
+    if (current->size_table != NULL) {
+      current->size_table = ensure_size_table_editable(current->size_table,
+                                                       current->len, guid);
+    }
+
+    if (i == k && current->size_table == NULL
+        && !trie_full(size_sub_trie((TreeNode *) current->child[current->len-1],
+                                    DEC_SHIFT(shift)),
+                      DEC_SHIFT(shift))) {
+      // The last child isn't full (after a slice), so the node is relaxed as
+      // soon as it gets another child.
+      RRBSizeTable *table = transient_size_table_create(shift);
+      table->guid = guid;
+      dense_sizes(current, shift, table);
+      current->size_table = table;
+    }
+
     if (i == k) {
       // increase width of node
       current->len++;
     }
 
     if (current->size_table != NULL) {
-      // Ensure size table is editable too
-      RRBSizeTable *table = ensure_size_table_editable(current->size_table, current->len, guid);
+      RRBSizeTable *table = current->size_table;
       if (i != k) {
-        // Tail will always be 32 long, otherwise we insert a single element only
-        table->size[current->len-1] += RRB_BRANCHING;
+        size_table_set(table, current->len-1,
+                       size_table_get(table, current->len-1) + tail_size);
       }
       else { // increment size of last elt -- will only happen if we append empties
-        table->size[current->len-1] =
-          table->size[current->len-2] + RRB_BRANCHING;
+        size_table_set(table, current->len-1,
+                       size_table_get(table, current->len-2) + tail_size);
       }
       current->size_table = table;
     }
@@ -392,14 +586,14 @@ static InternalNode** mutate_first_k(TransientRRB *trrb, const uint32_t k) {
       child_index = current->len - 1;
       // Decrement index
       if (child_index != 0) {
-        index -= current->size_table->size[child_index-1];
+        index -= size_table_get(current->size_table, child_index-1);
       }
     }
     to_set = &current->child[child_index];
     current = current->child[child_index];
 
     i++;
-    shift -= RRB_BITS;
+    shift = DEC_SHIFT(shift);
   }
 
   // check if we need to mutate the leaf node. Very likely to happen (31/32)
@@ -412,7 +606,7 @@ static InternalNode** mutate_first_k(TransientRRB *trrb, const uint32_t k) {
 }
 
 static InternalNode** new_editable_path(InternalNode **to_set, uint32_t empty_height,
-                                        const void* guid) {
+                                        Guid guid) {
   if (0 < empty_height) {
     InternalNode *leaf = transient_internal_node_create();
     leaf->guid = guid;
@@ -437,19 +631,20 @@ static InternalNode** new_editable_path(InternalNode **to_set, uint32_t empty_he
 // transient_rrb_update is effectively the same as rrb_update, but may mutate
 // nodes if it's safe to do so (replacing clone calls with ensure_editable
 // calls)
-TransientRRB* transient_rrb_update(TransientRRB *restrict trrb, uint32_t index,
+TransientRRB* transient_rrb_update(TransientRRB *restrict trrb, RRBIndex index,
                                    const void *restrict elt) {
   check_transience(trrb);
-  const void* guid = trrb->guid;
+  TRANSIENT_SCOPE(trrb);
+  Guid guid = trrb->guid;
   if (index < trrb->cnt) {
-    const uint32_t tail_offset = trrb->cnt - trrb->tail_len;
+    const RRBIndex tail_offset = trrb->cnt - trrb->tail_len;
     if (tail_offset <= index) {
       trrb->tail->child[index - tail_offset] = elt;
       return trrb;
     }
     InternalNode **previous_pointer = (InternalNode **) &trrb->root;
     InternalNode *current = (InternalNode *) trrb->root;
-    for (uint32_t shift = RRB_SHIFT(trrb); shift > 0; shift -= RRB_BITS) {
+    for (uint32_t shift = RRB_SHIFT(trrb); shift > 0; shift = DEC_SHIFT(shift)) {
       current = ensure_internal_editable(current, guid);
       *previous_pointer = current;
 
@@ -467,7 +662,7 @@ TransientRRB* transient_rrb_update(TransientRRB *restrict trrb, uint32_t index,
     LeafNode *leaf = (LeafNode *) current;
     leaf = ensure_leaf_editable((LeafNode *) leaf, guid);
     *previous_pointer = (InternalNode *) leaf;
-    leaf->child[index & RRB_MASK] = elt;
+    leaf->child[index & RRB_LEAF_MASK] = elt;
     return trrb;
   }
   else {
@@ -477,6 +672,7 @@ TransientRRB* transient_rrb_update(TransientRRB *restrict trrb, uint32_t index,
 
 TransientRRB* transient_rrb_pop(TransientRRB *trrb) {
   check_transience(trrb);
+  TRANSIENT_SCOPE(trrb);
   if (trrb->cnt == 1) {
     trrb->cnt = 0;
     trrb->tail_len = 0;
@@ -500,7 +696,7 @@ TransientRRB* transient_rrb_pop(TransientRRB *trrb) {
 }
 
 void transient_promote_rightmost_leaf(TransientRRB* trrb) {
-  const void* guid = trrb->guid;
+  Guid guid = trrb->guid;
   InternalNode *current = (InternalNode *) trrb->root;
 
   InternalNode *path[RRB_MAX_HEIGHT+1];
@@ -509,14 +705,15 @@ void transient_promote_rightmost_leaf(TransientRRB* trrb) {
 
   // populate path array
   for (i = 0, shift = LEAF_NODE_SHIFT; shift < RRB_SHIFT(trrb);
-       i++, shift += RRB_BITS) {
+       i++, shift = INC_SHIFT(shift)) {
     path[i+1] = path[i]->child[path[i]->len-1];
   }
 
   const uint32_t height = i;
 
-  // Set leaf node as tail.
-  trrb->tail = (LeafNode *) path[height];
+  // Set leaf node as tail. It may be shared with persistent RRB-trees, so
+  // ensure we can mutate it before pushing onto or popping off it.
+  trrb->tail = ensure_leaf_editable((LeafNode *) path[height], guid);
   trrb->tail_len = path[height]->len;
   const uint32_t tail_len = trrb->tail_len;
 
@@ -528,18 +725,22 @@ void transient_promote_rightmost_leaf(TransientRRB* trrb) {
     }
     else if (path[i+1] == NULL && i == 0 && path[0]->len == 2) {
       path[i] = path[i]->child[0];
-      trrb->shift -= RRB_BITS;
+      trrb->shift = DEC_SHIFT(trrb->shift);
     }
     else {
       path[i] = ensure_internal_editable(path[i], guid);
       path[i]->child[path[i]->len-1] = path[i+1];
       if (path[i+1] == NULL) {
+        // The last child is removed entirely, so the remaining sizes are
+        // already correct.
         path[i]->len--;
       }
-      if (path[i]->size_table != NULL) { // this is decrement-size-table*
+      else if (path[i]->size_table != NULL) { // this is decrement-size-table*
         path[i]->size_table = ensure_size_table_editable(path[i]->size_table,
                                                          path[i]->len, guid);
-        path[i]->size_table->size[path[i]->len-1] -= tail_len;
+        RRBSizeTable *table = path[i]->size_table;
+        size_table_set(table, path[i]->len-1,
+                       size_table_get(table, path[i]->len-1) - tail_len);
       }
     }
   }
@@ -547,11 +748,478 @@ void transient_promote_rightmost_leaf(TransientRRB* trrb) {
   trrb->root = (TreeNode *) path[0];
 }
 
-// TODO: more efficient slicing algorithm for transients. Should in theory just
-// require some size table magic and converting cloning over to ensure_editable.
-TransientRRB* transient_rrb_slice(TransientRRB *trrb, uint32_t from, uint32_t to) {
+// transient_rrb_concat follows rrb_concat closely, but nodes owned by the
+// transient are reused when rebalancing instead of being copied.
+TransientRRB* transient_rrb_concat(TransientRRB *restrict trrb,
+                                   const RRB *restrict right) {
   check_transience(trrb);
-  const RRB* rrb = rrb_slice((const RRB*) trrb, from, to);
-  memcpy(trrb, rrb, sizeof(RRB));
+  CHECK_BRANCHING(right);
+  TRANSIENT_SCOPE(trrb);
+  Guid guid = trrb->guid;
+  if (right->cnt == 0) {
+    return trrb;
+  }
+  if (right->root != NULL) {
+    // The trie of right is shared from here on.
+    RC_TRANSIENT_HOLD(trrb, right);
+  }
+  if (trrb->cnt == 0) {
+    trrb->cnt = right->cnt;
+    trrb->shift = right->shift;
+    trrb->root = right->root;
+    trrb->tail_len = right->tail_len;
+    trrb->tail = transient_leaf_node_clone(right->tail, guid);
+    return trrb;
+  }
+  else if (right->root == NULL) {
+    return transient_rrb_push_many(trrb, right->tail->child, right->tail_len);
+  }
+
+  // Push down the left tail, with a copy of the right tail as the new tail.
+  // Only the right tail is counted for now, as push down expects the trie to
+  // be the left trie.
+  LeafNode *old_tail = trrb->tail;
+  trrb->tail = transient_leaf_node_clone(right->tail, guid);
+  trrb->tail_len = right->tail_len;
+  trrb->cnt += right->tail_len;
+  transient_push_down_tail(trrb, old_tail);
+
+  InternalNode *root_candidate =
+    transient_concat_sub_tree(trrb->root, RRB_SHIFT(trrb),
+                              right->root, RRB_SHIFT(right), true, guid);
+
+  trrb->shift = find_shift((TreeNode *) root_candidate);
+  trrb->root = (TreeNode *) transient_set_sizes(root_candidate,
+                                                RRB_SHIFT(trrb), guid);
+  trrb->cnt += right->cnt - right->tail_len;
+  return trrb;
+}
+
+static InternalNode* transient_concat_sub_tree(TreeNode *left_node,
+                                               uint32_t left_shift,
+                                               TreeNode *right_node,
+                                               uint32_t right_shift,
+                                               char is_top, Guid guid) {
+  if (left_shift > right_shift) {
+    InternalNode *left_internal = (InternalNode *) left_node;
+    InternalNode *centre_node =
+      transient_concat_sub_tree((TreeNode *) left_internal->child[left_internal->len - 1],
+                                DEC_SHIFT(left_shift),
+                                right_node, right_shift,
+                                false, guid);
+    return transient_rebalance(left_internal, centre_node, NULL, left_shift,
+                               is_top, guid);
+  }
+  else if (left_shift < right_shift) {
+    InternalNode *right_internal = (InternalNode *) right_node;
+    InternalNode *centre_node =
+      transient_concat_sub_tree(left_node, left_shift,
+                                (TreeNode *) right_internal->child[0],
+                                DEC_SHIFT(right_shift),
+                                false, guid);
+    return transient_rebalance(NULL, centre_node, right_internal, right_shift,
+                               is_top, guid);
+  }
+  else if (left_shift == LEAF_NODE_SHIFT) {
+    LeafNode *left_leaf = (LeafNode *) left_node;
+    LeafNode *right_leaf = (LeafNode *) right_node;
+    if (is_top && (left_leaf->len + right_leaf->len) <= RRB_LEAF_BRANCHING) {
+      // Merge into the left leaf, copying it only if we don't own it
+      LeafNode *merged = ensure_leaf_editable(left_leaf, guid);
+      memcpy(&merged->child[merged->len], right_leaf->child,
+             right_leaf->len * sizeof(void *));
+      merged->len += right_leaf->len;
+      InternalNode *above = transient_internal_node_create();
+      above->guid = guid;
+      above->len = 1;
+      above->child[0] = (InternalNode *) merged;
+      return above;
+    }
+    else {
+      return transient_internal_node_new_above((InternalNode *) left_node,
+                                               (InternalNode *) right_node,
+                                               guid);
+    }
+  }
+  else {
+    InternalNode *left_internal = (InternalNode *) left_node;
+    InternalNode *right_internal = (InternalNode *) right_node;
+    InternalNode *centre_node =
+      transient_concat_sub_tree((TreeNode *) left_internal->child[left_internal->len - 1],
+                                DEC_SHIFT(left_shift),
+                                (TreeNode *) right_internal->child[0],
+                                DEC_SHIFT(right_shift),
+                                false, guid);
+    return transient_rebalance(left_internal, centre_node, right_internal,
+                               left_shift, is_top, guid);
+  }
+}
+
+static InternalNode* transient_internal_node_new_above(InternalNode *left,
+                                                       InternalNode *right,
+                                                       Guid guid) {
+  InternalNode *above = transient_internal_node_create();
+  above->guid = guid;
+  above->len = 2;
+  above->child[0] = left;
+  above->child[1] = right;
+  return above;
+}
+
+/**
+ * Returns `candidate` if it is owned by the transient, otherwise a new internal
+ * node owned by it.
+ */
+static InternalNode* transient_reuse_or_create(InternalNode *candidate,
+                                               Guid guid) {
+  if (candidate != NULL && candidate->guid == guid) {
+    return candidate;
+  }
+  InternalNode *node = transient_internal_node_create();
+  node->guid = guid;
+  return node;
+}
+
+static InternalNode* transient_rebalance(InternalNode *left,
+                                         InternalNode *centre,
+                                         InternalNode *right, uint32_t shift,
+                                         char is_top, Guid guid) {
+  // Merge the children onto the stack, so that the nodes they came from can be
+  // reused for the result.
+  InternalNode *all[2 * RRB_BRANCHING];
+  uint32_t all_len = 0;
+  if (left != NULL) {
+    memcpy(&all[all_len], left->child, (left->len - 1) * sizeof(InternalNode *));
+    all_len += left->len - 1;
+  }
+  memcpy(&all[all_len], centre->child, centre->len * sizeof(InternalNode *));
+  all_len += centre->len;
+  if (right != NULL) {
+    memcpy(&all[all_len], &right->child[1],
+           (right->len - 1) * sizeof(InternalNode *));
+    all_len += right->len - 1;
+  }
+
+  uint32_t node_count[2 * RRB_BRANCHING];
+  const uint32_t top_len =
+    create_concat_plan(all, all_len, node_count,
+                       shift == INC_SHIFT(LEAF_NODE_SHIFT) ? RRB_LEAF_BRANCHING
+                                                           : RRB_BRANCHING);
+
+  InternalNode *new_all[2 * RRB_BRANCHING];
+  transient_execute_concat_plan(all, node_count, top_len, shift, new_all, guid);
+
+  // The centre node is always owned by us, so there is always a node to reuse.
+  InternalNode *new_left = (left != NULL && left->guid == guid) ? left : centre;
+  if (new_left == centre) {
+    centre = NULL;
+  }
+  const uint32_t left_len = MIN(top_len, RRB_BRANCHING);
+  memcpy(new_left->child, new_all, left_len * sizeof(InternalNode *));
+  new_left->len = left_len;
+
+  if (top_len <= RRB_BRANCHING) {
+    if (is_top == false) {
+      InternalNode *above = transient_reuse_or_create(centre, guid);
+      above->len = 1;
+      above->size_table = NULL;
+      above->child[0] = transient_set_sizes(new_left, shift, guid);
+      return above;
+    }
+    else {
+      return new_left;
+    }
+  }
+  else {
+    InternalNode *new_right = transient_reuse_or_create(centre, guid);
+    memcpy(new_right->child, &new_all[RRB_BRANCHING],
+           (top_len - RRB_BRANCHING) * sizeof(InternalNode *));
+    new_right->len = top_len - RRB_BRANCHING;
+    return transient_internal_node_new_above(transient_set_sizes(new_left, shift,
+                                                                 guid),
+                                             transient_set_sizes(new_right, shift,
+                                                                 guid),
+                                             guid);
+  }
+}
+
+/**
+ * Executes the concat plan in `node_size`, and writes the resulting nodes into
+ * `new_all`. Nodes owned by the transient are extended in place when their
+ * first element stays first in the new node.
+ */
+static void transient_execute_concat_plan(InternalNode *const *all,
+                                          const uint32_t *node_size,
+                                          uint32_t slen, uint32_t shift,
+                                          InternalNode **new_all,
+                                          Guid guid) {
+  // Current old node index to copy from
+  uint32_t idx = 0;
+  // Offset is how long into the current old node we've already copied from
+  uint32_t offset = 0;
+
+  // Leaf nodes and internal nodes both store their children right after the
+  // header, so they are copied in the same way.
+  for (uint32_t i = 0; i < slen; i++) {
+    const uint32_t new_size = node_size[i];
+    TreeNode *old = (TreeNode *) all[idx];
+
+    if (offset == 0 && new_size == old->len) {
+      idx++;
+      new_all[i] = (InternalNode *) old;
+      continue;
+    }
+
+    TreeNode *new_node;
+    void **new_child;
+    uint32_t cur_size = 0;
+    if (offset == 0 && old->guid == guid && old->len < new_size) {
+      new_node = old;
+      cur_size = old->len;
+      idx++;
+    }
+    else if (shift == INC_SHIFT(LEAF_NODE_SHIFT)) {
+      new_node = (TreeNode *) transient_leaf_node_create();
+      new_node->guid = guid;
+    }
+    else {
+      new_node = (TreeNode *) transient_internal_node_create();
+      new_node->guid = guid;
+    }
+    new_child = shift == INC_SHIFT(LEAF_NODE_SHIFT)
+      ? (void **) ((LeafNode *) new_node)->child
+      : (void **) ((InternalNode *) new_node)->child;
+
+    while (cur_size < new_size) {
+      const TreeNode *old_node = (const TreeNode *) all[idx];
+      void *const *old_child = shift == INC_SHIFT(LEAF_NODE_SHIFT)
+        ? (void *const *) ((const LeafNode *) old_node)->child
+        : (void *const *) ((const InternalNode *) old_node)->child;
+
+      if (new_size - cur_size >= old_node->len - offset) {
+        memcpy(&new_child[cur_size], &old_child[offset],
+               (old_node->len - offset) * sizeof(void *));
+        cur_size += old_node->len - offset;
+        idx++;
+        offset = 0;
+      }
+      else {
+        memcpy(&new_child[cur_size], &old_child[offset],
+               (new_size - cur_size) * sizeof(void *));
+        offset += new_size - cur_size;
+        cur_size = new_size;
+      }
+    }
+    new_node->len = new_size;
+    if (shift != INC_SHIFT(LEAF_NODE_SHIFT)) {
+      transient_set_sizes((InternalNode *) new_node, DEC_SHIFT(shift), guid);
+    }
+    new_all[i] = (InternalNode *) new_node;
+  }
+}
+
+static InternalNode* transient_set_sizes(InternalNode *node, uint32_t shift,
+                                         Guid guid) {
+  RRBSizeTable *table = node->size_table;
+  if (table == NULL || table->guid != guid) {
+    table = transient_size_table_create(shift);
+    table->guid = guid;
+  }
+  RRBIndex sum = 0;
+  const uint32_t child_shift = DEC_SHIFT(shift);
+  for (uint32_t i = 0; i < node->len; i++) {
+    sum += size_sub_trie((TreeNode *) node->child[i], child_shift);
+    size_table_set(table, i, sum);
+  }
+  node->size_table = table;
+  return node;
+}
+
+/**
+ * Slices the subtree `node` of height `shift`, which contains `size` elements,
+ * down to the elements from index `from` to `to`. Only the leftmost and
+ * rightmost paths are visited: Nodes on them are trimmed in place if owned by
+ * the transient, and copied otherwise. If `collapse` is set, nodes left with a
+ * single child are replaced by that child. The height of the returned node is
+ * stored in `new_shift`.
+ */
+static TreeNode* transient_slice_rec(TreeNode *node, uint32_t shift,
+                                     RRBIndex size, RRBIndex from, RRBIndex to,
+                                     char collapse, uint32_t *new_shift,
+                                     Guid guid) {
+  *new_shift = shift;
+  if (from == 0 && to == size) {
+    return node;
+  }
+  if (shift == LEAF_NODE_SHIFT) {
+    LeafNode *leaf = (LeafNode *) node;
+    const uint32_t len = (uint32_t) (to - from);
+    if (leaf->guid == guid) {
+      memmove(leaf->child, &leaf->child[from], len * sizeof(void *));
+      // Clear the slots we no longer use, so the GC can reclaim their contents.
+      memset(&leaf->child[len], 0, (leaf->len - len) * sizeof(void *));
+    }
+    else {
+      LeafNode *copy = transient_leaf_node_create();
+      copy->guid = guid;
+      memcpy(copy->child, &leaf->child[from], len * sizeof(void *));
+      leaf = copy;
+    }
+    leaf->len = len;
+    return (TreeNode *) leaf;
+  }
+
+  InternalNode *internal = (InternalNode *) node;
+  RRBSizeTable *table = internal->size_table;
+  uint32_t first, last;
+  if (table == NULL) {
+    first = (uint32_t) (from >> shift);
+    last = (uint32_t) ((to - 1) >> shift);
+  }
+  else {
+    first = 0;
+    while (size_table_get(table, first) <= from) {
+      first++;
+    }
+    last = first;
+    while (size_table_get(table, last) < to) {
+      last++;
+    }
+  }
+#define CHILD_START(i) (table == NULL ? (RRBIndex) (i) << shift \
+                        : ((i) == 0 ? 0 : size_table_get(table, (i) - 1)))
+#define CHILD_END(i) (table == NULL ? MIN((RRBIndex) ((i) + 1) << shift, size) \
+                      : size_table_get(table, i))
+
+  const uint32_t child_shift = DEC_SHIFT(shift);
+  const RRBIndex first_start = CHILD_START(first);
+  const RRBIndex first_size = CHILD_END(first) - first_start;
+  if (first == last && collapse) {
+    return transient_slice_rec((TreeNode *) internal->child[first], child_shift,
+                               first_size, from - first_start, to - first_start,
+                               true, new_shift, guid);
+  }
+
+  uint32_t child_new_shift;
+  TreeNode *first_child =
+    transient_slice_rec((TreeNode *) internal->child[first], child_shift,
+                        first_size, from - first_start,
+                        first == last ? to - first_start : first_size,
+                        false, &child_new_shift, guid);
+  TreeNode *last_child = first_child;
+  if (first != last) {
+    const RRBIndex last_start = CHILD_START(last);
+    last_child =
+      transient_slice_rec((TreeNode *) internal->child[last], child_shift,
+                          CHILD_END(last) - last_start, 0, to - last_start,
+                          false, &child_new_shift, guid);
+  }
+
+  // A strict node stays strict if only its end is cut off. Otherwise, the new
+  // sizes are written over the old ones, which are read before they are
+  // overwritten.
+  const uint32_t len = last - first + 1;
+  RRBSizeTable *new_table = NULL;
+  if (table != NULL || from != 0) {
+    if (table != NULL && table->guid == guid) {
+      new_table = table;
+    }
+    else {
+      new_table = transient_size_table_create(shift);
+      new_table->guid = guid;
+    }
+    for (uint32_t i = 0; i < len; i++) {
+      size_table_set(new_table, i, MIN(CHILD_END(first + i), to) - from);
+    }
+  }
+#undef CHILD_START
+#undef CHILD_END
+
+  const uint32_t old_len = internal->len;
+  internal = ensure_internal_editable(internal, guid);
+  memmove(internal->child, &internal->child[first],
+          len * sizeof(InternalNode *));
+  memset(&internal->child[len], 0, (old_len - len) * sizeof(InternalNode *));
+  internal->child[0] = (InternalNode *) first_child;
+  internal->child[len - 1] = (InternalNode *) last_child;
+  internal->len = len;
+  internal->size_table = new_table;
+  return (TreeNode *) internal;
+}
+
+// Slices the trie and the tail directly, instead of slicing right and then
+// left. Only the nodes on the two edges of the slice are visited.
+TransientRRB* transient_rrb_slice(TransientRRB *trrb, RRBIndex from, RRBIndex to) {
+  check_transience(trrb);
+  TRANSIENT_SCOPE(trrb);
+  Guid guid = trrb->guid;
+  to = MIN(to, trrb->cnt);
+  from = MIN(from, to);
+
+  LeafNode *tail = trrb->tail;
+  const RRBIndex tail_offset = trrb->cnt - trrb->tail_len;
+
+  if (tail_offset <= from || from == to) {
+    // Slice is contained within the tail, or is empty
+    const uint32_t len = (uint32_t) (to - from);
+    if (len != 0) {
+      memmove(tail->child, &tail->child[from - tail_offset],
+              len * sizeof(void *));
+    }
+    memset(&tail->child[len], 0, (trrb->tail_len - len) * sizeof(void *));
+    tail->len = len;
+    trrb->tail_len = len;
+    trrb->cnt = len;
+    trrb->root = NULL;
+    trrb->shift = LEAF_NODE_SHIFT;
+    return trrb;
+  }
+  else if (tail_offset < to) {
+    // Cut the end off the tail, and the start off the trie
+    const uint32_t tail_len = (uint32_t) (to - tail_offset);
+    memset(&tail->child[tail_len], 0,
+           (trrb->tail_len - tail_len) * sizeof(void *));
+    tail->len = tail_len;
+    trrb->tail_len = tail_len;
+    trrb->root = transient_slice_rec(trrb->root, RRB_SHIFT(trrb), tail_offset,
+                                     from, tail_offset, true,
+                                     &RRB_SHIFT(trrb), guid);
+    trrb->cnt = to - from;
+  }
+  else {
+    // The slice ends within the trie, so the rightmost leaf becomes the tail
+    trrb->root = transient_slice_rec(trrb->root, RRB_SHIFT(trrb), tail_offset,
+                                     from, to, true, &RRB_SHIFT(trrb), guid);
+    trrb->cnt = to - from;
+    transient_promote_rightmost_leaf(trrb);
+    tail = trrb->tail;
+  }
+
+  // Like slice_left, redistribute the tail into a root leaf that isn't full.
+  if (RRB_SHIFT(trrb) == LEAF_NODE_SHIFT && trrb->root != NULL) {
+    LeafNode *root = (LeafNode *) trrb->root;
+    if (trrb->cnt <= RRB_LEAF_BRANCHING) {
+      // Everything fits in the tail
+      memmove(&tail->child[root->len], tail->child,
+              trrb->tail_len * sizeof(void *));
+      memcpy(tail->child, root->child, root->len * sizeof(void *));
+      tail->len = trrb->cnt;
+      trrb->tail_len = trrb->cnt;
+      trrb->root = NULL;
+    }
+    else if (root->len < RRB_LEAF_BRANCHING) {
+      // Fill up the root leaf with the start of the tail
+      root = ensure_leaf_editable(root, guid);
+      const uint32_t tail_cut = RRB_LEAF_BRANCHING - root->len;
+      const uint32_t tail_len = trrb->tail_len - tail_cut;
+      memcpy(&root->child[root->len], tail->child, tail_cut * sizeof(void *));
+      memmove(tail->child, &tail->child[tail_cut], tail_len * sizeof(void *));
+      memset(&tail->child[tail_len], 0, tail_cut * sizeof(void *));
+      root->len = RRB_LEAF_BRANCHING;
+      tail->len = tail_len;
+      trrb->tail_len = tail_len;
+      trrb->root = (TreeNode *) root;
+    }
+  }
   return trrb;
 }
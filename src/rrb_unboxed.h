@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2013-2014 Jean Niklas L'orange. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef RRB_UNBOXED_H
+#define RRB_UNBOXED_H
+
+// An RRBU64 is an RRB-tree with unboxed leaves, where every element takes up
+// U64_SLOTS consecutive slots: One on 64-bit platforms and two on 32-bit ones.
+// As slots are indexed like any other element, a value may straddle two leaves.
+#define U64_SLOTS (sizeof(uint64_t) / sizeof(void *))
+
+typedef union {
+  uint64_t value;
+  const void *slot[U64_SLOTS];
+} U64Slots;
+
+const RRBU64* rrb_u64_create() {
+  return (const RRBU64 *) rrb_create();
+}
+
+void rrb_u64_release(const RRBU64 *rrb) {
+  rrb_release((const RRB *) rrb);
+}
+
+RRBIndex rrb_u64_count(const RRBU64 *rrb) {
+  return rrb_count((const RRB *) rrb) / U64_SLOTS;
+}
+
+uint64_t rrb_u64_nth(const RRBU64 *rrb, RRBIndex index) {
+  U64Slots elt;
+  for (uint32_t i = 0; i < U64_SLOTS; i++) {
+    elt.slot[i] = rrb_nth((const RRB *) rrb, index * U64_SLOTS + i);
+  }
+  return elt.value;
+}
+
+const RRBU64* rrb_u64_push(const RRBU64 *rrb, uint64_t elt) {
+  UNBOXED_SCOPE();
+  const U64Slots slots = {.value = elt};
+  if (U64_SLOTS == 1) {
+    return (const RRBU64 *) rrb_push((const RRB *) rrb, slots.slot[0]);
+  }
+  return (const RRBU64 *) rrb_push_many((const RRB *) rrb, slots.slot,
+                                        U64_SLOTS);
+}
+
+const RRBU64* rrb_u64_update(const RRBU64 *rrb, RRBIndex index, uint64_t elt) {
+  // Checked up front, as the later slots would be updated in NULL otherwise.
+  if (index >= rrb_u64_count(rrb)) {
+    return NULL;
+  }
+  UNBOXED_SCOPE();
+  const U64Slots slots = {.value = elt};
+  const RRB *updated = rrb_update((const RRB *) rrb, index * U64_SLOTS,
+                                  slots.slot[0]);
+  for (uint32_t i = 1; i < U64_SLOTS; i++) {
+    const RRB *previous = updated;
+    updated = rrb_update(previous, index * U64_SLOTS + i, slots.slot[i]);
+    rrb_release(previous);
+  }
+  return (const RRBU64 *) updated;
+}
+
+const RRBU64* rrb_u64_concat(const RRBU64 *left, const RRBU64 *right) {
+  UNBOXED_SCOPE();
+  return (const RRBU64 *) rrb_concat((const RRB *) left, (const RRB *) right);
+}
+
+const RRBU64* rrb_u64_slice(const RRBU64 *rrb, RRBIndex from, RRBIndex to) {
+  UNBOXED_SCOPE();
+  return (const RRBU64 *) rrb_slice((const RRB *) rrb, from * U64_SLOTS,
+                                    to * U64_SLOTS);
+}
+
+#endif
@@ -0,0 +1,1008 @@
+/*
+ * Copyright (c) 2013-2014 Jean Niklas L'orange. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef RRB_VECTOR_HPP
+#define RRB_VECTOR_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace rrb {
+
+/**
+ * A persistent vector of T, implementing the RRB-tree algorithms of librrb as
+ * templates. Elements are stored by value in the leaves, and the branching
+ * factor is 2^Bits, regardless of the one librrb is configured with, so that
+ * containers with different branching factors can live in the same program.
+ *
+ * Operations never modify a vector, but return a new one sharing most of its
+ * nodes with the original. Nodes are reference counted, and freed along with
+ * the last vector referring to them.
+ */
+template <typename T, unsigned Bits = 5>
+class vector {
+  static_assert(Bits >= 1 && Bits <= 12, "Bits must be between 1 and 12.");
+  static_assert(alignof(T) <= alignof(std::max_align_t),
+                "Over-aligned element types are not supported.");
+
+public:
+  typedef T value_type;
+  typedef uint32_t size_type;
+  typedef std::ptrdiff_t difference_type;
+  typedef const T& reference;
+  typedef const T& const_reference;
+  class const_iterator;
+  typedef const_iterator iterator;
+
+  static constexpr uint32_t bits = Bits;
+  static constexpr uint32_t branching = 1u << Bits;
+  static constexpr uint32_t mask = branching - 1;
+  // See RRB_INVARIANT and RRB_EXTRAS in rrb.h.
+  static constexpr uint32_t invariant = 1;
+  static constexpr uint32_t extras = 2;
+
+private:
+  // The height of the highest possible root, in levels above the leaves: The
+  // same as RRB_MAX_HEIGHT - 1 for librrb with this branching factor.
+  static constexpr uint32_t max_height = 31 / Bits;
+
+  struct node {
+    std::atomic<uint32_t> refs;
+    uint32_t len;
+  };
+
+  // Internal nodes are followed by their children, and then by their size
+  // table, if they have one. Leaf nodes are plain nodes followed by their
+  // elements.
+  struct internal_node : node {
+    // Cumulative sizes of the children, or null if every child but the last
+    // is full.
+    uint32_t *sizes;
+  };
+
+  static constexpr std::size_t elems_offset =
+    (sizeof(node) + alignof(T) - 1) / alignof(T) * alignof(T);
+
+  // An owned reference to a node of height `shift`, released when destroyed.
+  class node_ref {
+  public:
+    node_ref() noexcept : ptr_(nullptr), shift_(0) {}
+    node_ref(node *ptr, uint32_t shift) noexcept : ptr_(ptr), shift_(shift) {}
+    node_ref(node_ref &&other) noexcept : ptr_(other.ptr_),
+                                          shift_(other.shift_) {
+      other.ptr_ = nullptr;
+    }
+    node_ref& operator=(node_ref &&other) noexcept {
+      std::swap(ptr_, other.ptr_);
+      std::swap(shift_, other.shift_);
+      return *this;
+    }
+    node_ref(const node_ref &) = delete;
+    node_ref& operator=(const node_ref &) = delete;
+    ~node_ref() {
+      if (ptr_ != nullptr) {
+        release(ptr_, shift_);
+      }
+    }
+
+    node* get() const noexcept { return ptr_; }
+    node* operator->() const noexcept { return ptr_; }
+    uint32_t shift() const noexcept { return shift_; }
+    explicit operator bool() const noexcept { return ptr_ != nullptr; }
+
+    node* disown() noexcept {
+      node *ptr = ptr_;
+      ptr_ = nullptr;
+      return ptr;
+    }
+
+  private:
+    node *ptr_;
+    uint32_t shift_;
+  };
+
+  uint32_t cnt_;
+  uint32_t shift_;
+  uint32_t tail_len_;
+  node *tail_;
+  node *root_;
+
+public:
+  class const_iterator {
+  public:
+    typedef std::random_access_iterator_tag iterator_category;
+    typedef T value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const T* pointer;
+    typedef const T& reference;
+
+    const_iterator() noexcept : vec_(nullptr), index_(0), leaf_(nullptr),
+                                leaf_start_(0), leaf_len_(0) {}
+
+    // The leaf holding the current element is cached, so that only moving to
+    // another leaf has to descend the tree.
+    reference operator*() const {
+      if (index_ - leaf_start_ >= leaf_len_) {
+        leaf_ = vec_->leaf_for(index_, &leaf_start_, &leaf_len_);
+      }
+      return leaf_[index_ - leaf_start_];
+    }
+    pointer operator->() const { return &**this; }
+    reference operator[](difference_type n) const { return *(*this + n); }
+
+    const_iterator& operator++() noexcept { index_++; return *this; }
+    const_iterator& operator--() noexcept { index_--; return *this; }
+    const_iterator operator++(int) noexcept {
+      const_iterator old = *this;
+      index_++;
+      return old;
+    }
+    const_iterator operator--(int) noexcept {
+      const_iterator old = *this;
+      index_--;
+      return old;
+    }
+    const_iterator& operator+=(difference_type n) noexcept {
+      index_ = static_cast<uint32_t>(index_ + n);
+      return *this;
+    }
+    const_iterator& operator-=(difference_type n) noexcept {
+      return *this += -n;
+    }
+    friend const_iterator operator+(const_iterator it, difference_type n) {
+      return it += n;
+    }
+    friend const_iterator operator+(difference_type n, const_iterator it) {
+      return it += n;
+    }
+    friend const_iterator operator-(const_iterator it, difference_type n) {
+      return it -= n;
+    }
+    friend difference_type operator-(const const_iterator &a,
+                                     const const_iterator &b) {
+      return static_cast<difference_type>(a.index_)
+        - static_cast<difference_type>(b.index_);
+    }
+    friend bool operator==(const const_iterator &a, const const_iterator &b) {
+      return a.index_ == b.index_;
+    }
+    friend bool operator!=(const const_iterator &a, const const_iterator &b) {
+      return a.index_ != b.index_;
+    }
+    friend bool operator<(const const_iterator &a, const const_iterator &b) {
+      return a.index_ < b.index_;
+    }
+    friend bool operator>(const const_iterator &a, const const_iterator &b) {
+      return a.index_ > b.index_;
+    }
+    friend bool operator<=(const const_iterator &a, const const_iterator &b) {
+      return a.index_ <= b.index_;
+    }
+    friend bool operator>=(const const_iterator &a, const const_iterator &b) {
+      return a.index_ >= b.index_;
+    }
+
+  private:
+    friend class vector;
+    const_iterator(const vector *vec, uint32_t index) noexcept
+      : vec_(vec), index_(index), leaf_(nullptr), leaf_start_(0),
+        leaf_len_(0) {}
+
+    const vector *vec_;
+    uint32_t index_;
+    mutable const T *leaf_;
+    mutable uint32_t leaf_start_;
+    mutable uint32_t leaf_len_;
+  };
+
+  vector() noexcept : cnt_(0), shift_(0), tail_len_(0), tail_(nullptr),
+                      root_(nullptr) {}
+
+  vector(std::initializer_list<T> elems) : vector(elems.begin(), elems.end()) {}
+
+  /**
+   * Fills full leaves from the range, pushing each one down as the next fills
+   * up, like rrb_push_many.
+   */
+  template <typename InputIt,
+            typename = typename std::iterator_traits<InputIt>::value_type>
+  vector(InputIt first, InputIt last) : vector() {
+    while (first != last) {
+      node_ref leaf = leaf_create(branching);
+      while (first != last && leaf->len < branching) {
+        leaf_append(leaf, &*first, 1);
+        ++first;
+      }
+      push_leaf(std::move(leaf));
+    }
+  }
+
+  vector(const vector &other) noexcept
+    : cnt_(other.cnt_), shift_(other.shift_), tail_len_(other.tail_len_),
+      tail_(retain(other.tail_)), root_(retain(other.root_)) {}
+
+  vector(vector &&other) noexcept : vector() {
+    swap(other);
+  }
+
+  vector& operator=(vector other) noexcept {
+    swap(other);
+    return *this;
+  }
+
+  ~vector() {
+    if (root_ != nullptr) {
+      release(root_, shift_);
+    }
+    if (tail_ != nullptr) {
+      release(tail_, 0);
+    }
+  }
+
+  void swap(vector &other) noexcept {
+    std::swap(cnt_, other.cnt_);
+    std::swap(shift_, other.shift_);
+    std::swap(tail_len_, other.tail_len_);
+    std::swap(tail_, other.tail_);
+    std::swap(root_, other.root_);
+  }
+
+  size_type size() const noexcept { return cnt_; }
+  bool empty() const noexcept { return cnt_ == 0; }
+
+  const_iterator begin() const noexcept { return const_iterator(this, 0); }
+  const_iterator end() const noexcept { return const_iterator(this, cnt_); }
+  const_iterator cbegin() const noexcept { return begin(); }
+  const_iterator cend() const noexcept { return end(); }
+
+  /**
+   * Returns the element at `index`, which must be in bounds. The descent is
+   * unrolled for every height, so lookups compile down to a handful of loads.
+   */
+  const T& operator[](uint32_t index) const {
+    const uint32_t tail_offset = cnt_ - tail_len_;
+    if (index >= tail_offset) {
+      return elems(tail_)[index - tail_offset];
+    }
+    const node *leaf = descend_from(root_, shift_ / bits, &index,
+                                    std::integral_constant<uint32_t, 0>());
+    return elems(leaf)[index];
+  }
+
+  const T& at(uint32_t index) const {
+    if (index >= cnt_) {
+      throw std::out_of_range("rrb::vector::at");
+    }
+    return (*this)[index];
+  }
+
+  const T& front() const { return (*this)[0]; }
+  const T& back() const { return elems(tail_)[tail_len_ - 1]; }
+
+  vector push_back(const T &elt) const {
+    if (tail_len_ < branching) {
+      node_ref tail = leaf_create(tail_len_ + 1);
+      leaf_append(tail, elems(tail_), tail_len_);
+      leaf_append(tail, &elt, 1);
+      return vector(cnt_ + 1, root_ref(), std::move(tail));
+    }
+    node_ref tail = leaf_create(1);
+    leaf_append(tail, &elt, 1);
+    return vector(cnt_ + 1, trie_push(tail_), std::move(tail));
+  }
+
+  vector pop_back() const {
+    return slice(0, cnt_ - 1);
+  }
+
+  /**
+   * Returns a vector where the element at `index`, which must be in bounds, is
+   * replaced by `elt`. Only the path down to it is copied.
+   */
+  vector set(uint32_t index, const T &elt) const {
+    const uint32_t tail_offset = cnt_ - tail_len_;
+    if (index >= tail_offset) {
+      return vector(cnt_, root_ref(),
+                    leaf_set(tail_, index - tail_offset, elt));
+    }
+    return vector(cnt_, update(root_, shift_, tail_offset, index, elt),
+                  node_ref(retain(tail_), 0));
+  }
+
+  vector concat(const vector &right) const {
+    if (cnt_ == 0) {
+      return right;
+    }
+    if (right.cnt_ == 0) {
+      return *this;
+    }
+    const uint32_t cnt = cnt_ + right.cnt_;
+    if (right.root_ == nullptr) {
+      // Merge the tails, pushing down the left one once it is full.
+      if (tail_len_ + right.tail_len_ <= branching) {
+        node_ref tail = leaf_create(tail_len_ + right.tail_len_);
+        leaf_append(tail, elems(tail_), tail_len_);
+        leaf_append(tail, elems(right.tail_), right.tail_len_);
+        return vector(cnt, root_ref(), std::move(tail));
+      }
+      const uint32_t right_cut = branching - tail_len_;
+      node_ref full;
+      if (right_cut != 0) {
+        full = leaf_create(branching);
+        leaf_append(full, elems(tail_), tail_len_);
+        leaf_append(full, elems(right.tail_), right_cut);
+      }
+      node_ref tail = leaf_create(right.tail_len_ - right_cut);
+      leaf_append(tail, elems(right.tail_) + right_cut,
+                  right.tail_len_ - right_cut);
+      return vector(cnt, trie_push(full ? full.get() : tail_),
+                    std::move(tail));
+    }
+    node_ref left_root = trie_push(tail_);
+    node_ref root = concat_sub_tree(left_root.get(), left_root.shift(),
+                                    right.root_, right.shift_, true);
+    return vector(cnt, collapse(std::move(root)),
+                  node_ref(retain(right.tail_), 0));
+  }
+
+  /**
+   * Returns the elements from `from` to `to` as a new vector. The range is
+   * clipped to the size of the vector. Only the nodes along the edges of the
+   * range are copied.
+   */
+  vector slice(uint32_t from, uint32_t to) const {
+    to = to < cnt_ ? to : cnt_;
+    if (from >= to) {
+      return vector();
+    }
+    if (from == 0 && to == cnt_) {
+      return *this;
+    }
+    const uint32_t tail_offset = cnt_ - tail_len_;
+    node_ref root;
+    node_ref tail;
+    if (to > tail_offset) {
+      const uint32_t tail_from = from > tail_offset ? from - tail_offset : 0;
+      tail = leaf_create(to - tail_offset - tail_from);
+      leaf_append(tail, elems(tail_) + tail_from, to - tail_offset - tail_from);
+      if (from < tail_offset) {
+        root = slice_trie(root_, shift_, tail_offset, from, tail_offset);
+      }
+    }
+    else {
+      // The last leaf of the sliced trie becomes the tail.
+      node_ref trie = slice_trie(root_, shift_, tail_offset, from, to);
+      root = split_last_leaf(trie.get(), trie.shift(), to - from, &tail);
+    }
+    return vector(to - from, collapse(std::move(root)), std::move(tail));
+  }
+
+private:
+  vector(uint32_t cnt, node_ref root, node_ref tail) noexcept
+    : cnt_(cnt), shift_(root ? root.shift() : 0), tail_len_(tail->len),
+      tail_(tail.disown()), root_(root.disown()) {}
+
+  static T* elems(node *leaf) noexcept {
+    return reinterpret_cast<T *>(reinterpret_cast<char *>(leaf) + elems_offset);
+  }
+
+  static const T* elems(const node *leaf) noexcept {
+    return reinterpret_cast<const T *>(reinterpret_cast<const char *>(leaf)
+                                       + elems_offset);
+  }
+
+  static const internal_node* as_internal(const node *n) noexcept {
+    return static_cast<const internal_node *>(n);
+  }
+
+  static node* const* children(const node *n) noexcept {
+    return reinterpret_cast<node *const *>(as_internal(n) + 1);
+  }
+
+  static node* retain(node *n) noexcept {
+    if (n != nullptr) {
+      n->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+    return n;
+  }
+
+  static void release(node *n, uint32_t shift) noexcept {
+    if (n->refs.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+      return;
+    }
+    if (shift == 0) {
+      T *elts = elems(n);
+      for (uint32_t i = 0; i < n->len; i++) {
+        elts[i].~T();
+      }
+      n->~node();
+      ::operator delete(n);
+    }
+    else {
+      internal_node *in = static_cast<internal_node *>(n);
+      for (uint32_t i = 0; i < in->len; i++) {
+        release(children(in)[i], shift - bits);
+      }
+      in->~internal_node();
+      ::operator delete(in);
+    }
+  }
+
+  node_ref root_ref() const noexcept {
+    return node_ref(retain(root_), shift_);
+  }
+
+  /**
+   * Creates an empty leaf with room for `cap` elements, which are added with
+   * leaf_append. If copying an element throws, the leaf is released along with
+   * the elements copied so far.
+   */
+  static node_ref leaf_create(uint32_t cap) {
+    node *leaf = new (::operator new(elems_offset + cap * sizeof(T))) node;
+    leaf->refs.store(1, std::memory_order_relaxed);
+    leaf->len = 0;
+    return node_ref(leaf, 0);
+  }
+
+  static void leaf_append(const node_ref &leaf, const T *from, uint32_t n) {
+    T *to = elems(leaf.get());
+    for (uint32_t i = 0; i < n; i++) {
+      new (&to[leaf->len]) T(from[i]);
+      leaf->len++;
+    }
+  }
+
+  static node_ref leaf_set(const node *leaf, uint32_t pos, const T &elt) {
+    node_ref copy = leaf_create(leaf->len);
+    leaf_append(copy, elems(leaf), pos);
+    leaf_append(copy, &elt, 1);
+    leaf_append(copy, elems(leaf) + pos + 1, leaf->len - pos - 1);
+    return copy;
+  }
+
+  static internal_node* internal_alloc(uint32_t len, bool relaxed) {
+    const std::size_t children_size = len * sizeof(node *);
+    void *mem = ::operator new(sizeof(internal_node) + children_size
+                               + (relaxed ? len * sizeof(uint32_t) : 0));
+    internal_node *in = new (mem) internal_node;
+    in->refs.store(1, std::memory_order_relaxed);
+    in->len = len;
+    in->sizes = relaxed ? reinterpret_cast<uint32_t *>(
+      reinterpret_cast<char *>(in + 1) + children_size) : nullptr;
+    return in;
+  }
+
+  static node** mutable_children(internal_node *in) noexcept {
+    return reinterpret_cast<node **>(in + 1);
+  }
+
+  static uint32_t subtree_size(const node *n, uint32_t shift) noexcept {
+    if (shift == 0) {
+      return n->len;
+    }
+    const internal_node *in = as_internal(n);
+    if (in->sizes != nullptr) {
+      return in->sizes[in->len - 1];
+    }
+    return ((in->len - 1) << shift)
+      + subtree_size(children(in)[in->len - 1], shift - bits);
+  }
+
+  static uint32_t child_start(const internal_node *in, uint32_t shift,
+                              uint32_t i) noexcept {
+    if (i == 0) {
+      return 0;
+    }
+    return in->sizes != nullptr ? in->sizes[i - 1] : i << shift;
+  }
+
+  // The end of child `i` of `in`, a node holding `size` elements.
+  static uint32_t child_end(const internal_node *in, uint32_t shift,
+                            uint32_t size, uint32_t i) noexcept {
+    if (in->sizes != nullptr) {
+      return in->sizes[i];
+    }
+    return i == in->len - 1 ? size : (i + 1) << shift;
+  }
+
+  /**
+   * Returns the index of the child of `in` holding element `*index`, and makes
+   * `*index` relative to that child. Like sized_pos, the scan of a size table
+   * starts where the child would be if all children were full.
+   */
+  static uint32_t child_pos(const internal_node *in, uint32_t shift,
+                            uint32_t *index) noexcept {
+    uint32_t is = *index >> shift;
+    if (in->sizes == nullptr) {
+      *index -= is << shift;
+      return is;
+    }
+    while (in->sizes[is] <= *index) {
+      is++;
+    }
+    if (is != 0) {
+      *index -= in->sizes[is - 1];
+    }
+    return is;
+  }
+
+  template <uint32_t Height>
+  static const node* descend(const node *n, uint32_t *index,
+                             std::integral_constant<uint32_t, Height>) noexcept {
+    const uint32_t is = child_pos(as_internal(n), Height * bits, index);
+    return descend(children(n)[is], index,
+                   std::integral_constant<uint32_t, Height - 1>());
+  }
+
+  static const node* descend(const node *n, uint32_t *,
+                             std::integral_constant<uint32_t, 0>) noexcept {
+    return n;
+  }
+
+  // Picks the unrolled descent for a root of height `height`.
+  template <uint32_t Height>
+  static const node* descend_from(const node *root, uint32_t height,
+                                  uint32_t *index,
+                                  std::integral_constant<uint32_t, Height> h)
+    noexcept {
+    if (height == Height) {
+      return descend(root, index, h);
+    }
+    return descend_from(root, height, index,
+                        std::integral_constant<uint32_t, Height + 1>());
+  }
+
+  static const node* descend_from(const node *, uint32_t, uint32_t *,
+                                  std::integral_constant<uint32_t,
+                                                         max_height + 1>)
+    noexcept {
+    return nullptr;
+  }
+
+  const T* leaf_for(uint32_t index, uint32_t *leaf_start,
+                    uint32_t *leaf_len) const noexcept {
+    const uint32_t tail_offset = cnt_ - tail_len_;
+    if (index >= tail_offset) {
+      *leaf_start = tail_offset;
+      *leaf_len = tail_len_;
+      return elems(tail_);
+    }
+    uint32_t pos = index;
+    const node *leaf = descend_from(root_, shift_ / bits, &pos,
+                                    std::integral_constant<uint32_t, 0>());
+    *leaf_start = index - pos;
+    *leaf_len = leaf->len;
+    return elems(leaf);
+  }
+
+  /**
+   * Creates a node of height `shift` above the `len` nodes in `nodes`. It only
+   * gets a size table if a child other than the last isn't full.
+   */
+  static node_ref internal_create(node *const *nodes, uint32_t len,
+                                  uint32_t shift) {
+    uint32_t sizes[branching];
+    bool dense = true;
+    uint32_t total = 0;
+    for (uint32_t i = 0; i < len; i++) {
+      const uint32_t size = subtree_size(nodes[i], shift - bits);
+      dense = dense && (i == len - 1 || size == (1u << shift));
+      total += size;
+      sizes[i] = total;
+    }
+    internal_node *in = internal_alloc(len, !dense);
+    for (uint32_t i = 0; i < len; i++) {
+      mutable_children(in)[i] = retain(nodes[i]);
+      if (!dense) {
+        in->sizes[i] = sizes[i];
+      }
+    }
+    return node_ref(in, shift);
+  }
+
+  /**
+   * Returns a copy of `in`, a node of height `shift` holding `size` elements,
+   * where child `i` is replaced by `child`, which holds `child_size` elements.
+   * If `i` is the length of `in`, `child` is appended instead.
+   */
+  static node_ref internal_set(const internal_node *in, uint32_t shift,
+                               uint32_t size, uint32_t i, node *child,
+                               uint32_t child_size) {
+    const bool append = i == in->len;
+    const uint32_t len = append ? in->len + 1 : in->len;
+    const uint32_t start = append ? size : child_start(in, shift, i);
+    const uint32_t old_end = append ? size : child_end(in, shift, size, i);
+    // Without a size table, every child but the last must remain full.
+    const bool dense = in->sizes == nullptr
+      && (append ? size == (in->len << shift)
+                 : i == in->len - 1 || child_size == (1u << shift));
+
+    internal_node *copy = internal_alloc(len, !dense);
+    for (uint32_t j = 0; j < len; j++) {
+      mutable_children(copy)[j] = retain(j == i ? child : children(in)[j]);
+    }
+    if (!dense) {
+      for (uint32_t j = 0; j < len; j++) {
+        if (j < i) {
+          copy->sizes[j] = child_end(in, shift, size, j);
+        }
+        else if (j == i) {
+          copy->sizes[j] = start + child_size;
+        }
+        else {
+          copy->sizes[j] = child_end(in, shift, size, j) - old_end
+            + start + child_size;
+        }
+      }
+    }
+    return node_ref(copy, shift);
+  }
+
+  // A path of single-child nodes from height `shift` down to `leaf`.
+  static node_ref new_path(node *leaf, uint32_t shift) {
+    if (shift == 0) {
+      return node_ref(retain(leaf), 0);
+    }
+    node_ref below = new_path(leaf, shift - bits);
+    node *child = below.get();
+    return internal_create(&child, 1, shift);
+  }
+
+  /**
+   * Appends `leaf` after the last leaf of `n`, a node of height `shift` holding
+   * `size` elements. Returns an empty reference if `n` is full.
+   */
+  static node_ref append_leaf(const node *n, uint32_t shift, uint32_t size,
+                              node *leaf) {
+    const internal_node *in = as_internal(n);
+    const uint32_t last = in->len - 1;
+    if (shift > bits) {
+      const uint32_t last_size = size - child_start(in, shift, last);
+      node_ref child = append_leaf(children(in)[last], shift - bits, last_size,
+                                   leaf);
+      if (child) {
+        return internal_set(in, shift, size, last, child.get(),
+                            last_size + leaf->len);
+      }
+    }
+    if (in->len == branching) {
+      return node_ref();
+    }
+    node_ref path = new_path(leaf, shift - bits);
+    return internal_set(in, shift, size, in->len, path.get(), leaf->len);
+  }
+
+  // The trie of this vector with `leaf` appended, like push_down_tail.
+  node_ref trie_push(node *leaf) const {
+    if (root_ == nullptr) {
+      return node_ref(retain(leaf), 0);
+    }
+    const uint32_t size = cnt_ - tail_len_;
+    if (shift_ > 0) {
+      node_ref root = append_leaf(root_, shift_, size, leaf);
+      if (root) {
+        return root;
+      }
+    }
+    node_ref path = new_path(leaf, shift_);
+    node *const nodes[2] = {root_, path.get()};
+    return internal_create(nodes, 2, shift_ + bits);
+  }
+
+  // Makes a full leaf the tail, pushing the current one down.
+  void push_leaf(node_ref leaf) {
+    if (tail_ != nullptr) {
+      node_ref root = trie_push(tail_);
+      if (root_ != nullptr) {
+        release(root_, shift_);
+      }
+      shift_ = root.shift();
+      root_ = root.disown();
+      release(tail_, 0);
+    }
+    cnt_ += leaf->len;
+    tail_len_ = leaf->len;
+    tail_ = leaf.disown();
+  }
+
+  static node_ref update(const node *n, uint32_t shift, uint32_t size,
+                         uint32_t index, const T &elt) {
+    if (shift == 0) {
+      return leaf_set(n, index, elt);
+    }
+    const internal_node *in = as_internal(n);
+    const uint32_t is = child_pos(in, shift, &index);
+    const uint32_t start = child_start(in, shift, is);
+    const uint32_t child_size = child_end(in, shift, size, is) - start;
+    node_ref child = update(children(in)[is], shift - bits, child_size, index,
+                            elt);
+    return internal_set(in, shift, size, is, child.get(), child_size);
+  }
+
+  // Removes the root's parents with a single child.
+  static node_ref collapse(node_ref root) {
+    while (root && root.shift() > 0 && root->len == 1) {
+      root = node_ref(retain(children(root.get())[0]), root.shift() - bits);
+    }
+    return root;
+  }
+
+  /**
+   * Returns the elements of `n` from `from` to `to` as a node of the same
+   * height. The range must be nonempty. Children entirely within the range are
+   * shared.
+   */
+  static node_ref slice_trie(node *n, uint32_t shift, uint32_t size,
+                             uint32_t from, uint32_t to) {
+    if (from == 0 && to == size) {
+      return node_ref(retain(n), shift);
+    }
+    if (shift == 0) {
+      node_ref leaf = leaf_create(to - from);
+      leaf_append(leaf, elems(n) + from, to - from);
+      return leaf;
+    }
+    const internal_node *in = as_internal(n);
+    uint32_t first_index = from;
+    uint32_t last_index = to - 1;
+    const uint32_t first = child_pos(in, shift, &first_index);
+    const uint32_t last = child_pos(in, shift, &last_index);
+
+    node_ref parts[branching];
+    node *nodes[branching];
+    for (uint32_t i = first; i <= last; i++) {
+      const uint32_t start = child_start(in, shift, i);
+      const uint32_t end = child_end(in, shift, size, i);
+      parts[i - first] = slice_trie(children(in)[i], shift - bits, end - start,
+                                    from > start ? from - start : 0,
+                                    (to < end ? to : end) - start);
+      nodes[i - first] = parts[i - first].get();
+    }
+    return internal_create(nodes, last - first + 1, shift);
+  }
+
+  /**
+   * Stores the last leaf of `n`, a node of height `shift` holding `size`
+   * elements, into `*leaf`, and returns the rest of `n`. Returns an empty
+   * reference if there is nothing left.
+   */
+  static node_ref split_last_leaf(node *n, uint32_t shift, uint32_t size,
+                                  node_ref *leaf) {
+    if (shift == 0) {
+      *leaf = node_ref(retain(n), 0);
+      return node_ref();
+    }
+    const internal_node *in = as_internal(n);
+    const uint32_t last = in->len - 1;
+    node_ref rest = split_last_leaf(children(in)[last], shift - bits,
+                                    size - child_start(in, shift, last), leaf);
+    if (!rest && last == 0) {
+      return node_ref();
+    }
+    node *nodes[branching];
+    for (uint32_t i = 0; i < last; i++) {
+      nodes[i] = children(in)[i];
+    }
+    nodes[last] = rest.get();
+    return internal_create(nodes, rest ? last + 1 : last, shift);
+  }
+
+  static node_ref concat_sub_tree(node *left, uint32_t left_shift,
+                                  node *right, uint32_t right_shift,
+                                  bool is_top) {
+    if (left_shift > right_shift) {
+      const internal_node *left_internal = as_internal(left);
+      node_ref centre = concat_sub_tree(children(left)[left_internal->len - 1],
+                                        left_shift - bits, right, right_shift,
+                                        false);
+      return rebalance(left_internal, centre.get(), nullptr, left_shift,
+                       is_top);
+    }
+    if (left_shift < right_shift) {
+      node_ref centre = concat_sub_tree(left, left_shift, children(right)[0],
+                                        right_shift - bits, false);
+      return rebalance(nullptr, centre.get(), as_internal(right), right_shift,
+                       is_top);
+    }
+    if (left_shift == 0) {
+      // As in rrb.c, leaves are only merged at the top.
+      if (is_top && left->len + right->len <= branching) {
+        node_ref merged = leaf_create(left->len + right->len);
+        leaf_append(merged, elems(left), left->len);
+        leaf_append(merged, elems(right), right->len);
+        node *child = merged.get();
+        return internal_create(&child, 1, bits);
+      }
+      node *const nodes[2] = {left, right};
+      return internal_create(nodes, 2, bits);
+    }
+    const internal_node *left_internal = as_internal(left);
+    node_ref centre = concat_sub_tree(children(left)[left_internal->len - 1],
+                                      left_shift - bits, children(right)[0],
+                                      right_shift - bits, false);
+    return rebalance(left_internal, centre.get(), as_internal(right),
+                     left_shift, is_top);
+  }
+
+  /**
+   * Merges the children of `left` (but its last), `centre` and `right` (but its
+   * first), all of height `shift`, and redistributes their children according
+   * to the concat plan. Returns a node one level above `shift`, unless at the
+   * top, where the merged node itself is returned if it fits.
+   */
+  static node_ref rebalance(const internal_node *left, const node *centre,
+                            const internal_node *right, uint32_t shift,
+                            bool is_top) {
+    node *all[2 * branching];
+    uint32_t len = 0;
+    if (left != nullptr) {
+      for (uint32_t i = 0; i + 1 < left->len; i++) {
+        all[len++] = children(left)[i];
+      }
+    }
+    for (uint32_t i = 0; i < centre->len; i++) {
+      all[len++] = children(centre)[i];
+    }
+    if (right != nullptr) {
+      for (uint32_t i = 1; i < right->len; i++) {
+        all[len++] = children(right)[i];
+      }
+    }
+
+    uint32_t plan[2 * branching];
+    const uint32_t plan_len = concat_plan(all, len, plan);
+    node_ref parts[2 * branching];
+    node *nodes[2 * branching];
+    execute_concat_plan(all, plan, plan_len, shift, parts);
+    for (uint32_t i = 0; i < plan_len; i++) {
+      nodes[i] = parts[i].get();
+    }
+
+    if (plan_len <= branching) {
+      node_ref merged = internal_create(nodes, plan_len, shift);
+      if (is_top) {
+        return merged;
+      }
+      node *child = merged.get();
+      return internal_create(&child, 1, shift + bits);
+    }
+    node_ref new_left = internal_create(nodes, branching, shift);
+    node_ref new_right = internal_create(nodes + branching,
+                                         plan_len - branching, shift);
+    node *const halves[2] = {new_left.get(), new_right.get()};
+    return internal_create(halves, 2, shift + bits);
+  }
+
+  // See create_concat_plan in rrb.c.
+  static uint32_t concat_plan(node *const *nodes, uint32_t len,
+                              uint32_t *node_count) noexcept {
+    uint32_t total_nodes = 0;
+    for (uint32_t i = 0; i < len; i++) {
+      node_count[i] = nodes[i]->len;
+      total_nodes += node_count[i];
+    }
+    const uint32_t optimal_slots = (total_nodes - 1) / branching + 1;
+
+    uint32_t shuffled_len = len;
+    uint32_t i = 0;
+    while (optimal_slots + extras < shuffled_len) {
+      // Skip over all nodes satisfying the invariant.
+      while (node_count[i] > branching - invariant) {
+        i++;
+      }
+      // Found a short node, so redistribute it over the next nodes.
+      uint32_t remaining_nodes = node_count[i];
+      do {
+        const uint32_t min_size = remaining_nodes + node_count[i + 1] < branching
+          ? remaining_nodes + node_count[i + 1] : branching;
+        node_count[i] = min_size;
+        remaining_nodes = remaining_nodes + node_count[i + 1] - min_size;
+        i++;
+      } while (remaining_nodes > 0);
+
+      for (uint32_t j = i; j < shuffled_len - 1; j++) {
+        node_count[j] = node_count[j + 1];
+      }
+      shuffled_len--;
+      i--;
+    }
+    return shuffled_len;
+  }
+
+  /**
+   * Fills `out` with the nodes of height `shift - bits` described by the plan,
+   * copying the children (or elements) of `nodes` into them. Nodes the plan
+   * leaves as they are are shared.
+   */
+  static void execute_concat_plan(node *const *nodes, const uint32_t *plan,
+                                  uint32_t plan_len, uint32_t shift,
+                                  node_ref *out) {
+    const uint32_t child_shift = shift - bits;
+    uint32_t idx = 0;
+    uint32_t offset = 0;
+    for (uint32_t i = 0; i < plan_len; i++) {
+      const uint32_t new_size = plan[i];
+      if (offset == 0 && new_size == nodes[idx]->len) {
+        out[i] = node_ref(retain(nodes[idx]), child_shift);
+        idx++;
+        continue;
+      }
+      if (child_shift == 0) {
+        node_ref leaf = leaf_create(new_size);
+        while (leaf->len < new_size) {
+          const node *old = nodes[idx];
+          const uint32_t n = new_size - leaf->len < old->len - offset
+            ? new_size - leaf->len : old->len - offset;
+          leaf_append(leaf, elems(old) + offset, n);
+          offset += n;
+          if (offset == old->len) {
+            idx++;
+            offset = 0;
+          }
+        }
+        out[i] = std::move(leaf);
+      }
+      else {
+        node *grandchildren[branching];
+        uint32_t cur_size = 0;
+        while (cur_size < new_size) {
+          const node *old = nodes[idx];
+          grandchildren[cur_size++] = children(old)[offset++];
+          if (offset == old->len) {
+            idx++;
+            offset = 0;
+          }
+        }
+        out[i] = internal_create(grandchildren, new_size, child_shift);
+      }
+    }
+  }
+};
+
+template <typename T, unsigned Bits>
+constexpr uint32_t vector<T, Bits>::bits;
+template <typename T, unsigned Bits>
+constexpr uint32_t vector<T, Bits>::branching;
+template <typename T, unsigned Bits>
+constexpr uint32_t vector<T, Bits>::mask;
+template <typename T, unsigned Bits>
+constexpr uint32_t vector<T, Bits>::invariant;
+template <typename T, unsigned Bits>
+constexpr uint32_t vector<T, Bits>::extras;
+
+template <typename T, unsigned Bits>
+void swap(vector<T, Bits> &a, vector<T, Bits> &b) noexcept {
+  a.swap(b);
+}
+
+}
+
+#endif
@@ -29,6 +29,9 @@
 void randomize_rand(void);
 void print_rrb(const RRB *rrb);
 void setup_rand(const char *str_seed);
+int check_contents(const RRB *rrb, const intptr_t *list, uint32_t size,
+                   const char *name);
+const RRB* rand_rrb(uint32_t max_size);
 
 #ifdef RRB_DEBUG
 #define CHECK_TREE(t) (validate_rrb(t))
@@ -54,13 +57,44 @@ void randomize_rand() {
 }
 
 void print_rrb(const RRB *rrb) {
-  uint32_t count = rrb_count(rrb);
+  RRBIndex count = rrb_count(rrb);
   printf("[");
   char sep = 0;
-  for (uint32_t i = 0; i < count; i++) {
+  for (RRBIndex i = 0; i < count; i++) {
     intptr_t val = (intptr_t) rrb_nth(rrb, i);
     printf("%s%ld", sep ? ", " : "", val);
     sep = 1;
   }
   printf("]\n");
 }
+
+// Checks that rrb contains exactly the size items in list, and prints every
+// difference, prefixed by name.
+int check_contents(const RRB *rrb, const intptr_t *list, uint32_t size,
+                   const char *name) {
+  int fail = CHECK_TREE(rrb);
+  if (rrb_count(rrb) != size) {
+    printf("%s: Expected %u elements, but has %u.\n", name, size,
+           (uint32_t) rrb_count(rrb));
+    return 1;
+  }
+  for (uint32_t i = 0; i < size; i++) {
+    intptr_t val = (intptr_t) rrb_nth(rrb, i);
+    if (val != list[i]) {
+      printf("%s: Expected val at pos %u to be %ld, was %ld.\n", name, i,
+             list[i], val);
+      fail = 1;
+    }
+  }
+  return fail;
+}
+
+// Returns an RRB-tree with less than max_size random items, pushed one by one.
+const RRB* rand_rrb(uint32_t max_size) {
+  const uint32_t size = (uint32_t) (rand() % max_size);
+  const RRB *rrb = rrb_create();
+  for (uint32_t i = 0; i < size; i++) {
+    rrb = rrb_push(rrb, (void *) ((intptr_t) rand() & 0xffff));
+  }
+  return rrb;
+}
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2013-2014 Jean Niklas L'orange. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "rrb.h"
+#include "test.h"
+
+#define SIZE 5000
+
+typedef struct {
+  uint32_t mallocs;
+  uint32_t frees;
+} AllocCount;
+
+static void* count_malloc(size_t size, void *ctx) {
+  ((AllocCount *) ctx)->mallocs++;
+  return calloc(1, size);
+}
+
+static void* count_malloc_atomic(size_t size, void *ctx) {
+  ((AllocCount *) ctx)->mallocs++;
+  return malloc(size);
+}
+
+static void* count_realloc(void *ptr, size_t size, void *ctx) {
+  return realloc(ptr, size);
+}
+
+static void count_free(void *ptr, void *ctx) {
+  ((AllocCount *) ctx)->frees++;
+  free(ptr);
+}
+
+int main(int argc, char *argv[]) {
+  // No garbage collector: Everything is allocated through count_malloc.
+  AllocCount count = {0, 0};
+  const RRBAllocator allocator = {
+    .malloc = count_malloc,
+    .atomic_malloc = count_malloc_atomic,
+    .realloc = count_realloc,
+    .free = count_free,
+    .ctx = &count
+  };
+  rrb_set_allocator(&allocator);
+  setup_rand(argc == 2 ? argv[1] : NULL);
+
+  int fail = 0;
+
+  if (rrb_get_allocator()->ctx != &count) {
+    printf("rrb_get_allocator didn't return the allocator just set.\n");
+    fail = 1;
+  }
+
+  intptr_t *list = malloc(SIZE * sizeof(intptr_t));
+  for (uint32_t i = 0; i < SIZE; i++) {
+    list[i] = rand();
+  }
+
+  const RRB *rrb = rrb_create();
+  for (uint32_t i = 0; i < SIZE; i++) {
+    rrb = rrb_push(rrb, (void *) list[i]);
+  }
+  if (count.mallocs == 0) {
+    printf("Pushes didn't allocate through the custom allocator.\n");
+    fail = 1;
+  }
+
+  // rrb_from_array frees its temporary node array when done.
+  const uint32_t frees = count.frees;
+  const RRB *from = rrb_from_array((const void *const *) list, SIZE);
+  if (count.frees == frees) {
+    printf("rrb_from_array didn't free through the custom allocator.\n");
+    fail = 1;
+  }
+
+  // Misaligned slices force rebalancing on concatenation.
+  const uint32_t mid = (uint32_t) rand() % SIZE;
+  const RRB *cat = rrb_concat(rrb_slice(rrb, 0, mid),
+                              rrb_slice(from, mid, SIZE));
+
+  TransientRRB *trrb = rrb_to_transient(cat);
+  for (uint32_t i = 0; i < SIZE; i++) {
+    trrb = transient_rrb_update(trrb, i, (void *) (list[i] + 1));
+  }
+  const RRB *updated = transient_to_rrb(trrb);
+
+  const RRB *checks[] = {rrb, from, cat};
+  for (uint32_t c = 0; c < 3; c++) {
+    fail |= CHECK_TREE(checks[c]);
+    for (uint32_t i = 0; i < SIZE; i++) {
+      intptr_t val = (intptr_t) rrb_nth(checks[c], i);
+      if (val != list[i]) {
+        printf("Expected val at pos %u to be %ld, was %ld (tree %u).\n", i,
+               list[i], val, c);
+        fail = 1;
+      }
+    }
+  }
+  fail |= CHECK_TREE(updated);
+  for (uint32_t i = 0; i < SIZE; i++) {
+    intptr_t val = (intptr_t) rrb_nth(updated, i);
+    if (val != list[i] + 1) {
+      printf("Expected updated val at pos %u to be %ld, was %ld.\n", i,
+             list[i] + 1, val);
+      fail = 1;
+    }
+  }
+
+  free(list);
+  return fail;
+}
@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2013-2014 Jean Niklas L'orange. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "rrb.h"
+#include "test.h"
+
+#define ROUNDS 20
+#define SIZE 20000
+#define MAX_FRAGMENT 2000
+#define EDITS 200
+#define MAX_SIZE (SIZE + 4 * MAX_FRAGMENT)
+
+#define MIN(a,b) (((a)<(b))?(a):(b))
+
+typedef struct {
+  int32_t mallocs;
+  int32_t live;
+} AllocCount;
+
+static void* count_malloc(size_t size, void *ctx) {
+  ((AllocCount *) ctx)->mallocs++;
+  ((AllocCount *) ctx)->live++;
+  return calloc(1, size);
+}
+
+static void* count_malloc_atomic(size_t size, void *ctx) {
+  ((AllocCount *) ctx)->mallocs++;
+  ((AllocCount *) ctx)->live++;
+  return malloc(size);
+}
+
+static void* count_realloc(void *ptr, size_t size, void *ctx) {
+  if (ptr == NULL) {
+    ((AllocCount *) ctx)->live++;
+  }
+  return realloc(ptr, size);
+}
+
+static void count_free(void *ptr, void *ctx) {
+  ((AllocCount *) ctx)->live--;
+  free(ptr);
+}
+
+static const RRB* build(RRBArena *arena, const intptr_t *list, uint32_t size) {
+  TransientRRB *trrb = rrb_to_transient_in(rrb_create(), arena);
+  for (uint32_t i = 0; i < size; i++) {
+    trrb = transient_rrb_push(trrb, (void *) list[i]);
+  }
+  return transient_to_rrb(trrb);
+}
+
+int main(int argc, char *argv[]) {
+  // No garbage collector: Everything is allocated through count_malloc.
+  AllocCount count = {0, 0};
+  const RRBAllocator allocator = {
+    .malloc = count_malloc,
+    .atomic_malloc = count_malloc_atomic,
+    .realloc = count_realloc,
+    .free = count_free,
+    .ctx = &count
+  };
+  rrb_set_allocator(&allocator);
+  setup_rand(argc == 2 ? argv[1] : NULL);
+
+  int fail = 0;
+  intptr_t *list = malloc((MAX_SIZE + 1) * sizeof(intptr_t));
+  intptr_t *base_list = malloc(SIZE * sizeof(intptr_t));
+  for (uint32_t i = 0; i < SIZE; i++) {
+    base_list[i] = rand();
+  }
+  const RRB *base = rrb_from_array((const void *const *) base_list, SIZE);
+  RRBArena *arena = rrb_arena_create();
+
+  for (uint32_t r = 0; r < ROUNDS; r++) {
+    // Building only allocates slabs, and none once the arena has been used.
+    int32_t mallocs = count.mallocs;
+    const RRB *built = build(arena, base_list, SIZE);
+    fail |= check_contents(built, base_list, SIZE, "Pushes in arena");
+    mallocs = count.mallocs - mallocs;
+    if (r == 0 ? mallocs > 10 : mallocs != 0) {
+      printf("Building %u elements in an arena made %d allocations.\n", SIZE,
+             mallocs);
+      fail = 1;
+    }
+
+    // Editing a tree shared with the heap, and concatenating heap trees
+    uint32_t size = SIZE;
+    memcpy(list, base_list, SIZE * sizeof(intptr_t));
+    TransientRRB *trrb = rrb_to_transient_in(base, arena);
+    for (uint32_t e = 0; e < EDITS; e++) {
+      switch (rand() % 4) {
+      case 0: {
+        const uint32_t idx = (uint32_t) rand() % size;
+        list[idx] = rand();
+        trrb = transient_rrb_update(trrb, idx, (void *) list[idx]);
+        break;
+      }
+      case 1:
+        trrb = transient_rrb_pop(trrb);
+        size--;
+        break;
+      case 2: {
+        if (size + MAX_FRAGMENT > MAX_SIZE) {
+          break;
+        }
+        const uint32_t len = (uint32_t) rand() % MAX_FRAGMENT;
+        const RRB *fragment = rrb_create();
+        for (uint32_t i = 0; i < len; i++) {
+          list[size + i] = rand();
+          const RRB *pushed = rrb_push(fragment, (void *) list[size + i]);
+          rrb_release(fragment);
+          fragment = pushed;
+        }
+        trrb = transient_rrb_concat(trrb, fragment);
+        // The arena keeps the nodes it shares alive
+        rrb_release(fragment);
+        size += len;
+        break;
+      }
+      default: {
+        const uint32_t to = size - (uint32_t) rand() % MIN(size, MAX_FRAGMENT);
+        const uint32_t from = (uint32_t) rand() % MIN(to, 50);
+        memmove(list, &list[from], (to - from) * sizeof(intptr_t));
+        trrb = transient_rrb_slice(trrb, from, to);
+        size = to - from;
+        break;
+      }
+      }
+      if (size < MAX_FRAGMENT) {
+        break;
+      }
+    }
+    const RRB *edited = transient_to_rrb(trrb);
+    fail |= check_contents(edited, list, size, "Edits in arena");
+    fail |= check_contents(base, base_list, SIZE, "Source of arena transient");
+
+    // Persistent trees derived from arena trees live on the heap
+    list[size] = rand();
+    const RRB *derived = rrb_push(edited, (void *) list[size]);
+    fail |= check_contents(derived, list, size + 1, "Push on arena tree");
+    rrb_release(derived);
+    rrb_release(edited);
+    rrb_release(built);
+
+    rrb_arena_reset(arena);
+  }
+
+  rrb_arena_destroy(arena);
+  rrb_release(base);
+  free(list);
+  free(base_list);
+
+#ifdef RRB_REFCOUNT
+  if (count.live != 0) {
+    printf("Expected all memory to be freed, but %d allocations remain.\n",
+           count.live);
+    fail = 1;
+  }
+#endif
+  return fail;
+}
@@ -78,8 +78,8 @@ int main(int argc, char *argv[]) {
                  i, merged_pos);
           printf("  Expected val at pos %u (%u in merged) to be %ld, but was %ld\n",
                  pos, merged_i, expected, actual);
-          printf("  Size of merged: %u, is at index %u\n", rrb_count(merged),
-                 merged_in[merged_pos]);
+          printf("  Size of merged: %u, is at index %u\n",
+                 (uint32_t) rrb_count(merged), merged_in[merged_pos]);
           printf("Sliced lists:\n");
           fail = 1;
           return fail;
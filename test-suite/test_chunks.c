@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2013-2014 Jean Niklas L'orange. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <gc/gc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "rrb.h"
+#include "test.h"
+
+#define TESTS 300
+#define CONCATS 30
+#define MAX_PART 200
+#define RANGES 20
+
+typedef struct {
+  const RRB *rrb;
+  uint32_t pos;
+  uint32_t stop_at;
+  int fail;
+} ChunkCheck;
+
+static int check_chunk(const void *const *data, uint32_t len, void *ctx) {
+  ChunkCheck *check = (ChunkCheck *) ctx;
+  if (len == 0 || len > RRB_LEAF_BRANCHING) {
+    printf("Chunk at pos %u has an invalid length of %u.\n", check->pos, len);
+    check->fail = 1;
+  }
+  for (uint32_t i = 0; i < len; i++, check->pos++) {
+    intptr_t expected = (intptr_t) rrb_nth(check->rrb, check->pos);
+    intptr_t actual = (intptr_t) data[i];
+    if (expected != actual) {
+      printf("Expected val at pos %u to be %ld, was %ld.\n", check->pos,
+             expected, actual);
+      check->fail = 1;
+    }
+  }
+  return check->pos >= check->stop_at ? 1 : 0;
+}
+
+int main(int argc, char *argv[]) {
+  GC_INIT();
+  setup_rand(argc == 2 ? argv[1] : NULL);
+
+  int fail = 0;
+
+  for (uint32_t t = 0; t < TESTS; t++) {
+    const RRB *rrb = rrb_create();
+    for (uint32_t i = 0; i < CONCATS; i++) {
+      rrb = rrb_concat(rrb, rand_rrb(MAX_PART));
+    }
+    const uint32_t count = rrb_count(rrb);
+
+    for (uint32_t r = 0; r < RANGES; r++) {
+      const uint32_t from = (uint32_t) rand() % (count + 1);
+      const uint32_t to = from + (uint32_t) rand() % (count - from + 1);
+
+      // Callback visitor, visiting the whole range
+      ChunkCheck check = {.rrb = rrb, .pos = from, .stop_at = to + 1, .fail = 0};
+      if (rrb_chunks(rrb, from, to, check_chunk, &check) != 0) {
+        printf("rrb_chunks stopped early on range [%u, %u).\n", from, to);
+        fail = 1;
+      }
+      if (check.pos != to) {
+        printf("rrb_chunks visited up to %u, expected to visit up to %u.\n",
+               check.pos, to);
+        fail = 1;
+      }
+      fail |= check.fail;
+
+      // Callback visitor, stopping early
+      if (from < to) {
+        ChunkCheck stopper = {.rrb = rrb, .pos = from, .stop_at = from + 1,
+                              .fail = 0};
+        if (rrb_chunks(rrb, from, to, check_chunk, &stopper) != 1) {
+          printf("rrb_chunks did not stop on range [%u, %u).\n", from, to);
+          fail = 1;
+        }
+        fail |= stopper.fail;
+      }
+
+      // Pull-style cursor
+      RRBIterator *it = rrb_iterator_create_range(rrb, from, to);
+      ChunkCheck pulled = {.rrb = rrb, .pos = from, .stop_at = to + 1, .fail = 0};
+      const void *const *data;
+      uint32_t len;
+      while ((len = rrb_iterator_next_chunk(it, &data)) != 0) {
+        check_chunk(data, len, &pulled);
+      }
+      if (pulled.pos != to) {
+        printf("Chunk cursor visited up to %u, expected to visit up to %u.\n",
+               pulled.pos, to);
+        fail = 1;
+      }
+      fail |= pulled.fail;
+    }
+
+    // Ranges outside the RRB-tree are clipped
+    ChunkCheck clipped = {.rrb = rrb, .pos = 0, .stop_at = count + 1, .fail = 0};
+    rrb_chunks(rrb, 0, count + 100, check_chunk, &clipped);
+    if (clipped.pos != count) {
+      printf("Clipped rrb_chunks visited up to %u, expected %u.\n",
+             clipped.pos, count);
+      fail = 1;
+    }
+    fail |= clipped.fail;
+  }
+
+  return fail;
+}
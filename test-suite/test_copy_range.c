@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2013-2014 Jean Niklas L'orange. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <gc/gc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "rrb.h"
+#include "test.h"
+
+#define TESTS 30
+#define CONCATS 20
+#define MAX_PART 4000
+#define RANGES 10
+#define MAX_THREADS 8
+#define SENTINEL ((void *) -1)
+
+static int check_copy(const RRB *rrb, void **out, uint32_t from, uint32_t to,
+                      const char *name) {
+  int fail = 0;
+  for (uint32_t i = from; i < to; i++) {
+    intptr_t expected = (intptr_t) rrb_nth(rrb, i);
+    intptr_t actual = (intptr_t) out[i - from];
+    if (expected != actual) {
+      printf("%s: Expected val at pos %u to be %ld, was %ld.\n", name, i,
+             expected, actual);
+      fail = 1;
+    }
+  }
+  if (out[to - from] != SENTINEL) {
+    printf("%s: Wrote past the end of range [%u, %u).\n", name, from, to);
+    fail = 1;
+  }
+  return fail;
+}
+
+int main(int argc, char *argv[]) {
+  GC_INIT();
+  setup_rand(argc == 2 ? argv[1] : NULL);
+
+  int fail = 0;
+  void **out = GC_MALLOC((CONCATS * MAX_PART + 1) * sizeof(void *));
+
+  for (uint32_t t = 0; t < TESTS; t++) {
+    const RRB *rrb = rrb_create();
+    for (uint32_t i = 0; i < CONCATS; i++) {
+      rrb = rrb_concat(rrb, rand_rrb(MAX_PART));
+    }
+    const uint32_t count = rrb_count(rrb);
+
+    for (uint32_t r = 0; r < RANGES; r++) {
+      const uint32_t from = (uint32_t) rand() % (count + 1);
+      const uint32_t to = from + (uint32_t) rand() % (count - from + 1);
+
+      out[to - from] = SENTINEL;
+      if (rrb_copy_range(rrb, from, to, out) != to - from) {
+        printf("rrb_copy_range returned wrong count for [%u, %u).\n", from, to);
+        fail = 1;
+      }
+      fail |= check_copy(rrb, out, from, to, "rrb_copy_range");
+
+      const uint32_t nthreads = 1 + (uint32_t) rand() % MAX_THREADS;
+      out[to - from] = SENTINEL;
+      if (rrb_copy_range_parallel(rrb, from, to, out, nthreads) != to - from) {
+        printf("rrb_copy_range_parallel returned wrong count for [%u, %u).\n",
+               from, to);
+        fail = 1;
+      }
+      fail |= check_copy(rrb, out, from, to, "rrb_copy_range_parallel");
+    }
+
+    // Ranges outside the RRB-tree are clipped
+    out[count] = SENTINEL;
+    if (rrb_copy_range_parallel(rrb, 0, count + 100, out, MAX_THREADS)
+        != count) {
+      puts("Clipped rrb_copy_range_parallel returned wrong count.");
+      fail = 1;
+    }
+    fail |= check_copy(rrb, out, 0, count, "Clipped rrb_copy_range_parallel");
+  }
+
+  return fail;
+}
@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) 2013-2014 Jean Niklas L'orange. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+
+#include <gc/gc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "rrb.h"
+#include "test.h"
+
+// Built from a base vector of irregular size, so that concatenations create
+// relaxed nodes. Doubling it gives a vector of more than 2^33 elements, which
+// only takes a few megabytes as both halves are shared.
+#define BASE (3 * RRB_BRANCHING * RRB_LEAF_BRANCHING + 17)
+#define MIN_SIZE ((uint64_t) 1 << 33)
+#define LOOKUPS 100000
+#define RANGE 3000
+
+#if RRB_COUNT_BITS == 64
+
+static intptr_t *list;
+
+static intptr_t expected_at(RRBIndex index) {
+  return list[index % BASE];
+}
+
+static uint64_t rand_index(RRBIndex count) {
+  const uint64_t r = ((uint64_t) rand() << 42) ^ ((uint64_t) rand() << 21)
+    ^ (uint64_t) rand();
+  return r % count;
+}
+
+static int check_range(const RRB *rrb, RRBIndex offset, RRBIndex len,
+                       const char *what) {
+  if (rrb_count(rrb) != len) {
+    printf("Expected %s to contain %llu elements, but it has %llu.\n", what,
+           (unsigned long long) len, (unsigned long long) rrb_count(rrb));
+    return 1;
+  }
+  for (RRBIndex i = 0; i < len; i++) {
+    const intptr_t val = (intptr_t) rrb_nth(rrb, i);
+    if (val != expected_at(offset + i)) {
+      printf("Expected %s to contain %ld at %llu, but it was %ld.\n", what,
+             expected_at(offset + i), (unsigned long long) i, val);
+      return 1;
+    }
+  }
+  return CHECK_TREE(rrb);
+}
+
+int main(int argc, char *argv[]) {
+  GC_INIT();
+  setup_rand(argc == 2 ? argv[1] : NULL);
+
+  int fail = 0;
+  list = GC_MALLOC_ATOMIC(sizeof(intptr_t) * BASE);
+  for (uint32_t i = 0; i < BASE; i++) {
+    list[i] = rand();
+  }
+  const RRB *rrb = rrb_from_array((const void *const *) list, BASE);
+  while (rrb_count(rrb) < MIN_SIZE) {
+    const RRB *doubled = rrb_concat(rrb, rrb);
+    rrb_release(rrb);
+    rrb = doubled;
+  }
+  const RRBIndex count = rrb_count(rrb);
+
+  for (uint32_t i = 0; i < LOOKUPS; i++) {
+    const RRBIndex idx = rand_index(count);
+    const intptr_t val = (intptr_t) rrb_nth(rrb, idx);
+    if (val != expected_at(idx)) {
+      printf("Expected %ld at %llu, but it was %ld.\n", expected_at(idx),
+             (unsigned long long) idx, val);
+      fail = 1;
+      break;
+    }
+  }
+
+  // Slices around the 32-bit boundaries and the end
+  const RRBIndex starts[] = {((RRBIndex) 1 << 32) - RANGE / 2,
+                             ((RRBIndex) 1 << 32) + 1,
+                             count - RANGE};
+  for (uint32_t i = 0; i < sizeof(starts) / sizeof(starts[0]); i++) {
+    const RRB *slice = rrb_slice(rrb, starts[i], starts[i] + RANGE);
+    fail |= check_range(slice, starts[i], RANGE, "slice");
+    rrb_release(slice);
+  }
+  const RRB *suffix = rrb_slice(rrb, count - RANGE, count + 10);
+  fail |= check_range(suffix, count - RANGE, RANGE, "suffix");
+  rrb_release(suffix);
+
+  // Chunks and iterators past 2^32
+  const RRBIndex high = ((RRBIndex) 1 << 32) + (RRBIndex) rand_index(1 << 20);
+  const void *const *data;
+  RRBIndex start;
+  const uint32_t len = rrb_chunk_at(rrb, high, &data, &start);
+  if (start > high || high - start >= len
+      || (intptr_t) data[high - start] != expected_at(high)) {
+    printf("Chunk at %llu is wrong.\n", (unsigned long long) high);
+    fail = 1;
+  }
+  RRBIterator *it = rrb_iterator_create_range(rrb, high, high + RANGE);
+  for (RRBIndex i = high; i < high + RANGE; i++) {
+    const intptr_t val = (intptr_t) rrb_iterator_next(it);
+    if (val != expected_at(i)) {
+      printf("Iterator gave %ld at %llu, expected %ld.\n", val,
+             (unsigned long long) i, expected_at(i));
+      fail = 1;
+      break;
+    }
+  }
+  rrb_iterator_free(it);
+
+  // Updates, pushes and pops don't touch the original
+  const RRB *updated = rrb_update(rrb, high, (void *) -1);
+  if ((intptr_t) rrb_nth(updated, high) != -1
+      || (intptr_t) rrb_nth(rrb, high) != expected_at(high)
+      || (intptr_t) rrb_nth(updated, high + 1) != expected_at(high + 1)) {
+    printf("Update at %llu is wrong.\n", (unsigned long long) high);
+    fail = 1;
+  }
+  rrb_release(updated);
+
+  const RRB *pushed = rrb_push(rrb, (void *) -2);
+  const RRB *popped = rrb_pop(pushed);
+  if (rrb_count(pushed) != count + 1 || rrb_count(popped) != count
+      || (intptr_t) rrb_peek(pushed) != -2
+      || (intptr_t) rrb_peek(popped) != expected_at(count - 1)) {
+    puts("Push or pop on the large vector is wrong.");
+    fail = 1;
+  }
+  rrb_release(pushed);
+  rrb_release(popped);
+
+  TransientRRB *trrb = rrb_to_transient(rrb);
+  trrb = transient_rrb_update(trrb, high, (void *) -3);
+  trrb = transient_rrb_slice(trrb, high - RANGE, high + RANGE);
+  const RRB *sliced = transient_to_rrb(trrb);
+  if ((intptr_t) rrb_nth(sliced, RANGE) != -3
+      || (intptr_t) rrb_nth(rrb, high) != expected_at(high)) {
+    puts("Transient update and slice on the large vector is wrong.");
+    fail = 1;
+  }
+  rrb_release(sliced);
+
+  rrb_release(rrb);
+  return fail;
+}
+
+#else
+
+int main(void) {
+  // Counts are 32 bits wide, so vectors this large can't be built. The exit
+  // code tells automake that the test was skipped.
+  puts("Skipped: Configure with --with-count-bits=64 to run this test.");
+  return 77;
+}
+
+#endif
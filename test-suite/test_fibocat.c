@@ -35,15 +35,6 @@
 #define PREDEF_RRBS 200
 #define MAX_INIT_SIZE (MIN(RRB_BRANCHING,16))
 
-static const RRB* rand_rrb() {
-  const uint32_t size = (uint32_t) (rand() % MAX_INIT_SIZE);
-  const RRB *rrb = rrb_create();
-  for (uint32_t i = 0; i < size; i++) {
-    rrb = rrb_push(rrb, (void *) ((intptr_t) rand() & 0xffff));
-  }
-  return rrb;
-}
-
 int main(int argc, char *argv[]) {
   GC_INIT();
   setup_rand(argc == 2 ? argv[1] : NULL);
@@ -53,7 +44,7 @@ int main(int argc, char *argv[]) {
   const RRB *rrbs[RRB_COUNT];
 
   for (uint32_t i = 0; i < PREDEF_RRBS; i++) {
-    rrbs[i] = rand_rrb();
+    rrbs[i] = rand_rrb(MAX_INIT_SIZE);
     fail |= CHECK_TREE(rrbs[i]);
   }
 
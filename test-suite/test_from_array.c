@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2013-2014 Jean Niklas L'orange. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <gc/gc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "rrb.h"
+#include "test.h"
+
+#define RANDOM_TESTS 100
+#define MAX_RANDOM_SIZE 100000
+#define EXTRA_PUSHES 100
+
+static int check_from_array(const intptr_t *list, uint32_t size) {
+  int fail = 0;
+  const RRB *rrb = rrb_from_array((const void *const *) list, size);
+  fail |= CHECK_TREE(rrb);
+  if (rrb_count(rrb) != size) {
+    printf("Expected RRB-tree from array to have %u elements, but has %u.\n",
+           size, (uint32_t) rrb_count(rrb));
+    return 1;
+  }
+  for (uint32_t i = 0; i < size; i++) {
+    intptr_t val = (intptr_t) rrb_nth(rrb, i);
+    if (val != list[i]) {
+      printf("Expected val at pos %u to be %ld, was %ld.\n", i, list[i], val);
+      fail = 1;
+    }
+  }
+
+  // The result must be usable as any other RRB-tree.
+  const RRB *pushed = rrb;
+  for (intptr_t i = 0; i < EXTRA_PUSHES; i++) {
+    pushed = rrb_push(pushed, (void *) i);
+  }
+  fail |= CHECK_TREE(pushed);
+  for (uint32_t i = 0; i < size + EXTRA_PUSHES; i++) {
+    intptr_t expected = i < size ? list[i] : (intptr_t) (i - size);
+    intptr_t val = (intptr_t) rrb_nth(pushed, i);
+    if (val != expected) {
+      printf("After pushes on RRB-tree from array of size %u:\n", size);
+      printf("  Expected val at pos %u to be %ld, was %ld.\n", i, expected, val);
+      fail = 1;
+    }
+  }
+  if (size > 0) {
+    const RRB *popped = rrb_pop(rrb);
+    fail |= CHECK_TREE(popped);
+    if (rrb_count(popped) != size - 1) {
+      printf("Popping RRB-tree from array of size %u gave size %u.\n",
+             size, (uint32_t) rrb_count(popped));
+      fail = 1;
+    }
+  }
+  return fail;
+}
+
+int main(int argc, char *argv[]) {
+  GC_INIT();
+  setup_rand(argc == 2 ? argv[1] : NULL);
+
+  int fail = 0;
+  const uint32_t max_size = MAX_RANDOM_SIZE + RRB_LEAF_BRANCHING * RRB_BRANCHING * RRB_BRANCHING + 1;
+  intptr_t *list = GC_MALLOC_ATOMIC(sizeof(intptr_t) * max_size);
+  for (uint32_t i = 0; i < max_size; i++) {
+    list[i] = (intptr_t) rand();
+  }
+
+  // Sizes around node boundaries
+  const uint32_t l = RRB_LEAF_BRANCHING;
+  const uint32_t b = RRB_BRANCHING;
+  const uint32_t edges[] = {0, 1, l - 1, l, l + 1, 2 * l, 2 * l + 1, l * b,
+                            l * b + 1, l * b + l, l * b + l + 1, l * b * b,
+                            l * b * b + 1};
+  for (uint32_t i = 0; i < sizeof(edges) / sizeof(edges[0]); i++) {
+    fail |= check_from_array(list, edges[i]);
+  }
+
+  for (uint32_t t = 0; t < RANDOM_TESTS; t++) {
+    fail |= check_from_array(list, (uint32_t) rand() % MAX_RANDOM_SIZE);
+  }
+
+  return fail;
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2013-2014 Jean Niklas L'orange. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <gc/gc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "rrb.h"
+#include "test.h"
+
+#define TESTS 200
+#define MAX_PUSHES 3000
+#define CONCATS 40
+#define MAX_PART 200
+
+static int check_iterator(const RRB *rrb, RRBIterator *it) {
+  int fail = 0;
+  for (uint32_t i = 0; i < rrb_count(rrb); i++) {
+    if (!rrb_iterator_has_next(it)) {
+      printf("Iterator claimed to be exhausted at %u, but count is %u.\n",
+             i, (uint32_t) rrb_count(rrb));
+      return 1;
+    }
+    intptr_t expected = (intptr_t) rrb_nth(rrb, i);
+    intptr_t actual = (intptr_t) rrb_iterator_next(it);
+    if (expected != actual) {
+      printf("Expected val at pos %u to be %ld, was %ld.\n", i, expected, actual);
+      fail = 1;
+    }
+  }
+  if (rrb_iterator_has_next(it)) {
+    printf("Iterator claims to have more elements after %u elements.\n",
+           (uint32_t) rrb_count(rrb));
+    fail = 1;
+  }
+  if (rrb_iterator_next(it) != NULL) {
+    puts("Exhausted iterator did not return NULL.");
+    fail = 1;
+  }
+  return fail;
+}
+
+int main(int argc, char *argv[]) {
+  GC_INIT();
+  setup_rand(argc == 2 ? argv[1] : NULL);
+
+  int fail = 0;
+
+  for (uint32_t t = 0; t < TESTS; t++) {
+    // Strict trees built through pushes
+    const RRB *pushed = rand_rrb(MAX_PUSHES);
+    fail |= check_iterator(pushed, rrb_iterator_create(pushed));
+
+    // Relaxed trees built through concatenation and slicing
+    const RRB *cat = rrb_create();
+    for (uint32_t i = 0; i < CONCATS; i++) {
+      cat = rrb_concat(cat, rand_rrb(MAX_PART));
+    }
+    fail |= CHECK_TREE(cat);
+    fail |= check_iterator(cat, rrb_iterator_create(cat));
+
+    if (rrb_count(cat) > 0) {
+      uint32_t from = (uint32_t) rand() % rrb_count(cat);
+      uint32_t to = from + (uint32_t) rand() % (rrb_count(cat) - from + 1);
+      const RRB *sliced = rrb_slice(cat, from, to);
+      fail |= check_iterator(sliced, rrb_iterator_create(sliced));
+    }
+
+    // Transients
+    TransientRRB *trrb = rrb_to_transient(cat);
+    for (uint32_t i = 0; i < MAX_PART; i++) {
+      trrb = transient_rrb_push(trrb, (void *) ((intptr_t) rand() & 0xffff));
+    }
+    fail |= check_iterator((const RRB *) trrb, transient_rrb_iterator_create(trrb));
+  }
+
+  return fail;
+}
@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2013-2014 Jean Niklas L'orange. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include <gc/gc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "rrb.h"
+#include "test.h"
+
+#define SIZE 30000
+#define UPDATES 3000
+#define PIECES 150
+
+static long retained = 0;
+static long released = 0;
+
+static void retain_hook(const void *elt) {
+  (void) elt;
+  retained++;
+}
+
+static void release_hook(const void *elt) {
+  (void) elt;
+  released++;
+}
+
+static int check_ops_contents(const RRBOps *ops, const RRB *rrb,
+                              const uintptr_t *expected, uint32_t size,
+                              const char *what) {
+  if (ops->count(rrb) != size) {
+    printf("Expected %s (bits=%u) to contain %u elements, but it has %u.\n",
+           what, ops->bits, size, (uint32_t) ops->count(rrb));
+    return 1;
+  }
+  for (uint32_t i = 0; i < size; i++) {
+    const uintptr_t val = (uintptr_t) ops->nth(rrb, i);
+    if (val != expected[i]) {
+      printf("Expected %s (bits=%u) to contain %lu at %u, but it was %lu.\n",
+             what, ops->bits, (unsigned long) expected[i], i,
+             (unsigned long) val);
+      return 1;
+    }
+  }
+  // Every leaf but the tail of a strict tree is full.
+  uint32_t max_leaf = 0;
+  for (uint32_t i = 0; i < size;) {
+    const void *const *data;
+    RRBIndex start;
+    const uint32_t len = ops->chunk_at(rrb, i, &data, &start);
+    if (start > i || len <= i - start
+        || (uintptr_t) data[i - start] != expected[i]) {
+      printf("Leaf of %s (bits=%u) at %u is wrong.\n", what, ops->bits, i);
+      return 1;
+    }
+    max_leaf = len > max_leaf ? len : max_leaf;
+    i = start + len;
+  }
+  if (max_leaf > (1u << ops->leaf_bits)) {
+    printf("%s (bits=%u) has a leaf of %u elements.\n", what, ops->bits,
+           max_leaf);
+    return 1;
+  }
+  return 0;
+}
+
+static int test_ops(const RRBOps *ops) {
+  int fail = 0;
+  uintptr_t *list = GC_MALLOC_ATOMIC(sizeof(uintptr_t) * SIZE);
+  TransientRRB *trrb = ops->to_transient(ops->create());
+  for (uint32_t i = 0; i < SIZE; i++) {
+    list[i] = (uintptr_t) rand();
+    trrb = ops->transient_push(trrb, (void *) list[i]);
+  }
+  const RRB *rrb = ops->from_transient(trrb);
+  fail |= check_ops_contents(ops, rrb, list, SIZE, "pushed vector");
+  if (SIZE > (1u << (ops->bits + ops->leaf_bits))
+      && ops->count(rrb) == SIZE) {
+    // The tree should be as deep as the branching factor makes it.
+    const void *const *data;
+    RRBIndex start;
+    if (ops->chunk_at(rrb, 0, &data, &start) != (1u << ops->leaf_bits)) {
+      printf("First leaf (bits=%u) is not full.\n", ops->bits);
+      fail = 1;
+    }
+  }
+
+  for (uint32_t i = 0; i < UPDATES; i++) {
+    const uint32_t idx = (uint32_t) rand() % SIZE;
+    list[idx] = (uintptr_t) rand();
+    const RRB *updated = ops->update(rrb, idx, (void *) list[idx]);
+    ops->release(rrb);
+    rrb = updated;
+  }
+  fail |= check_ops_contents(ops, rrb, list, SIZE, "updated vector");
+
+  const RRB *catted = ops->create();
+  uint32_t from = 0;
+  for (uint32_t i = 0; from < SIZE; i++) {
+    uint32_t to = i + 1 == PIECES ? SIZE
+                                  : from + (uint32_t) rand() % (2 * SIZE / PIECES);
+    if (to > SIZE) {
+      to = SIZE;
+    }
+    const RRB *piece = ops->slice(rrb, from, to);
+    const RRB *joined = ops->concat(catted, piece);
+    ops->release(catted);
+    ops->release(piece);
+    catted = joined;
+    from = to;
+  }
+  fail |= check_ops_contents(ops, catted, list, SIZE, "concatenated vector");
+
+  RRBIterator *it = ops->iterator_create(catted);
+  for (uint32_t i = 0; ops->iterator_has_next(it); i++) {
+    if ((uintptr_t) ops->iterator_next(it) != list[i]) {
+      printf("Iterator (bits=%u) is wrong at %u.\n", ops->bits, i);
+      fail = 1;
+      break;
+    }
+  }
+  ops->iterator_free(it);
+
+  const RRB *popped = ops->pop(catted);
+  fail |= check_ops_contents(ops, popped, list, SIZE - 1, "popped vector");
+  ops->release(popped);
+  ops->release(catted);
+  ops->release(rrb);
+  return fail;
+}
+
+int main(int argc, char *argv[]) {
+  GC_INIT();
+  setup_rand(argc == 2 ? argv[1] : NULL);
+  rrb_set_element_hooks(retain_hook, release_hook);
+
+  int fail = 0;
+  const uint32_t bits[] = {RRB_BITS, 4, 5, 6};
+  for (uint32_t i = 0; i < sizeof(bits) / sizeof(bits[0]); i++) {
+    const RRBOps *ops = rrb_ops(bits[i]);
+    if (ops == NULL || ops->bits != bits[i]) {
+      printf("No instance with %u bits per branching.\n", bits[i]);
+      fail = 1;
+      continue;
+    }
+    retained = released = 0;
+    fail |= test_ops(ops);
+#ifdef RRB_REFCOUNT
+    // The element hooks are shared by every instance.
+    if (retained == 0 || retained != released) {
+      printf("Instance with %u bits retained %ld elements and released %ld.\n",
+             bits[i], retained, released);
+      fail = 1;
+    }
+#endif
+  }
+
+  if (rrb_ops(RRB_BITS == 13 ? 14 : 13) != NULL) {
+    printf("rrb_ops returned an instance that doesn't exist.\n");
+    fail = 1;
+  }
+
+#ifndef NDEBUG
+  // An RRB-tree passed to another instance trips an assertion.
+  const RRBOps *four = rrb_ops(4);
+  const RRBOps *six = rrb_ops(6);
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid == 0) {
+    freopen("/dev/null", "w", stderr);
+    const RRB *rrb = four->push(four->create(), (void *) 1);
+    six->push(rrb, (void *) 2);
+    _exit(0);
+  }
+  int status;
+  if (pid < 0 || waitpid(pid, &status, 0) != pid || !WIFSIGNALED(status)
+      || WTERMSIG(status) != SIGABRT) {
+    printf("Pushing onto a tree from another instance was not caught.\n");
+    fail = 1;
+  }
+#endif
+  return fail;
+}
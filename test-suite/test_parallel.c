@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2013-2014 Jean Niklas L'orange. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <gc/gc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "rrb.h"
+#include "test.h"
+
+#define TESTS 30
+#define CONCATS 20
+#define MAX_PART 4000
+#define MAX_THREADS 8
+
+static void* identity(const void *elt, void *ctx) {
+  return (void *) elt;
+}
+
+static void* add(void *left, void *right, void *ctx) {
+  return (void *) ((intptr_t) left + (intptr_t) right);
+}
+
+// Not commutative: Detects partial results combined out of order.
+static void* keep_first(void *left, void *right, void *ctx) {
+  return left;
+}
+
+static void* scale(const void *elt, void *ctx) {
+  return (void *) ((intptr_t) elt * (intptr_t) ctx + 1);
+}
+
+static int below(const void *elt, void *ctx) {
+  return (intptr_t) elt < (intptr_t) ctx;
+}
+
+int main(int argc, char *argv[]) {
+  GC_INIT();
+  setup_rand(argc == 2 ? argv[1] : NULL);
+
+  int fail = 0;
+
+  for (uint32_t t = 0; t < TESTS; t++) {
+    const RRB *rrb = rrb_create();
+    const uint32_t concats = (uint32_t) rand() % CONCATS;
+    for (uint32_t i = 0; i < concats; i++) {
+      rrb = rrb_concat(rrb, rand_rrb(MAX_PART));
+    }
+    const uint32_t count = rrb_count(rrb);
+    const uint32_t nthreads = 1 + (uint32_t) rand() % MAX_THREADS;
+
+    intptr_t sum = 0;
+    for (uint32_t i = 0; i < count; i++) {
+      sum += (intptr_t) rrb_nth(rrb, i);
+    }
+    intptr_t par_sum = (intptr_t) rrb_parallel_reduce(rrb, nthreads, identity,
+                                                      add, NULL);
+    if (sum != par_sum) {
+      printf("Expected sum of %u elements to be %ld, was %ld (%u threads).\n",
+             count, sum, par_sum, nthreads);
+      fail = 1;
+    }
+    void *first = rrb_parallel_reduce(rrb, nthreads, identity, keep_first, NULL);
+    if (first != (count == 0 ? NULL : rrb_nth(rrb, 0))) {
+      printf("rrb_parallel_reduce combined results out of order "
+             "(%u threads).\n", nthreads);
+      fail = 1;
+    }
+
+    const RRB *mapped = rrb_parallel_map(rrb, nthreads, scale, (void *) 3);
+    fail |= CHECK_TREE(mapped);
+    if (rrb_count(mapped) != count) {
+      printf("Expected mapped RRB-tree to contain %u elements, has %u.\n",
+             count, (uint32_t) rrb_count(mapped));
+      fail = 1;
+    }
+    for (uint32_t i = 0; i < count && i < rrb_count(mapped); i++) {
+      intptr_t expected = (intptr_t) rrb_nth(rrb, i) * 3 + 1;
+      intptr_t actual = (intptr_t) rrb_nth(mapped, i);
+      if (expected != actual) {
+        printf("Expected mapped val at pos %u to be %ld, was %ld.\n", i,
+               expected, actual);
+        fail = 1;
+      }
+    }
+
+    // Filtering with a random match rate, which varies between parts
+    const intptr_t limit = rand() & 0xffff;
+    const RRB *filtered = rrb_parallel_filter(rrb, nthreads, below,
+                                              (void *) limit);
+    fail |= CHECK_TREE(filtered);
+    uint32_t pos = 0;
+    for (uint32_t i = 0; i < count; i++) {
+      void *val = rrb_nth(rrb, i);
+      if ((intptr_t) val >= limit) {
+        continue;
+      }
+      if (pos >= rrb_count(filtered)) {
+        printf("Filtered RRB-tree is too short, only has %u elements.\n",
+               (uint32_t) rrb_count(filtered));
+        fail = 1;
+        break;
+      }
+      if (rrb_nth(filtered, pos) != val) {
+        printf("Expected filtered val at pos %u to be %ld, was %ld.\n", pos,
+               (intptr_t) val, (intptr_t) rrb_nth(filtered, pos));
+        fail = 1;
+      }
+      pos++;
+    }
+    if (pos != rrb_count(filtered)) {
+      printf("Expected filtered RRB-tree to contain %u elements, has %u.\n",
+             pos, (uint32_t) rrb_count(filtered));
+      fail = 1;
+    }
+  }
+
+  return fail;
+}
@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2013-2014 Jean Niklas L'orange. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+
+
+#include <gc/gc.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+#include "rrb.hpp"
+#include "test.h"
+
+#define SIZE 20000
+#define UPDATES 2000
+#define PIECES 50
+
+static void* elt(uintptr_t i) {
+  return (void *) i;
+}
+
+static int check_contents(const rrb::persistent &p,
+                          const std::vector<uintptr_t> &expected,
+                          const char *what) {
+  if (CHECK_TREE(p.get())) {
+    printf("Tree of %s is invalid.\n", what);
+    return 1;
+  }
+  if (p.size() != expected.size()) {
+    printf("Expected %s to contain %zu elements, but it has %llu.\n",
+           what, expected.size(), (unsigned long long) p.size());
+    return 1;
+  }
+  for (uint32_t i = 0; i < p.size(); i++) {
+    if (p[i] != elt(expected[i])) {
+      printf("Expected %s to contain %lu at %u, but it was %lu.\n", what,
+             (unsigned long) expected[i], i, (unsigned long) (uintptr_t) p[i]);
+      return 1;
+    }
+  }
+  std::vector<void*> elts(expected.size());
+  std::transform(expected.begin(), expected.end(), elts.begin(), elt);
+  if (!std::equal(p.begin(), p.end(), elts.begin())) {
+    printf("Iterating over %s doesn't match indexing.\n", what);
+    return 1;
+  }
+  if (!std::equal(p.end() - 1 - (p.size() / 3), p.end(),
+                  elts.end() - 1 - (p.size() / 3))) {
+    printf("Iterating over the end of %s doesn't match indexing.\n", what);
+    return 1;
+  }
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  GC_INIT();
+  setup_rand(argc == 2 ? argv[1] : NULL);
+  int fail = 0;
+
+  // Rvalue pushes reuse a single transient.
+  std::vector<uintptr_t> expected;
+  rrb::persistent p;
+  for (uint32_t i = 0; i < SIZE; i++) {
+    p = std::move(p).push(elt(2 * i));
+    expected.push_back(2 * i);
+  }
+  fail |= check_contents(p, expected, "the pushed vector");
+
+  // The iterators are random access.
+  for (uint32_t i = 0; i < 100; i++) {
+    uintptr_t target = 2 * (rand() % SIZE) + (rand() % 2);
+    rrb::persistent::const_iterator it =
+      std::lower_bound(p.begin(), p.end(), elt(target));
+    uint32_t want = (uint32_t) ((target + 1) / 2);
+    if ((uint32_t) (it - p.begin()) != want) {
+      printf("Expected lower_bound of %lu to be at %u, but it was at %ld.\n",
+             (unsigned long) target, want, (long) (it - p.begin()));
+      fail = 1;
+      break;
+    }
+  }
+
+  // Lvalue operations and operations on copies leave the original alone.
+  const rrb::persistent original = p;
+  rrb::persistent copy = original;
+  std::vector<uintptr_t> copy_expected = expected;
+  for (uint32_t i = 0; i < UPDATES; i++) {
+    uint32_t index = (uint32_t) rand() % SIZE;
+    copy = std::move(copy).update(index, elt(i));
+    copy_expected[index] = i;
+  }
+  copy = std::move(copy).pop().push(elt(1)).push(elt(3));
+  copy_expected.pop_back();
+  copy_expected.push_back(1);
+  copy_expected.push_back(3);
+  fail |= check_contents(copy, copy_expected, "the updated copy");
+
+  const rrb::persistent popped = original.pop().update(0, elt(7));
+  std::vector<uintptr_t> popped_expected(expected.begin(), expected.end() - 1);
+  popped_expected[0] = 7;
+  fail |= check_contents(popped, popped_expected, "the popped vector");
+  fail |= check_contents(original, expected, "the original vector");
+
+  // Single rvalue operations, with a read ending each chain.
+  rrb::persistent single = original;
+  std::vector<uintptr_t> single_expected = expected;
+  for (uint32_t i = 0; i < UPDATES; i++) {
+    single = std::move(single).push(elt(i));
+    if (single.back() != elt(i)) {
+      printf("Expected %u at the back of the single pushes.\n", i);
+      fail = 1;
+      break;
+    }
+    single = std::move(single).pop();
+    single = std::move(single).push(elt(i + 1));
+    single_expected.push_back(i + 1);
+  }
+  fail |= check_contents(single, single_expected, "the single pushes");
+  fail |= check_contents(original, expected, "the original vector");
+
+  // Slices and concatenations, both lvalue and rvalue.
+  rrb::persistent joined;
+  std::vector<uintptr_t> joined_expected;
+  uint32_t from = 0;
+  for (uint32_t i = 0; i < PIECES; i++) {
+    uint32_t to = i == PIECES - 1 ? SIZE : from + (uint32_t) rand() % (SIZE / PIECES);
+    joined = std::move(joined).concat(original.slice(from, to));
+    joined_expected.insert(joined_expected.end(), expected.begin() + from,
+                           expected.begin() + to);
+    from = to;
+  }
+  fail |= check_contents(joined, joined_expected, "the joined vector");
+
+  rrb::persistent doubled = joined;
+  doubled = std::move(doubled).concat(doubled).slice(SIZE / 2, SIZE + 10);
+  std::vector<uintptr_t> doubled_expected(expected.begin() + SIZE / 2,
+                                          expected.end());
+  doubled_expected.insert(doubled_expected.end(), expected.begin(),
+                          expected.begin() + 10);
+  fail |= check_contents(doubled, doubled_expected, "the doubled vector");
+  fail |= check_contents(joined, joined_expected, "the joined vector");
+
+  // Transients made from copies and from moved persistents.
+  rrb::transient trans(original);
+  trans.push(elt(5)).update(1, elt(9));
+  std::vector<uintptr_t> trans_expected = expected;
+  trans_expected.push_back(5);
+  trans_expected[1] = 9;
+  if (trans.size() != SIZE + 1 || trans[1] != elt(9) || trans.back() != elt(5)) {
+    printf("The transient doesn't contain its updates.\n");
+    fail = 1;
+  }
+  const rrb::persistent from_trans = std::move(trans).persist();
+  fail |= check_contents(from_trans, trans_expected, "the persisted transient");
+  fail |= check_contents(original, expected, "the original vector");
+
+  rrb::persistent moved = original;
+  rrb::transient owner(std::move(moved));
+  owner.slice(0, 3);
+  const rrb::persistent small = rrb::transient().push(elt(4)).concat(
+    std::move(owner).persist()).persist();
+  const std::vector<uintptr_t> small_expected = {4, 0, 2, 4};
+  fail |= check_contents(small, small_expected, "the small vector");
+
+  // Handing the RRB-tree over to C and back.
+  const RRB *raw = std::move(rrb::persistent(small)).release();
+  rrb::persistent adopted(raw);
+  fail |= check_contents(adopted, small_expected, "the adopted vector");
+
+  return fail;
+}
@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2013-2014 Jean Niklas L'orange. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef RRB_REFCOUNT
+#include <gc/gc.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include "rrb.h"
+#include "test.h"
+
+#define ROUNDS 12
+#define VECTORS 48
+#define MAX_SIZE 3000
+#define UPDATES 500
+#define MAX_THREADS 16
+
+// Every vector is built from its seed alone, so that any thread can tell what
+// it should contain.
+static uint32_t next_rand(uint32_t *state) {
+  *state = *state * 1103515245u + 12345u;
+  return *state >> 8;
+}
+
+static intptr_t* expected_contents(uint32_t seed, uint32_t *size) {
+  uint32_t state = seed;
+  *size = next_rand(&state) % MAX_SIZE;
+  intptr_t *list = malloc((*size + 1) * sizeof(intptr_t));
+  for (uint32_t i = 0; i < *size; i++) {
+    list[i] = (intptr_t) next_rand(&state);
+  }
+  for (uint32_t i = 0; i < UPDATES && *size != 0; i++) {
+    const uint32_t pos = next_rand(&state) % *size;
+    list[pos] = (intptr_t) next_rand(&state);
+  }
+  return list;
+}
+
+// Builds the vector of a seed with pushes and updates, releasing every
+// intermediate version.
+static void* build(const void *elt, void *ctx) {
+  uint32_t state = (uint32_t) (intptr_t) elt;
+  const uint32_t size = next_rand(&state) % MAX_SIZE;
+  const RRB *rrb = rrb_create();
+  for (uint32_t i = 0; i < size; i++) {
+    const RRB *pushed = rrb_push(rrb, (void *) (intptr_t) next_rand(&state));
+    rrb_release(rrb);
+    rrb = pushed;
+  }
+  for (uint32_t i = 0; i < UPDATES && size != 0; i++) {
+    const uint32_t pos = next_rand(&state) % size;
+    const RRB *updated = rrb_update(rrb, pos,
+                                    (void *) (intptr_t) next_rand(&state));
+    rrb_release(rrb);
+    rrb = updated;
+  }
+  return (void *) rrb;
+}
+
+int main(int argc, char *argv[]) {
+#ifndef RRB_REFCOUNT
+  GC_INIT();
+#endif
+  setup_rand(argc == 2 ? argv[1] : NULL);
+
+  int fail = 0;
+
+  for (uint32_t round = 0; round < ROUNDS && !fail; round++) {
+    const RRB *seeds = rrb_create();
+    for (uint32_t i = 0; i < VECTORS; i++) {
+      const RRB *pushed = rrb_push(seeds, (void *) (intptr_t) rand());
+      rrb_release(seeds);
+      seeds = pushed;
+    }
+    const uint32_t nthreads = 1 + (uint32_t) rand() % MAX_THREADS;
+
+    // Every vector is built by one thread, and released by this one.
+    const RRB *built = rrb_parallel_map(seeds, nthreads, build, NULL);
+    for (uint32_t i = 0; i < VECTORS; i++) {
+      const uint32_t seed = (uint32_t) (intptr_t) rrb_nth(seeds, i);
+      const RRB *rrb = rrb_nth(built, i);
+      uint32_t size;
+      intptr_t *list = expected_contents(seed, &size);
+      fail |= CHECK_TREE(rrb);
+      if (rrb_count(rrb) != size) {
+        printf("Expected vector %u to contain %u elements, has %u "
+               "(%u threads).\n", i, size, (uint32_t) rrb_count(rrb), nthreads);
+        fail = 1;
+      }
+      for (uint32_t j = 0; j < size && j < rrb_count(rrb); j++) {
+        if ((intptr_t) rrb_nth(rrb, j) != list[j]) {
+          printf("Expected val at pos %u in vector %u to be %ld, was %ld "
+                 "(%u threads).\n", j, i, list[j],
+                 (intptr_t) rrb_nth(rrb, j), nthreads);
+          fail = 1;
+          break;
+        }
+      }
+      free(list);
+      rrb_release(rrb);
+    }
+    rrb_release(built);
+    rrb_release(seeds);
+  }
+  return fail;
+}
@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2013-2014 Jean Niklas L'orange. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <gc/gc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "rrb.h"
+#include "test.h"
+
+#define TESTS 200
+#define CONCATS 10
+#define MAX_PART 100
+#define BATCHES 10
+#define MAX_BATCH 300
+#define MAX_POPS 50
+#define MAX_SIZE (CONCATS * MAX_PART + 2 * BATCHES * MAX_BATCH)
+
+int main(int argc, char *argv[]) {
+  GC_INIT();
+  setup_rand(argc == 2 ? argv[1] : NULL);
+
+  int fail = 0;
+  intptr_t *list = GC_MALLOC_ATOMIC(sizeof(intptr_t) * MAX_SIZE);
+  intptr_t *batch = GC_MALLOC_ATOMIC(sizeof(intptr_t) * MAX_BATCH);
+
+  for (uint32_t t = 0; t < TESTS; t++) {
+    // Start off with a relaxed tree
+    uint32_t size = 0;
+    const RRB *rrb = rrb_create();
+    for (uint32_t i = 0; i < CONCATS; i++) {
+      const uint32_t part_size = (uint32_t) rand() % MAX_PART;
+      const RRB *part = rrb_create();
+      for (uint32_t j = 0; j < part_size; j++) {
+        list[size] = (intptr_t) rand();
+        part = rrb_push(part, (void *) list[size++]);
+      }
+      rrb = rrb_concat(rrb, part);
+    }
+
+    // Persistent batches, interleaved with pops
+    for (uint32_t b = 0; b < BATCHES; b++) {
+      const uint32_t pops = (uint32_t) rand() % MAX_POPS;
+      for (uint32_t i = 0; i < pops && size > 0; i++) {
+        rrb = rrb_pop(rrb);
+        size--;
+      }
+      const uint32_t batch_size = (uint32_t) rand() % MAX_BATCH;
+      for (uint32_t i = 0; i < batch_size; i++) {
+        batch[i] = (intptr_t) rand();
+        list[size + i] = batch[i];
+      }
+      const RRB *pushed = rrb_push_many(rrb, (const void *const *) batch,
+                                        batch_size);
+      fail |= check_contents(rrb, list, size, "Original after rrb_push_many");
+      size += batch_size;
+      fail |= check_contents(pushed, list, size, "rrb_push_many");
+      rrb = pushed;
+    }
+
+    // Transient batches, interleaved with pops
+    const RRB *before = rrb;
+    const uint32_t size_before = size;
+    TransientRRB *trrb = rrb_to_transient(rrb);
+    for (uint32_t b = 0; b < BATCHES; b++) {
+      const uint32_t pops = (uint32_t) rand() % MAX_POPS;
+      for (uint32_t i = 0; i < pops && size > 0; i++) {
+        trrb = transient_rrb_pop(trrb);
+        size--;
+      }
+      const uint32_t batch_size = (uint32_t) rand() % MAX_BATCH;
+      for (uint32_t i = 0; i < batch_size; i++) {
+        batch[i] = (intptr_t) rand();
+        list[size + i] = batch[i];
+      }
+      trrb = transient_rrb_push_many(trrb, (const void *const *) batch,
+                                     batch_size);
+      size += batch_size;
+    }
+    rrb = transient_to_rrb(trrb);
+    fail |= check_contents(rrb, list, size, "transient_rrb_push_many");
+
+    // The original must not have been modified by the transient
+    for (uint32_t i = 0; i < size_before; i++) {
+      if (rrb_nth(before, i) == NULL) {
+        printf("Original RRB-tree was modified at pos %u by a transient.\n", i);
+        fail = 1;
+      }
+    }
+    if (rrb_count(before) != size_before) {
+      puts("Original RRB-tree changed size after transient use.");
+      fail = 1;
+    }
+  }
+
+  return fail;
+}
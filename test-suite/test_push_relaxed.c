@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2013-2014 Jean Niklas L'orange. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <gc/gc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "rrb.h"
+#include "test.h"
+
+#define ROUNDS   50
+#define STEPS    200
+#define VECTORS  6
+#define MAX_SIZE 3000
+
+// Concatenating, slicing and popping leaves relaxed trees whose rightmost
+// nodes aren't full. Pushing onto them must not put the new leaves into the
+// wrong slot.
+
+typedef struct {
+  const RRB *rrb;
+  intptr_t *list;
+  uint32_t size;
+} Vector;
+
+static int check_vector(const Vector *v, uint32_t round, uint32_t step,
+                        const char *op) {
+  int fail = CHECK_TREE(v->rrb);
+  if (rrb_count(v->rrb) != v->size) {
+    printf("Round %u, step %u (%s): Expected size %u, was %llu.\n", round,
+           step, op, v->size, (unsigned long long) rrb_count(v->rrb));
+    return 1;
+  }
+  for (uint32_t i = 0; i < v->size; i++) {
+    intptr_t val = (intptr_t) rrb_nth(v->rrb, i);
+    if (val != v->list[i]) {
+      printf("Round %u, step %u (%s): Expected val at pos %u to be %ld, was %ld.\n",
+             round, step, op, i, v->list[i], val);
+      return 1;
+    }
+  }
+  return fail;
+}
+
+int main(int argc, char *argv[]) {
+  GC_INIT();
+  setup_rand(argc == 2 ? argv[1] : NULL);
+
+  int fail = 0;
+  Vector vs[VECTORS];
+  for (uint32_t i = 0; i < VECTORS; i++) {
+    vs[i].list = GC_MALLOC_ATOMIC(sizeof(intptr_t) * MAX_SIZE);
+  }
+  intptr_t *tmp = GC_MALLOC_ATOMIC(sizeof(intptr_t) * MAX_SIZE);
+
+  for (uint32_t round = 0; round < ROUNDS && !fail; round++) {
+    for (uint32_t i = 0; i < VECTORS; i++) {
+      vs[i].rrb = rrb_create();
+      vs[i].size = 0;
+    }
+    for (uint32_t step = 0; step < STEPS && !fail; step++) {
+      Vector *dst = &vs[(uint32_t) rand() % VECTORS];
+      const Vector *src = &vs[(uint32_t) rand() % VECTORS];
+      const char *op;
+      switch (rand() % 5) {
+      case 0: {
+        op = "concat";
+        if (dst->size + src->size > MAX_SIZE) {
+          continue;
+        }
+        memcpy(tmp, src->list, src->size * sizeof(intptr_t));
+        memcpy(&dst->list[dst->size], tmp, src->size * sizeof(intptr_t));
+        dst->rrb = rrb_concat(dst->rrb, src->rrb);
+        dst->size += src->size;
+        break;
+      }
+      case 1: {
+        op = "slice";
+        const uint32_t from = (uint32_t) rand() % (src->size + 1);
+        const uint32_t to = from + (uint32_t) rand() % (src->size - from + 1);
+        memcpy(tmp, &src->list[from], (to - from) * sizeof(intptr_t));
+        memcpy(dst->list, tmp, (to - from) * sizeof(intptr_t));
+        dst->rrb = rrb_slice(src->rrb, from, to);
+        dst->size = to - from;
+        break;
+      }
+      case 2: {
+        op = "push";
+        const uint32_t n = (uint32_t) rand() % 100;
+        for (uint32_t i = 0; i < n && dst->size < MAX_SIZE; i++) {
+          dst->list[dst->size] = (intptr_t) rand();
+          dst->rrb = rrb_push(dst->rrb, (void *) dst->list[dst->size]);
+          dst->size++;
+        }
+        break;
+      }
+      case 3: {
+        op = "transient push";
+        const uint32_t n = (uint32_t) rand() % 100;
+        TransientRRB *trrb = rrb_to_transient(dst->rrb);
+        for (uint32_t i = 0; i < n && dst->size < MAX_SIZE; i++) {
+          dst->list[dst->size] = (intptr_t) rand();
+          trrb = transient_rrb_push(trrb, (void *) dst->list[dst->size]);
+          dst->size++;
+        }
+        dst->rrb = transient_to_rrb(trrb);
+        break;
+      }
+      default: {
+        op = "pop";
+        const uint32_t n = (uint32_t) rand() % 40;
+        for (uint32_t i = 0; i < n && dst->size > 0; i++) {
+          dst->rrb = rrb_pop(dst->rrb);
+          dst->size--;
+        }
+        break;
+      }
+      }
+      fail |= check_vector(dst, round, step, op);
+    }
+  }
+
+  return fail;
+}
@@ -0,0 +1,384 @@
+/*
+ * Copyright (c) 2013-2014 Jean Niklas L'orange. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "rrb.h"
+#include "test.h"
+
+#define SLOTS 6
+#define STEPS 1500
+#define MAX_SIZE 3000
+#define MAX_BATCH 100
+#define VALUES 1024
+#define THREADS 3
+
+#define MIN(a,b) (((a)<(b))?(a):(b))
+
+// Elements are small integers, so that the element hooks can count the
+// references to every single one of them.
+
+typedef struct {
+  const RRB *rrb;
+  uint32_t size;
+  intptr_t list[MAX_SIZE];
+} Slot;
+
+static Slot slots[SLOTS];
+static intptr_t scratch[MAX_SIZE];
+static int32_t elt_refs[VALUES];
+static int32_t live_allocs;
+static int32_t total_allocs;
+static int negative_refs;
+
+static void* count_malloc(size_t size, void *ctx) {
+  __atomic_add_fetch(&live_allocs, 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&total_allocs, 1, __ATOMIC_RELAXED);
+  return calloc(1, size);
+}
+
+static void* count_malloc_atomic(size_t size, void *ctx) {
+  __atomic_add_fetch(&live_allocs, 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&total_allocs, 1, __ATOMIC_RELAXED);
+  return malloc(size);
+}
+
+static void* count_realloc(void *ptr, size_t size, void *ctx) {
+  if (ptr == NULL) {
+    __atomic_add_fetch(&live_allocs, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&total_allocs, 1, __ATOMIC_RELAXED);
+  }
+  return realloc(ptr, size);
+}
+
+static void count_free(void *ptr, void *ctx) {
+  if (ptr != NULL) {
+    __atomic_sub_fetch(&live_allocs, 1, __ATOMIC_RELAXED);
+  }
+  free(ptr);
+}
+
+static void retain_elt(const void *elt) {
+  __atomic_add_fetch(&elt_refs[(intptr_t) elt], 1, __ATOMIC_RELAXED);
+}
+
+static void release_elt(const void *elt) {
+  if (__atomic_sub_fetch(&elt_refs[(intptr_t) elt], 1, __ATOMIC_RELAXED) < 0) {
+    negative_refs = 1;
+  }
+}
+
+static void* scale(const void *elt, void *ctx) {
+  return (void *) (((intptr_t) elt * 3 + 1) % VALUES);
+}
+
+static int is_even(const void *elt, void *ctx) {
+  return ((intptr_t) elt & 1) == 0;
+}
+
+static intptr_t rand_val() {
+  return rand() % VALUES;
+}
+
+static int check_slot(const Slot *slot, uint32_t step) {
+  int fail = CHECK_TREE(slot->rrb);
+  if (rrb_count(slot->rrb) != slot->size) {
+    printf("Step %u: Expected %u elements, but has %u.\n", step, slot->size,
+           (uint32_t) rrb_count(slot->rrb));
+    return 1;
+  }
+  for (uint32_t i = 0; i < slot->size; i++) {
+    intptr_t val = (intptr_t) rrb_nth(slot->rrb, i);
+    if (val != slot->list[i]) {
+      printf("Step %u: Expected val at pos %u to be %ld, was %ld.\n", step, i,
+             slot->list[i], val);
+      return 1;
+    }
+  }
+  return fail;
+}
+
+// Applies a random edit to the transient and to list, which has *size items.
+static TransientRRB* transient_edit(TransientRRB *trrb, intptr_t *list,
+                                    uint32_t *size, const Slot *other) {
+  switch (rand() % 5) {
+  case 0:
+    if (*size < MAX_SIZE) {
+      list[*size] = rand_val();
+      trrb = transient_rrb_push(trrb, (void *) list[(*size)++]);
+    }
+    return trrb;
+  case 1:
+    if (*size > 0) {
+      const uint32_t idx = (uint32_t) rand() % *size;
+      list[idx] = rand_val();
+      trrb = transient_rrb_update(trrb, idx, (void *) list[idx]);
+    }
+    return trrb;
+  case 2:
+    if (*size > 0) {
+      (*size)--;
+      trrb = transient_rrb_pop(trrb);
+    }
+    return trrb;
+  case 3:
+    if (*size + other->size <= MAX_SIZE) {
+      memcpy(&list[*size], other->list, other->size * sizeof(intptr_t));
+      *size += other->size;
+      trrb = transient_rrb_concat(trrb, other->rrb);
+    }
+    return trrb;
+  default: {
+    const uint32_t to = (uint32_t) rand() % (*size + 1);
+    const uint32_t from = (uint32_t) rand() % (to + 1);
+    memmove(list, &list[from], (to - from) * sizeof(intptr_t));
+    *size = to - from;
+    return transient_rrb_slice(trrb, from, to);
+  }
+  }
+}
+
+// Returns a new RRB-tree made from the ones in a and b, and puts its contents
+// in scratch.
+// Operations that would overflow or cannot be done on an empty slot clear it
+// instead.
+static const RRB* clear(uint32_t *size) {
+  *size = 0;
+  return rrb_create();
+}
+
+static const RRB* rand_op(const Slot *a, const Slot *b, uint32_t *size) {
+  memcpy(scratch, a->list, a->size * sizeof(intptr_t));
+  *size = a->size;
+  const uint32_t idx = (uint32_t) rand() % (a->size + 1);
+  const uint32_t to = (uint32_t) rand() % (a->size + 1);
+  const uint32_t from = (uint32_t) rand() % (to + 1);
+
+  switch (rand() % 13) {
+  case 0:
+    if (a->size == MAX_SIZE) {
+      return clear(size);
+    }
+    scratch[(*size)++] = rand_val();
+    return rrb_push(a->rrb, (void *) scratch[a->size]);
+  case 1: {
+    const uint32_t batch = (uint32_t) rand() % MAX_BATCH;
+    const uint32_t n = MIN(MAX_SIZE - a->size, batch);
+    for (uint32_t i = 0; i < n; i++) {
+      scratch[(*size)++] = rand_val();
+    }
+    return rrb_push_many(a->rrb, (const void *const *) &scratch[a->size], n);
+  }
+  case 2:
+    if (a->size == 0) {
+      return clear(size);
+    }
+    (*size)--;
+    return rrb_pop(a->rrb);
+  case 3:
+    if (a->size == 0) {
+      return clear(size);
+    }
+    scratch[idx % a->size] = rand_val();
+    return rrb_update(a->rrb, idx % a->size, (void *) scratch[idx % a->size]);
+  case 4:
+    if (a->size + b->size > MAX_SIZE) {
+      return clear(size);
+    }
+    memcpy(&scratch[a->size], b->list, b->size * sizeof(intptr_t));
+    *size += b->size;
+    return rrb_concat(a->rrb, b->rrb);
+  case 5:
+    memmove(scratch, &scratch[from], (to - from) * sizeof(intptr_t));
+    *size = to - from;
+    return rrb_slice(a->rrb, from, to);
+  case 6:
+    if (a->size - (to - from) + b->size > MAX_SIZE) {
+      return clear(size);
+    }
+    memmove(&scratch[from + b->size], &a->list[to],
+            (a->size - to) * sizeof(intptr_t));
+    memcpy(&scratch[from], b->list, b->size * sizeof(intptr_t));
+    *size = a->size - (to - from) + b->size;
+    return rrb_splice(a->rrb, from, to, b->rrb);
+  case 7:
+    if (a->size == MAX_SIZE) {
+      return clear(size);
+    }
+    memmove(&scratch[idx + 1], &a->list[idx], (a->size - idx) * sizeof(intptr_t));
+    scratch[idx] = rand_val();
+    (*size)++;
+    return rrb_insert_at(a->rrb, idx, (void *) scratch[idx]);
+  case 8:
+    if (a->size == 0) {
+      return clear(size);
+    }
+    memmove(&scratch[idx % a->size], &a->list[idx % a->size + 1],
+            (a->size - idx % a->size - 1) * sizeof(intptr_t));
+    (*size)--;
+    return rrb_remove_at(a->rrb, idx % a->size);
+  case 9:
+    *size = (uint32_t) rand() % MAX_SIZE;
+    for (uint32_t i = 0; i < *size; i++) {
+      scratch[i] = rand_val();
+    }
+    return rrb_from_array((const void *const *) scratch, *size);
+  case 10: {
+    TransientRRB *trrb = rrb_to_transient(a->rrb);
+    const uint32_t edits = (uint32_t) rand() % 50;
+    for (uint32_t i = 0; i < edits; i++) {
+      trrb = transient_edit(trrb, scratch, size, b);
+    }
+    return transient_to_rrb(trrb);
+  }
+  case 11:
+    for (uint32_t i = 0; i < a->size; i++) {
+      scratch[i] = (intptr_t) scale((void *) a->list[i], NULL);
+    }
+    return rrb_parallel_map(a->rrb, THREADS, scale, NULL);
+  default:
+    *size = 0;
+    for (uint32_t i = 0; i < a->size; i++) {
+      if (is_even((void *) a->list[i], NULL)) {
+        scratch[(*size)++] = a->list[i];
+      }
+    }
+    return rrb_parallel_filter(a->rrb, THREADS, is_even, NULL);
+  }
+}
+
+static const RRB* rand_rrb_of_size(uint32_t size) {
+  const RRB *rrb = rrb_create();
+  for (uint32_t i = 0; i < size; i++) {
+    const RRB *pushed = rrb_push(rrb, (void *) rand_val());
+    rrb_release(rrb);
+    rrb = pushed;
+  }
+  return rrb;
+}
+
+/**
+ * Returns how many of the allocations made while concatenating `right` onto a
+ * transient of `left` are freed again by the time it is made persistent.
+ */
+static int32_t transient_concat_waste(const RRB *left, const RRB *right) {
+  const int32_t live = live_allocs;
+  const int32_t total = total_allocs;
+  TransientRRB *trrb = rrb_to_transient(left);
+  trrb = transient_rrb_concat(trrb, right);
+  const RRB *result = transient_to_rrb(trrb);
+  const int32_t waste = (total_allocs - total) - (live_allocs - live);
+  rrb_release(result);
+  return waste;
+}
+
+// Concatenating onto a transient rebalances every level where the right side
+// is taller, which must reuse the nodes it has instead of allocating spares.
+static int check_transient_concat_waste() {
+  int fail = 0;
+  const uint32_t left_sizes[] = {5, RRB_LEAF_BRANCHING + 5};
+  const uint32_t right_sizes[] = {1000, 40000};
+  const RRB *short_right = rand_rrb_of_size(3 * RRB_LEAF_BRANCHING);
+  for (uint32_t l = 0; l < 2; l++) {
+    const RRB *left = rand_rrb_of_size(left_sizes[l]);
+    const int32_t short_waste = transient_concat_waste(left, short_right);
+    for (uint32_t r = 0; r < 2; r++) {
+      const RRB *right = rand_rrb_of_size(right_sizes[r]);
+      const int32_t waste = transient_concat_waste(left, right);
+      if (waste > short_waste) {
+        printf("Concatenating %u elements onto a transient of %u wasted %d "
+               "allocations, but only %d with %u elements.\n", right_sizes[r],
+               left_sizes[l], waste, short_waste, 3 * RRB_LEAF_BRANCHING);
+        fail = 1;
+      }
+      rrb_release(right);
+    }
+    rrb_release(left);
+  }
+  rrb_release(short_right);
+  return fail;
+}
+
+int main(int argc, char *argv[]) {
+  // Everything goes through the counting allocator, so it must be set before
+  // the first RRB-tree is created.
+  const RRBAllocator allocator = {
+    .malloc = count_malloc,
+    .atomic_malloc = count_malloc_atomic,
+    .realloc = count_realloc,
+    .free = count_free,
+    .ctx = NULL
+  };
+  rrb_set_allocator(&allocator);
+  rrb_set_element_hooks(retain_elt, release_elt);
+  setup_rand(argc == 2 ? argv[1] : NULL);
+
+  int fail = 0;
+  for (uint32_t i = 0; i < SLOTS; i++) {
+    slots[i].rrb = rrb_create();
+  }
+
+  for (uint32_t step = 0; step < STEPS && !fail; step++) {
+    Slot *a = &slots[rand() % SLOTS];
+    const Slot *b = &slots[rand() % SLOTS];
+    uint32_t size;
+    const RRB *result = rand_op(a, b, &size);
+    // Releasing the input must leave the result intact.
+    rrb_release(a->rrb);
+    a->rrb = result;
+    a->size = size;
+    memcpy(a->list, scratch, size * sizeof(intptr_t));
+    fail |= check_slot(a, step);
+
+    RRBIterator *it = rrb_iterator_create(a->rrb);
+    rrb_iterator_free(it);
+  }
+
+  for (uint32_t i = 0; i < SLOTS; i++) {
+    fail |= check_slot(&slots[i], STEPS);
+    rrb_release(slots[i].rrb);
+  }
+
+#ifdef RRB_REFCOUNT
+  fail |= check_transient_concat_waste();
+  if (live_allocs != 0) {
+    printf("Expected all memory to be freed, but %d allocations remain.\n",
+           live_allocs);
+    fail = 1;
+  }
+  if (negative_refs) {
+    printf("An element was released more often than it was retained.\n");
+    fail = 1;
+  }
+  for (uint32_t i = 0; i < VALUES; i++) {
+    if (elt_refs[i] != 0) {
+      printf("Expected element %u to have no references, has %d.\n", i,
+             elt_refs[i]);
+      fail = 1;
+      break;
+    }
+  }
+#endif
+  return fail;
+}
@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2013-2014 Jean Niklas L'orange. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+
+#include <gc/gc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "rrb.h"
+#include "test.h"
+
+#define SIZE 1000000
+#define PIECES 400
+#define APPENDS 20000
+#define CHUNK_RANGES 50
+
+static int check_rope_contents(const RRBRope *rope, const char *expected,
+                               uint64_t size, const char *what) {
+  if (rrb_rope_count(rope) != size) {
+    printf("Expected %s to contain %llu bytes, but it has %llu.\n", what,
+           (unsigned long long) size,
+           (unsigned long long) rrb_rope_count(rope));
+    return 1;
+  }
+  for (uint64_t i = 0; i < size; i++) {
+    const int byte = rrb_rope_byte_at(rope, i);
+    if (byte != (unsigned char) expected[i]) {
+      printf("Expected %s to contain %d at %llu, but it was %d.\n", what,
+             (unsigned char) expected[i], (unsigned long long) i, byte);
+      return 1;
+    }
+  }
+  if (rrb_rope_byte_at(rope, size) != -1) {
+    printf("Expected %s to return -1 past its end.\n", what);
+    return 1;
+  }
+  return 0;
+}
+
+typedef struct {
+  const char *expected;
+  uint64_t pos;
+  int fail;
+} ChunkCheck;
+
+static int check_chunk(const char *data, uint32_t len, void *ctx) {
+  ChunkCheck *check = ctx;
+  if (len == 0 || memcmp(data, &check->expected[check->pos], len) != 0) {
+    printf("Chunk of %u bytes at %llu doesn't match.\n", len,
+           (unsigned long long) check->pos);
+    check->fail = 1;
+    return 1;
+  }
+  check->pos += len;
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  GC_INIT();
+  setup_rand(argc == 2 ? argv[1] : NULL);
+
+  int fail = 0;
+  char *text = GC_MALLOC_ATOMIC(SIZE);
+  for (uint32_t i = 0; i < SIZE; i++) {
+    text[i] = (char) rand();
+  }
+  const RRBRope *rope = rrb_rope_from(text, SIZE);
+  fail |= check_rope_contents(rope, text, SIZE, "rope");
+
+  for (uint32_t i = 0; i < CHUNK_RANGES; i++) {
+    uint64_t from = (uint64_t) rand() % SIZE;
+    uint64_t to = from + (uint64_t) rand() % (SIZE - from + 1);
+    ChunkCheck check = {.expected = text, .pos = from, .fail = 0};
+    rrb_rope_chunks(rope, from, to, check_chunk, &check);
+    if (!check.fail && check.pos != to) {
+      printf("Chunks from %llu to %llu stopped at %llu.\n",
+             (unsigned long long) from, (unsigned long long) to,
+             (unsigned long long) check.pos);
+      check.fail = 1;
+    }
+    fail |= check.fail;
+  }
+
+  // Cut the rope into random pieces, and glue them back together.
+  const RRBRope *catted = rrb_rope_create();
+  uint64_t from = 0;
+  for (uint32_t i = 0; from < SIZE; i++) {
+    uint64_t to = i + 1 == PIECES ? SIZE
+                                  : from + (uint64_t) rand() % (2 * SIZE / PIECES);
+    if (to > SIZE) {
+      to = SIZE;
+    }
+    const RRBRope *piece = rrb_rope_slice(rope, from, to);
+    if (rrb_rope_count(piece) != to - from
+        || (to > from && rrb_rope_byte_at(piece, 0) != (unsigned char) text[from])) {
+      printf("Slice from %llu to %llu is wrong.\n", (unsigned long long) from,
+             (unsigned long long) to);
+      fail = 1;
+    }
+    const RRBRope *joined = rrb_rope_concat(catted, piece);
+    rrb_rope_release(catted);
+    rrb_rope_release(piece);
+    catted = joined;
+    from = to;
+  }
+  fail |= check_rope_contents(catted, text, SIZE, "concatenated rope");
+
+  // Build a rope from many short appends, which merge into shared chunks.
+  const RRBRope *appended = rrb_rope_create();
+  uint64_t appended_len = 0;
+  for (uint32_t i = 0; i < APPENDS; i++) {
+    const uint64_t len = (uint64_t) rand() % 50;
+    const RRBRope *small = rrb_rope_from(&text[appended_len], len);
+    const RRBRope *joined = rrb_rope_concat(appended, small);
+    rrb_rope_release(appended);
+    rrb_rope_release(small);
+    appended = joined;
+    appended_len += len;
+  }
+  fail |= check_rope_contents(appended, text, appended_len, "appended rope");
+
+  rrb_rope_release(appended);
+  rrb_rope_release(catted);
+  rrb_rope_release(rope);
+  return fail;
+}
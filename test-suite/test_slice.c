@@ -66,6 +66,31 @@ int main() {
       }
     }
   }
-  
+
+  // Slicing out everything from a tree whose root is a leaf that isn't full
+  // moves elements out of the tail, which must not touch the original.
+  const RRB *left = rrb_create();
+  const RRB *right = rrb_create();
+  for (uint32_t i = 0; i < 7; i++) {
+    left = rrb_push(left, (void *) list[i]);
+  }
+  for (uint32_t i = 7; i < 40; i++) {
+    right = rrb_push(right, (void *) list[i]);
+  }
+  const RRB *short_root = rrb_pop(rrb_concat(left, right));
+  const RRB *whole = rrb_slice(short_root, 0, rrb_count(short_root));
+  fail |= CHECK_TREE(short_root);
+  fail |= CHECK_TREE(whole);
+  for (uint32_t i = 0; i < 39; i++) {
+    intptr_t val = (intptr_t) rrb_nth(short_root, i);
+    intptr_t sliced_val = (intptr_t) rrb_nth(whole, i);
+    if (val != list[i] || sliced_val != list[i]) {
+      printf("Slicing [0, 39] of a tree with a short leaf root:\n");
+      printf("  Expected val at pos %u to be %ld, was %ld (original) and %ld "
+             "(slice).\n", i, list[i], val, sliced_val);
+      fail = 1;
+    }
+  }
+
   return fail;
 }
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2013-2014 Jean Niklas L'orange. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <gc/gc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "rrb.h"
+#include "test.h"
+
+#define TESTS 100
+#define CONCATS 10
+#define MAX_PART 300
+#define SPLICES 10
+#define EDITS 200
+#define MAX_SIZE (CONCATS * MAX_PART * (SPLICES + 1) + EDITS)
+
+static const RRB* rand_relaxed_rrb(intptr_t *list, uint32_t *size) {
+  const RRB *rrb = rrb_create();
+  const uint32_t concats = (uint32_t) rand() % CONCATS;
+  for (uint32_t i = 0; i < concats; i++) {
+    const uint32_t part_size = (uint32_t) rand() % MAX_PART;
+    const RRB *part = rrb_create();
+    for (uint32_t j = 0; j < part_size; j++) {
+      list[*size] = (intptr_t) rand();
+      part = rrb_push(part, (void *) list[(*size)++]);
+    }
+    rrb = rrb_concat(rrb, part);
+  }
+  return rrb;
+}
+
+int main(int argc, char *argv[]) {
+  GC_INIT();
+  setup_rand(argc == 2 ? argv[1] : NULL);
+
+  int fail = 0;
+  intptr_t *list = GC_MALLOC_ATOMIC(sizeof(intptr_t) * MAX_SIZE);
+  intptr_t *prev_list = GC_MALLOC_ATOMIC(sizeof(intptr_t) * MAX_SIZE);
+  intptr_t *repl_list = GC_MALLOC_ATOMIC(sizeof(intptr_t) * MAX_SIZE);
+
+  for (uint32_t t = 0; t < TESTS; t++) {
+    uint32_t size = 0;
+    const RRB *rrb = rand_relaxed_rrb(list, &size);
+
+    for (uint32_t s = 0; s < SPLICES; s++) {
+      const uint32_t from = (uint32_t) rand() % (size + 1);
+      const uint32_t to = from + (uint32_t) rand() % (size - from + 1);
+      uint32_t repl_size = 0;
+      const RRB *replacement = rand_relaxed_rrb(repl_list, &repl_size);
+
+      const RRB *spliced = rrb_splice(rrb, from, to, replacement);
+      memcpy(prev_list, list, size * sizeof(intptr_t));
+      fail |= check_contents(rrb, prev_list, size, "Original after rrb_splice");
+
+      memmove(&list[from + repl_size], &list[to],
+              (size - to) * sizeof(intptr_t));
+      memcpy(&list[from], repl_list, repl_size * sizeof(intptr_t));
+      size = size - (to - from) + repl_size;
+      fail |= check_contents(spliced, list, size, "rrb_splice");
+      rrb = spliced;
+    }
+
+    // Editor-style single item edits
+    for (uint32_t e = 0; e < EDITS; e++) {
+      if (size > 0 && rand() % 2) {
+        const uint32_t index = (uint32_t) rand() % size;
+        const RRB *removed = rrb_remove_at(rrb, index);
+        memmove(&list[index], &list[index + 1],
+                (size - index - 1) * sizeof(intptr_t));
+        size--;
+        rrb = removed;
+      }
+      else {
+        const uint32_t index = (uint32_t) rand() % (size + 1);
+        const intptr_t val = (intptr_t) rand();
+        const RRB *inserted = rrb_insert_at(rrb, index, (void *) val);
+        memmove(&list[index + 1], &list[index],
+                (size - index) * sizeof(intptr_t));
+        list[index] = val;
+        size++;
+        rrb = inserted;
+      }
+      if (rrb_count(rrb) != size) {
+        printf("Expected %u elements after edit %u, but has %u.\n", size, e,
+               (uint32_t) rrb_count(rrb));
+        fail = 1;
+        break;
+      }
+    }
+    fail |= check_contents(rrb, list, size, "rrb_insert_at/rrb_remove_at");
+  }
+
+  return fail;
+}
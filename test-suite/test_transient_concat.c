@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2013-2014 Jean Niklas L'orange. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <gc/gc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "rrb.h"
+#include "test.h"
+
+#define TESTS 100
+#define FRAGMENTS 40
+#define MAX_FRAGMENT 600
+#define MAX_POPS 40
+#define MAX_SIZE (FRAGMENTS * MAX_FRAGMENT)
+
+// Fragments are sometimes small, so that only the tail is used, and are
+// sometimes relaxed themselves.
+static const RRB* rand_fragment(intptr_t *list, uint32_t *size) {
+  const RRB *fragment = rrb_create();
+  const uint32_t parts = 1 + (uint32_t) rand() % 3;
+  for (uint32_t p = 0; p < parts; p++) {
+    const uint32_t len = (uint32_t) rand() % (rand() % 2 ? MAX_FRAGMENT : 40);
+    const RRB *part = rrb_create();
+    for (uint32_t i = 0; i < len; i++) {
+      list[*size] = (intptr_t) rand();
+      part = rrb_push(part, (void *) list[(*size)++]);
+    }
+    fragment = rrb_concat(fragment, part);
+  }
+  return fragment;
+}
+
+int main(int argc, char *argv[]) {
+  GC_INIT();
+  setup_rand(argc == 2 ? argv[1] : NULL);
+
+  int fail = 0;
+  intptr_t *list = GC_MALLOC_ATOMIC(sizeof(intptr_t) * MAX_SIZE);
+  intptr_t *frag_list = GC_MALLOC_ATOMIC(sizeof(intptr_t) * MAX_SIZE);
+  intptr_t *snapshot_list = GC_MALLOC_ATOMIC(sizeof(intptr_t) * MAX_SIZE);
+
+  for (uint32_t t = 0; t < TESTS; t++) {
+    uint32_t size = 0;
+    TransientRRB *trrb = rrb_to_transient(rrb_create());
+    const RRB *persistent = rrb_create();
+    const RRB *snapshot = NULL;
+    uint32_t snapshot_size = 0;
+
+    for (uint32_t f = 0; f < FRAGMENTS; f++) {
+      uint32_t frag_size = 0;
+      const RRB *fragment = rand_fragment(frag_list, &frag_size);
+      for (uint32_t i = 0; i < frag_size; i++) {
+        list[size + i] = frag_list[i];
+      }
+      trrb = transient_rrb_concat(trrb, fragment);
+      persistent = rrb_concat(persistent, fragment);
+      size += frag_size;
+      fail |= check_contents(fragment, frag_list, frag_size,
+                             "Right side after transient_rrb_concat");
+
+      // Mix in some pops and pushes, to get nodes owned by the transient
+      const uint32_t pops = (uint32_t) rand() % MAX_POPS;
+      for (uint32_t i = 0; i < pops && size > 0; i++) {
+        trrb = transient_rrb_pop(trrb);
+        persistent = rrb_pop(persistent);
+        size--;
+      }
+      if (size > 0 && rand() % 4 == 0) {
+        list[size] = (intptr_t) rand();
+        trrb = transient_rrb_push(trrb, (void *) list[size]);
+        persistent = rrb_push(persistent, (void *) list[size]);
+        size++;
+      }
+      if (f == FRAGMENTS / 2) {
+        snapshot = persistent;
+        snapshot_size = size;
+        memcpy(snapshot_list, list, size * sizeof(intptr_t));
+      }
+    }
+
+    fail |= check_contents(persistent, list, size, "rrb_concat");
+    const RRB *rrb = transient_to_rrb(trrb);
+    fail |= check_contents(rrb, list, size, "transient_rrb_concat");
+    fail |= check_contents(snapshot, snapshot_list, snapshot_size,
+                           "Snapshot after transient_rrb_concat");
+  }
+
+  return fail;
+}
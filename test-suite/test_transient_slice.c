@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2013-2014 Jean Niklas L'orange. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <gc/gc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "rrb.h"
+#include "test.h"
+
+#define TESTS 200
+#define CONCATS 20
+#define MAX_PART 300
+#define SLICES 10
+#define WINDOW_STEPS 200
+#define MAX_STEP 100
+#define MAX_SIZE (CONCATS * MAX_PART + WINDOW_STEPS * MAX_STEP)
+
+#define MIN(a,b) (((a)<(b))?(a):(b))
+
+static const RRB* rand_relaxed_rrb(intptr_t *list, uint32_t *size) {
+  const RRB *rrb = rrb_create();
+  for (uint32_t i = 0; i < CONCATS; i++) {
+    const uint32_t part_size = (uint32_t) rand() % MAX_PART;
+    const RRB *part = rrb_create();
+    for (uint32_t j = 0; j < part_size; j++) {
+      list[*size] = (intptr_t) rand();
+      part = rrb_push(part, (void *) list[(*size)++]);
+    }
+    rrb = rrb_concat(rrb, part);
+  }
+  return rrb;
+}
+
+int main(int argc, char *argv[]) {
+  GC_INIT();
+  setup_rand(argc == 2 ? argv[1] : NULL);
+
+  int fail = 0;
+  intptr_t *list = GC_MALLOC_ATOMIC(sizeof(intptr_t) * MAX_SIZE);
+  intptr_t *orig_list = GC_MALLOC_ATOMIC(sizeof(intptr_t) * MAX_SIZE);
+
+  for (uint32_t t = 0; t < TESTS; t++) {
+    uint32_t size = 0;
+    const RRB *orig = rand_relaxed_rrb(list, &size);
+    const uint32_t orig_size = size;
+    memcpy(orig_list, list, size * sizeof(intptr_t));
+
+    // Repeated slicing, with pushes in between so that the transient owns some
+    // of the nodes it slices
+    TransientRRB *trrb = rrb_to_transient(orig);
+    for (uint32_t s = 0; s < SLICES; s++) {
+      const uint32_t from = (uint32_t) rand() % (size + 1);
+      const uint32_t to = from + (uint32_t) rand() % (size - from + 1);
+      trrb = transient_rrb_slice(trrb, from, to);
+      memmove(list, &list[from], (to - from) * sizeof(intptr_t));
+      size = to - from;
+
+      const uint32_t pushes = (uint32_t) rand() % MAX_PART;
+      for (uint32_t i = 0; i < pushes; i++) {
+        list[size] = (intptr_t) rand();
+        trrb = transient_rrb_push(trrb, (void *) list[size++]);
+      }
+      if (transient_rrb_count(trrb) != size) {
+        printf("Expected sliced transient to contain %u elements, has %u.\n",
+               size, (uint32_t) transient_rrb_count(trrb));
+        fail = 1;
+        break;
+      }
+    }
+    fail |= check_contents(transient_to_rrb(trrb), list, size,
+                           "transient_rrb_slice");
+    fail |= check_contents(orig, orig_list, orig_size,
+                           "Original after transient_rrb_slice");
+
+    // Sliding window: Drop a prefix, then append to the end
+    size = orig_size;
+    memcpy(list, orig_list, size * sizeof(intptr_t));
+    uint32_t offset = 0;
+    trrb = rrb_to_transient(orig);
+    for (uint32_t s = 0; s < WINDOW_STEPS; s++) {
+      const uint32_t drop = MIN((uint32_t) rand() % MAX_STEP, size - offset);
+      trrb = transient_rrb_slice(trrb, drop, transient_rrb_count(trrb));
+      offset += drop;
+      const uint32_t pushes = (uint32_t) rand() % MAX_STEP;
+      for (uint32_t i = 0; i < pushes; i++) {
+        list[size] = (intptr_t) rand();
+        trrb = transient_rrb_push(trrb, (void *) list[size++]);
+      }
+    }
+    fail |= check_contents(transient_to_rrb(trrb), &list[offset], size - offset,
+                           "Sliding window");
+  }
+
+  return fail;
+}
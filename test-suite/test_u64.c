@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2013-2014 Jean Niklas L'orange. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include <gc/gc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "rrb.h"
+#include "test.h"
+
+#define SIZE 40000
+#define UPDATES 5000
+#define PIECES 200
+
+static uint32_t hook_calls = 0;
+
+static void count_hook(const void *elt) {
+  (void) elt;
+  hook_calls++;
+}
+
+static uint64_t rand_u64(void) {
+  return ((uint64_t) rand() << 42) ^ ((uint64_t) rand() << 21)
+    ^ (uint64_t) rand();
+}
+
+static int check_u64_contents(const RRBU64 *rrb, const uint64_t *expected,
+                              uint32_t size, const char *what) {
+  if (rrb_u64_count(rrb) != size) {
+    printf("Expected %s to contain %u elements, but it has %u.\n", what, size,
+           (uint32_t) rrb_u64_count(rrb));
+    return 1;
+  }
+  for (uint32_t i = 0; i < size; i++) {
+    const uint64_t val = rrb_u64_nth(rrb, i);
+    if (val != expected[i]) {
+      printf("Expected %s to contain %llu at %u, but it was %llu.\n", what,
+             (unsigned long long) expected[i], i, (unsigned long long) val);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  GC_INIT();
+  setup_rand(argc == 2 ? argv[1] : NULL);
+  // Unboxed elements are not pointers, so they are never passed to the hooks.
+  rrb_set_element_hooks(count_hook, count_hook);
+
+  int fail = 0;
+  uint64_t *list = GC_MALLOC_ATOMIC(sizeof(uint64_t) * SIZE);
+  const RRBU64 *rrb = rrb_u64_create();
+  for (uint32_t i = 0; i < SIZE; i++) {
+    list[i] = rand_u64();
+    const RRBU64 *pushed = rrb_u64_push(rrb, list[i]);
+    rrb_u64_release(rrb);
+    rrb = pushed;
+  }
+  fail |= check_u64_contents(rrb, list, SIZE, "pushed vector");
+
+  for (uint32_t i = 0; i < UPDATES; i++) {
+    const uint32_t idx = (uint32_t) rand() % SIZE;
+    const uint64_t val = rand_u64();
+    const RRBU64 *updated = rrb_u64_update(rrb, idx, val);
+    if (rrb_u64_nth(rrb, idx) != list[idx]) {
+      printf("Update at %u modified the original vector.\n", idx);
+      fail = 1;
+    }
+    if (rrb_u64_nth(updated, idx) != val) {
+      printf("Expected %llu at %u after update, but it was %llu.\n",
+             (unsigned long long) val, idx,
+             (unsigned long long) rrb_u64_nth(updated, idx));
+      fail = 1;
+    }
+    list[idx] = val;
+    rrb_u64_release(rrb);
+    rrb = updated;
+  }
+  fail |= check_u64_contents(rrb, list, SIZE, "updated vector");
+  if (rrb_u64_update(rrb, SIZE, rand_u64()) != NULL) {
+    printf("Updating out of bounds didn't return NULL.\n");
+    fail = 1;
+  }
+
+  // Cut the vector into random pieces, and glue them back together.
+  const RRBU64 *catted = rrb_u64_create();
+  uint32_t from = 0;
+  for (uint32_t i = 0; from < SIZE; i++) {
+    uint32_t to = i + 1 == PIECES ? SIZE
+                                  : from + (uint32_t) rand() % (2 * SIZE / PIECES);
+    if (to > SIZE) {
+      to = SIZE;
+    }
+    const RRBU64 *piece = rrb_u64_slice(rrb, from, to);
+    fail |= check_u64_contents(piece, &list[from], to - from, "slice");
+    const RRBU64 *joined = rrb_u64_concat(catted, piece);
+    rrb_u64_release(catted);
+    rrb_u64_release(piece);
+    catted = joined;
+    from = to;
+  }
+  fail |= check_u64_contents(catted, list, SIZE, "concatenated vector");
+
+  rrb_u64_release(catted);
+  rrb_u64_release(rrb);
+  if (hook_calls != 0) {
+    printf("Element hooks were called %u times on unboxed elements.\n",
+           hook_calls);
+    fail = 1;
+  }
+  return fail;
+}
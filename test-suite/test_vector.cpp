@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) 2013-2014 Jean Niklas L'orange. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+
+#include <gc/gc.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "rrb_vector.hpp"
+#include "test.h"
+
+#define SIZE 20000
+#define UPDATES 2000
+#define PIECES 100
+#define CONCATS 300
+
+// Counts the elements alive, so that leaks and double frees show up.
+struct Counted {
+  static long live;
+  int value;
+
+  Counted(int v) : value(v) { live++; }
+  Counted(const Counted &other) : value(other.value) { live++; }
+  Counted& operator=(const Counted &other) = default;
+  ~Counted() { live--; }
+  bool operator==(const Counted &other) const { return value == other.value; }
+};
+
+long Counted::live = 0;
+
+template <unsigned Bits>
+static int check_contents(const rrb::vector<Counted, Bits> &vec,
+                          const std::vector<Counted> &expected,
+                          const char *what) {
+  if (vec.size() != expected.size()) {
+    printf("Expected %s (bits=%u) to contain %zu elements, but it has %u.\n",
+           what, Bits, expected.size(), vec.size());
+    return 1;
+  }
+  for (uint32_t i = 0; i < vec.size(); i++) {
+    if (vec[i].value != expected[i].value) {
+      printf("Expected %s (bits=%u) to contain %d at %u, but it was %d.\n",
+             what, Bits, expected[i].value, i, vec[i].value);
+      return 1;
+    }
+  }
+  if (!std::equal(vec.begin(), vec.end(), expected.begin())) {
+    printf("Iterating over %s (bits=%u) doesn't match indexing.\n", what, Bits);
+    return 1;
+  }
+  return 0;
+}
+
+template <unsigned Bits>
+static int test_vector() {
+  typedef rrb::vector<Counted, Bits> Vec;
+  int fail = 0;
+  std::vector<Counted> list;
+  Vec vec;
+  for (int i = 0; i < SIZE; i++) {
+    const Vec pushed = vec.push_back(Counted(rand()));
+    if (pushed.size() != vec.size() + 1) {
+      printf("Push changed the size of the original vector.\n");
+      fail = 1;
+    }
+    list.push_back(pushed.back());
+    vec = pushed;
+  }
+  fail |= check_contents(vec, list, "pushed vector");
+
+  for (int i = 0; i < UPDATES; i++) {
+    const uint32_t idx = (uint32_t) rand() % SIZE;
+    const Counted val(rand());
+    const Vec updated = vec.set(idx, val);
+    if (!(vec[idx] == list[idx]) || !(updated[idx] == val)) {
+      printf("Update at %u (bits=%u) is wrong.\n", idx, Bits);
+      fail = 1;
+    }
+    list[idx] = val;
+    vec = updated;
+  }
+  fail |= check_contents(vec, list, "updated vector");
+
+  // Cut the vector into random pieces, and glue them back together.
+  Vec catted;
+  uint32_t from = 0;
+  for (uint32_t i = 0; from < SIZE; i++) {
+    uint32_t to = i + 1 == PIECES ? SIZE
+                                  : from + (uint32_t) rand() % (2 * SIZE / PIECES);
+    to = std::min<uint32_t>(to, SIZE);
+    const Vec piece = vec.slice(from, to);
+    fail |= check_contents(piece, std::vector<Counted>(&list[from], &list[to]),
+                           "slice");
+    catted = catted.concat(piece);
+    from = to;
+  }
+  fail |= check_contents(catted, list, "concatenated vector");
+
+  // Concatenate random slices of slices, and push onto and pop off the result.
+  Vec mixed;
+  std::vector<Counted> mixed_list;
+  for (int i = 0; i < CONCATS; i++) {
+    const uint32_t a = (uint32_t) rand() % SIZE;
+    const uint32_t b = a + (uint32_t) rand() % (SIZE - a + 1);
+    const Vec piece = catted.slice(a, b);
+    const uint32_t c = (uint32_t) rand() % (piece.size() + 1);
+    mixed = mixed.concat(piece.slice(c, piece.size()));
+    mixed_list.insert(mixed_list.end(), &list[a + c], &list[b]);
+    if (rand() % 2 == 0 && !mixed.empty()) {
+      mixed = mixed.pop_back();
+      mixed_list.pop_back();
+    }
+    mixed = mixed.push_back(Counted(i));
+    mixed_list.push_back(Counted(i));
+    if (mixed.size() > 4 * SIZE) {
+      mixed = mixed.slice(mixed.size() - SIZE, mixed.size());
+      mixed_list.erase(mixed_list.begin(), mixed_list.end() - SIZE);
+    }
+  }
+  fail |= check_contents(mixed, mixed_list, "mixed vector");
+
+  const Vec copied(list.begin(), list.end());
+  fail |= check_contents(copied, list, "vector from range");
+
+  try {
+    vec.at(SIZE);
+    printf("Expected at(%d) to throw.\n", SIZE);
+    fail = 1;
+  }
+  catch (const std::out_of_range &) {
+  }
+  return fail;
+}
+
+int main(int argc, char *argv[]) {
+  GC_INIT();
+  setup_rand(argc == 2 ? argv[1] : NULL);
+
+  int fail = 0;
+  fail |= test_vector<2>();
+  fail |= test_vector<5>();
+  fail |= test_vector<6>();
+
+  const rrb::vector<std::string> strings = {"an", "rrb", "vector", "of"};
+  const rrb::vector<std::string> more = strings.push_back("strings");
+  if (more.size() != 5 || more[4] != "strings" || strings.size() != 4) {
+    printf("Vector of strings is wrong.\n");
+    fail = 1;
+  }
+
+  if (Counted::live != 0) {
+    printf("%ld elements are still alive.\n", Counted::live);
+    fail = 1;
+  }
+  return fail;
+}